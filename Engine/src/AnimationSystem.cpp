@@ -22,24 +22,50 @@ void AnimationSystem::lateInit() {
 }
 
 void AnimationSystem::update(float dt) {
-    auto& anims = ECS.getAllComponents<Animation>();
-    for (auto& anim : anims) {
-        Transform& transform = ECS.getComponentFromEntity<Transform>(anim.owner);
+    //only animate active entities
+    auto animations = ECS.view<Animation, Transform>();
+    const size_t num = animations.size();
+    animated_.assign(num, 0);
+    from_rotations_.resize(num);
+    to_rotations_.resize(num);
+    blends_.assign(from_rotations_.paddedSize(), 0.0f);
+    positions_.resize(num);
+    scales_.resize(num);
+
+    //rows in parallel: each writes only its own animation, transform and slots
+    animations.parallelEachIndex([&](size_t i) {
+        Animation& anim = animations.get<Animation>(i);
+        if (anim.num_frames == 0) return;
         //increment counter (dt is in seconds)
         anim.ms_counter += dt *1000;
         //if counter above threshold
         if (anim.ms_counter >= anim.ms_frame) {
             //reset it - careful to overflow valley to avoid "cutting" time
             anim.ms_counter = anim.ms_counter - anim.ms_frame;
-            //set positions
-            transform.set(anim.keyframes[anim.curr_frame]);
             //advance frame
             anim.curr_frame++;
             //loop if required
             if (anim.curr_frame == anim.num_frames)
                 anim.curr_frame = 0;
         }
-        
-        
+        //blend from current frame towards the next one, by time through the frame
+        const AnimationKey& from = anim.keyframes[anim.curr_frame];
+        const AnimationKey& to = anim.keyframes[(anim.curr_frame + 1) % anim.num_frames];
+        const float t = lm::Utils::clamp(0.0f, 1.0f, anim.ms_counter / anim.ms_frame);
+        positions_[i] = from.position.lerp(to.position, t);
+        scales_[i] = from.scale.lerp(to.scale, t);
+        from_rotations_.set(i, from.rotation);
+        to_rotations_.set(i, to.rotation);
+        blends_[i] = t;
+        animated_[i] = 1;
+    }, PARALLEL_GRAIN);
+
+    //rows which did not animate blend whatever their slots hold, and are skipped
+    lm::batch::slerp(from_rotations_, to_rotations_, blends_.data(), rotations_);
+    for (size_t i = 0; i < num; i++) {
+        if (!animated_[i]) continue;
+        animations.get<Transform>(i).set(positions_[i], rotations_.get(i), scales_[i]);
+        ECS.markChanged<Animation>(animations.index<Animation>(i));
+        ECS.markChanged<Transform>(animations.index<Transform>(i));
     }
 }
@@ -2,6 +2,7 @@
 #include "includes.h"
 #include "Shader.h"
 #include "Components.h"
+#include "linmath_batch.h"
 
 class AnimationSystem {
 public:
@@ -9,6 +10,17 @@ public:
     void init();
     void lateInit();
     void update(float dt);
-    
-    
+
+    //rows of the animation view per job
+    static const size_t PARALLEL_GRAIN = 256;
+
+private:
+    //rotations of every animated transform are blended in one batch (see
+    //lm::batch::slerp). Per row of the animation view: whether it animated
+    //this update, its keys and its blend, and its blended position and scale,
+    //so the transform is set (and its matrix composed) once
+    std::vector<uint8_t> animated_;
+    lm::quatArray from_rotations_, to_rotations_, rotations_;
+    std::vector<float> blends_;
+    std::vector<lm::vec3> positions_, scales_;
 };
@@ -0,0 +1,407 @@
+//
+//  ArchetypeStorage.h
+//
+//  Alternative component storage layouts, used to compare against the default
+//  tuple-of-vectors layout of the EntityComponentStore.
+//
+//  - VectorStorage: one std::vector per component type plus an array of component
+//    indices per entity (the same AoS layout as ComponentArrays in Components.h)
+//
+//  - ArchetypeStorage: entities with the same set of component types (archetype)
+//    are stored together in fixed size 16 KB chunks. Inside a chunk each component
+//    type is its own contiguous column, so a loop which only reads Transforms walks
+//    a packed array of transforms and never touches the memory of other components.
+//    Adding or removing a component moves the entity to another archetype.
+//
+//  Both expose the same interface, so code templated on the storage type can be
+//  compiled against either layout:
+//      int createEntity();              void destroyEntity(int e);
+//      T& add<T>(int e);                void remove<T>(int e);
+//      T& get<T>(int e);                bool has<T>(int e);
+//      each<Ts...>(fn(Ts&...));         eachChunk<Ts...>(fn(size_t count, Ts*... columns))
+//
+#pragma once
+#include <vector>
+#include <tuple>
+#include <array>
+#include <unordered_map>
+#include <cstdint>
+#include <cstddef>
+#include <new>
+#include <utility>
+#include "ComponentRegistry.h" //type_position
+
+#define ARCHETYPE_CHUNK_SIZE (16 * 1024)
+
+/**** VECTOR STORAGE ****/
+
+template<typename... Ts>
+class VectorStorage {
+public:
+    static const size_t NUM_TYPES = sizeof...(Ts);
+
+    int createEntity() {
+        Row row; row.fill(-1);
+        if (!free_.empty()) {
+            int e = free_.back(); free_.pop_back();
+            rows_[e] = row;
+            return e;
+        }
+        rows_.push_back(row);
+        return (int)rows_.size() - 1;
+    }
+
+    void destroyEntity(int e) {
+        int expand[] = { 0, (remove<Ts>(e), 0)... };
+        (void)expand;
+        free_.push_back(e);
+    }
+
+    template<typename T>
+    T& add(int e) {
+        std::vector<T>& vec = std::get<std::vector<T>>(arrays_);
+        std::vector<int>& owners = owners_[type_position<T, Ts...>::result];
+        vec.emplace_back();
+        owners.push_back(e);
+        rows_[e][type_position<T, Ts...>::result] = (int)vec.size() - 1;
+        return vec.back();
+    }
+
+    //swap-and-pop, same as EntityComponentStore
+    template<typename T>
+    void remove(int e) {
+        const int type = type_position<T, Ts...>::result;
+        const int index = rows_[e][type];
+        if (index == -1) return;
+        std::vector<T>& vec = std::get<std::vector<T>>(arrays_);
+        std::vector<int>& owners = owners_[type];
+        const int last = (int)vec.size() - 1;
+        if (index != last) {
+            vec[index] = std::move(vec[last]);
+            owners[index] = owners[last];
+            rows_[owners[index]][type] = index;
+        }
+        vec.pop_back();
+        owners.pop_back();
+        rows_[e][type] = -1;
+    }
+
+    template<typename T>
+    bool has(int e) const { return rows_[e][type_position<T, Ts...>::result] != -1; }
+
+    template<typename T>
+    T& get(int e) { return std::get<std::vector<T>>(arrays_)[rows_[e][type_position<T, Ts...>::result]]; }
+
+    //iterates first type's array, looking up the other components through the entity
+    template<typename... Us, typename F>
+    void each(F fn) {
+        typedef typename std::tuple_element<0, std::tuple<Us...>>::type Driver;
+        const std::vector<int>& owners = owners_[type_position<Driver, Ts...>::result];
+        for (size_t i = 0; i < owners.size(); i++) {
+            const int e = owners[i];
+            if (allOf_<Us...>(e)) fn(get<Us>(e)...);
+        }
+    }
+
+    //the vector layout has no chunks - each "chunk" is a single entity
+    template<typename... Us, typename F>
+    void eachChunk(F fn) {
+        each<Us...>([&fn](Us&... comps) { fn((size_t)1, &comps...); });
+    }
+
+    void reserve(size_t num_entities) {
+        rows_.reserve(num_entities);
+        int expand[] = { 0, (std::get<std::vector<Ts>>(arrays_).reserve(num_entities), 0)... };
+        (void)expand;
+        for (auto& owners : owners_) owners.reserve(num_entities);
+    }
+
+private:
+    typedef std::array<int, sizeof...(Ts)> Row;
+
+    std::tuple<std::vector<Ts>...> arrays_;
+    std::array<std::vector<int>, sizeof...(Ts)> owners_;
+    std::vector<Row> rows_;
+    std::vector<int> free_;
+
+    template<typename... Us>
+    bool allOf_(int e) const {
+        const bool has_all[] = { true, has<Us>(e)... };
+        for (bool h : has_all) if (!h) return false;
+        return true;
+    }
+};
+
+/**** ARCHETYPE STORAGE ****/
+
+template<typename... Ts>
+class ArchetypeStorage {
+public:
+    static const size_t NUM_TYPES = sizeof...(Ts);
+    static_assert(sizeof...(Ts) <= 32, "ArchetypeStorage signature is a 32 bit mask");
+    typedef uint32_t Signature;
+
+    ArchetypeStorage() {
+        const TypeInfo infos[] = { makeTypeInfo_<Ts>()... };
+        for (size_t i = 0; i < NUM_TYPES; i++) types_[i] = infos[i];
+    }
+
+    ~ArchetypeStorage() {
+        for (Archetype* arch : archetypes_) {
+            for (Chunk& chunk : arch->chunks) {
+                for (int row = 0; row < chunk.count; row++)
+                    destroyRow_(*arch, chunk, row);
+                delete[] chunk.memory;
+            }
+            delete arch;
+        }
+    }
+
+    ArchetypeStorage(const ArchetypeStorage&) = delete;
+    ArchetypeStorage& operator=(const ArchetypeStorage&) = delete;
+
+    //new entities start in the empty archetype
+    int createEntity() {
+        int e;
+        if (!free_.empty()) { e = free_.back(); free_.pop_back(); }
+        else { locations_.emplace_back(); e = (int)locations_.size() - 1; }
+        Location& loc = locations_[e];
+        loc.archetype = getArchetype_(0);
+        allocateRow_(*loc.archetype, e, loc);
+        return e;
+    }
+
+    void destroyEntity(int e) {
+        Location& loc = locations_[e];
+        if (!loc.archetype) return;
+        Chunk& chunk = loc.archetype->chunks[loc.chunk];
+        destroyRow_(*loc.archetype, chunk, loc.row);
+        fillHole_(*loc.archetype, loc.chunk, loc.row);
+        loc = Location();
+        free_.push_back(e);
+    }
+
+    //moves entity to the archetype which also contains T
+    template<typename T>
+    T& add(int e) {
+        const int type = type_position<T, Ts...>::result;
+        Location& loc = locations_[e];
+        if (loc.archetype->signature & (1u << type)) return get<T>(e);
+        moveToArchetype_(e, loc.archetype->signature | (1u << type));
+        return get<T>(e);
+    }
+
+    //moves entity to the archetype without T
+    template<typename T>
+    void remove(int e) {
+        const int type = type_position<T, Ts...>::result;
+        Location& loc = locations_[e];
+        if (!(loc.archetype->signature & (1u << type))) return;
+        moveToArchetype_(e, loc.archetype->signature & ~(1u << type));
+    }
+
+    template<typename T>
+    bool has(int e) const {
+        const Location& loc = locations_[e];
+        return loc.archetype && (loc.archetype->signature & (1u << type_position<T, Ts...>::result));
+    }
+
+    template<typename T>
+    T& get(int e) {
+        const Location& loc = locations_[e];
+        return column_<T>(*loc.archetype, loc.archetype->chunks[loc.chunk])[loc.row];
+    }
+
+    //calls fn(Us&...) for every entity which has all of Us
+    template<typename... Us, typename F>
+    void each(F fn) {
+        eachChunk<Us...>([&fn](size_t count, Us*... columns) {
+            for (size_t i = 0; i < count; i++)
+                fn(columns[i]...);
+        });
+    }
+
+    //calls fn(count, Us*... columns) once per chunk of every matching archetype
+    template<typename... Us, typename F>
+    void eachChunk(F fn) {
+        const Signature mask = signatureOf_<Us...>();
+        for (Archetype* arch : archetypes_) {
+            if ((arch->signature & mask) != mask) continue;
+            for (Chunk& chunk : arch->chunks)
+                fn((size_t)chunk.count, column_<Us>(*arch, chunk)...);
+        }
+    }
+
+    //number of entities which fit in one chunk of the archetype with these types
+    template<typename... Us>
+    int chunkCapacity() { return getArchetype_(signatureOf_<Us...>())->capacity; }
+
+    void reserve(size_t num_entities) { locations_.reserve(num_entities); }
+
+private:
+    //type erased operations needed to move components between chunks
+    struct TypeInfo {
+        size_t size;
+        size_t align;
+        void (*construct)(void* dst);
+        void (*move_construct)(void* dst, void* src);
+        void (*destroy)(void* ptr);
+    };
+
+    struct Chunk {
+        unsigned char* memory = nullptr; //raw allocation
+        unsigned char* data = nullptr; //64 byte aligned start of columns
+        int count = 0;
+    };
+
+    struct Archetype {
+        Signature signature = 0;
+        int capacity = 0;
+        size_t column_offset[sizeof...(Ts)]; //offset of each column in chunk
+        std::vector<Chunk> chunks; //all full except the last one
+    };
+
+    struct Location {
+        Archetype* archetype = nullptr;
+        int chunk = -1;
+        int row = -1;
+    };
+
+    TypeInfo types_[sizeof...(Ts)];
+    std::vector<Archetype*> archetypes_;
+    std::unordered_map<Signature, Archetype*> archetype_map_;
+    std::vector<Location> locations_;
+    std::vector<int> free_;
+
+    template<typename T>
+    static TypeInfo makeTypeInfo_() {
+        TypeInfo info;
+        info.size = sizeof(T);
+        info.align = alignof(T);
+        info.construct = [](void* dst) { new (dst) T(); };
+        info.move_construct = [](void* dst, void* src) { new (dst) T(std::move(*static_cast<T*>(src))); };
+        info.destroy = [](void* ptr) { static_cast<T*>(ptr)->~T(); };
+        return info;
+    }
+
+    template<typename... Us>
+    static Signature signatureOf_() {
+        const Signature bits[] = { 0u, (1u << type_position<Us, Ts...>::result)... };
+        Signature sig = 0;
+        for (Signature b : bits) sig |= b;
+        return sig;
+    }
+
+    static size_t alignUp_(size_t offset, size_t align) { return (offset + align - 1) & ~(align - 1); }
+
+    //column 0 of every chunk is the entity id, followed by one column per component type
+    bool layoutFits_(Archetype& arch, int capacity) {
+        size_t offset = sizeof(int) * capacity;
+        for (size_t t = 0; t < NUM_TYPES; t++) {
+            if (!(arch.signature & (1u << t))) continue;
+            offset = alignUp_(offset, types_[t].align);
+            arch.column_offset[t] = offset;
+            offset += types_[t].size * capacity;
+        }
+        return offset <= ARCHETYPE_CHUNK_SIZE;
+    }
+
+    Archetype* getArchetype_(Signature signature) {
+        auto it = archetype_map_.find(signature);
+        if (it != archetype_map_.end()) return it->second;
+
+        Archetype* arch = new Archetype();
+        arch->signature = signature;
+        size_t row_size = sizeof(int);
+        for (size_t t = 0; t < NUM_TYPES; t++) {
+            arch->column_offset[t] = 0;
+            if (signature & (1u << t)) row_size += types_[t].size;
+        }
+        int capacity = (int)(ARCHETYPE_CHUNK_SIZE / row_size);
+        while (capacity > 1 && !layoutFits_(*arch, capacity)) capacity--;
+        layoutFits_(*arch, capacity);
+        arch->capacity = capacity;
+
+        archetypes_.push_back(arch);
+        archetype_map_[signature] = arch;
+        return arch;
+    }
+
+    int* entityColumn_(Chunk& chunk) { return reinterpret_cast<int*>(chunk.data); }
+    void* componentAt_(Archetype& arch, Chunk& chunk, size_t type, int row) {
+        return chunk.data + arch.column_offset[type] + types_[type].size * row;
+    }
+    template<typename T>
+    T* column_(Archetype& arch, Chunk& chunk) {
+        return reinterpret_cast<T*>(chunk.data + arch.column_offset[type_position<T, Ts...>::result]);
+    }
+
+    //reserves a row at the end of the archetype, without constructing components
+    void allocateRow_(Archetype& arch, int e, Location& loc) {
+        if (arch.chunks.empty() || arch.chunks.back().count == arch.capacity) {
+            Chunk chunk;
+            chunk.memory = new unsigned char[ARCHETYPE_CHUNK_SIZE + 64];
+            chunk.data = chunk.memory + (64 - ((uintptr_t)chunk.memory & 63)) % 64;
+            arch.chunks.push_back(chunk);
+        }
+        Chunk& chunk = arch.chunks.back();
+        loc.archetype = &arch;
+        loc.chunk = (int)arch.chunks.size() - 1;
+        loc.row = chunk.count++;
+        entityColumn_(chunk)[loc.row] = e;
+    }
+
+    void destroyRow_(Archetype& arch, Chunk& chunk, int row) {
+        for (size_t t = 0; t < NUM_TYPES; t++)
+            if (arch.signature & (1u << t))
+                types_[t].destroy(componentAt_(arch, chunk, t, row));
+    }
+
+    //row has already been destroyed - move last row of archetype into it
+    void fillHole_(Archetype& arch, int chunk_index, int row) {
+        Chunk& last_chunk = arch.chunks.back();
+        const int last_row = last_chunk.count - 1;
+        Chunk& chunk = arch.chunks[chunk_index];
+        if (&chunk != &last_chunk || row != last_row) {
+            for (size_t t = 0; t < NUM_TYPES; t++) {
+                if (!(arch.signature & (1u << t))) continue;
+                void* src = componentAt_(arch, last_chunk, t, last_row);
+                types_[t].move_construct(componentAt_(arch, chunk, t, row), src);
+                types_[t].destroy(src);
+            }
+            const int moved = entityColumn_(last_chunk)[last_row];
+            entityColumn_(chunk)[row] = moved;
+            locations_[moved].chunk = chunk_index;
+            locations_[moved].row = row;
+        }
+        last_chunk.count--;
+        if (last_chunk.count == 0) {
+            delete[] last_chunk.memory;
+            arch.chunks.pop_back();
+        }
+    }
+
+    void moveToArchetype_(int e, Signature new_signature) {
+        Location old_loc = locations_[e];
+        Archetype& old_arch = *old_loc.archetype;
+        Archetype& new_arch = *getArchetype_(new_signature);
+
+        Location new_loc;
+        allocateRow_(new_arch, e, new_loc);
+        Chunk& new_chunk = new_arch.chunks[new_loc.chunk];
+        Chunk& old_chunk = old_arch.chunks[old_loc.chunk];
+
+        for (size_t t = 0; t < NUM_TYPES; t++) {
+            const Signature bit = 1u << t;
+            const bool in_old = (old_arch.signature & bit) != 0;
+            const bool in_new = (new_signature & bit) != 0;
+            void* old_ptr = in_old ? componentAt_(old_arch, old_chunk, t, old_loc.row) : nullptr;
+            if (in_new && in_old) types_[t].move_construct(componentAt_(new_arch, new_chunk, t, new_loc.row), old_ptr);
+            else if (in_new) types_[t].construct(componentAt_(new_arch, new_chunk, t, new_loc.row));
+            if (in_old) types_[t].destroy(old_ptr);
+        }
+
+        locations_[e] = new_loc;
+        fillHole_(old_arch, old_loc.chunk, old_loc.row);
+    }
+};
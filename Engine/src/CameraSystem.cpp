@@ -27,6 +27,7 @@ bool CameraSystem::lateInit()
     SetOutputCamera(main_camera);
 
     ECS.main_camera = ECS.getComponentID<Camera>(flyover_id);
+    _hasSteppedOutput = false;
 
     return true;
 }
@@ -37,6 +38,12 @@ bool CameraSystem::stop()
 }
 
 // Update function, used to blend between gameplay cameras
+void CameraSystem::updateTracks(float dt)
+{
+    auto& tracks = ECS.getAllComponents<ViewTrack>();
+    for (auto& track : tracks) track.update(dt);
+}
+
 void CameraSystem::update(float delta)
 {
     updateTest(delta);
@@ -91,7 +98,7 @@ void CameraSystem::update(float delta)
                 Camera& c_camera = ECS.getComponentFromEntity<Camera>(e.name);
                 blendCameras(&resultCamera, &c_camera, ratio, &resultCamera);
 
-                Transform& c_trans = ECS.getComponentFromEntity<Transform>(e.name);
+                Transform& c_trans = ECS.getComponentFromEntityForWrite<Transform>(e.name);
                 c_trans.position(resultCamera.position);
             }
         }
@@ -116,15 +123,30 @@ void CameraSystem::update(float delta)
     if (_outputCamera.isValid())
     {
         Entity e = _outputCamera;
-        Camera& c_camera = ECS.getComponentFromEntity<Camera>(e.name);
+        Camera& c_camera = ECS.getComponentFromEntityForWrite<Camera>(e.name);
         blendCameras(&resultCamera, &resultCamera, 1.f, &c_camera);
 
-        Transform& c_trans = ECS.getComponentFromEntity<Transform>(e.name);
+        Transform& c_trans = ECS.getComponentFromEntityForWrite<Transform>(e.name);
         c_trans.position(c_camera.position);
-        
+
+        // Keep the last two steps, the first one has nothing to blend from.
+        _previousOutput = _hasSteppedOutput ? _steppedOutput : c_camera;
+        _steppedOutput = c_camera;
+        _hasSteppedOutput = true;
     }
 }
 
+// Output camera is rewritten every step, so rendering may overwrite it with a blend of the last two.
+void CameraSystem::interpolate(float alpha)
+{
+    if (!_outputCamera.isValid() || !_hasSteppedOutput)
+        return;
+
+    Entity e = _outputCamera;
+    Camera& c_camera = ECS.getComponentFromEntityForWrite<Camera>(e.name);
+    blendCameras(&_previousOutput, &_steppedOutput, alpha, &c_camera);
+}
+
 // Check if a camera is already done.
 void CameraSystem::checkDeprecated()
 {
@@ -142,9 +164,9 @@ void CameraSystem::checkDeprecated()
                 Camera& c_camera1 = ECS.getComponentFromEntity<Camera>(e1.name);
 
                 Entity e2 = _defaultCamera;
-                Camera & c_camera2 = ECS.getComponentFromEntity<Camera>(e2.name);
+                Camera & c_camera2 = ECS.getComponentFromEntityForWrite<Camera>(e2.name);
 
-                Transform& c_trans = ECS.getComponentFromEntity<Transform>(e2.name);
+                Transform& c_trans = ECS.getComponentFromEntityForWrite<Transform>(e2.name);
                 c_trans.position(c_camera1.position);
 
                 blendCameras(&c_camera1, &c_camera1, 1.f, &c_camera2);
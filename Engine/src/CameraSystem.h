@@ -17,7 +17,11 @@ public:
     bool lateInit();
     bool stop();
     void update(float dt);
+    // Moves cameras along their view tracks, once per fixed step.
+    void updateTracks(float dt);
     void updateTest(float dt);
+    // Output camera for rendering, alpha (0 to 1) of the way from the previous fixed step to the last one.
+    void interpolate(float alpha);
     void render();
 
     void checkDeprecated(); // remove temporal cameras that are finished
@@ -43,6 +47,11 @@ private:
     Entity _defaultCamera;
     Entity _outputCamera;
 
+    // Output camera after the last two simulation steps, blended by interpolate.
+    Camera _previousOutput;
+    Camera _steppedOutput;
+    bool _hasSteppedOutput = false;
+
     // Camera type for transitions, temporal dummy camera
     struct CameraMixed
     {
@@ -1,5 +1,6 @@
 #include "CollisionSystem.h"
 #include "extern.h"
+#include "Game.h"
 
 using namespace lm;
 
@@ -12,44 +13,64 @@ void CollisionSystem::update(float dt) {
     //necesary variables
     lm::vec3 col_point;
     
-    //reset all collisions every frame
-    auto& colliders = ECS.getAllComponents<Collider>();
-    for (auto& col : colliders){
+    //reset all collisions every frame - only touches collision state. Inactive
+    //colliders are reset too, so they don't keep reporting their last hit
+    auto& collisions = ECS.getAllComponents<Collision>();
+    for (auto& col : collisions){
         col.colliding = false;
         col.collision_distance = 10000000.0f;
-        col.other = -1;
+        col.other_entity = -1;
     }
     
+    //view gives each collider together with its collision state and transform,
+    //eachIndex skips colliders of inactive entities. Transforms are only used
+    //for their index: world matrices come from the transform system, updated
+    //earlier this frame, so collision does not read transforms being animated
+    auto collider_view = ECS.view<Collider, Collision, Transform>();
+    const TransformSystem& transform_system = Game::instance->transform_system_;
+    
     //test ray-box collision. This works by looping over ray colliders. For each one, we loop over box colliders
     //test collision between ray and box, updating collision distance for each collision found
     //then for future collision tests only look as far as existing stored collision distance
-    for (size_t i = 0; i < colliders.size(); i++) {
+    collider_view.eachIndex([&](size_t i) {
+        Collider& ray = collider_view.get<Collider>(i);
         
         //if collider is ray
-        if (colliders[i].collider_type == ColliderTypeRay) {
+        if (ray.collider_type == ColliderTypeRay) {
+            const mat4& ray_world = transform_system.world(collider_view.index<Transform>(i));
+            Collision& ray_collision = collider_view.get<Collision>(i);
             
             //test all other colliders
-            for (size_t j = 0; j < colliders.size(); j++) {
-                if (j == i) continue; // no self-test
+            collider_view.eachIndex([&](size_t j) {
+                if (j == i) return; // no self-test
+                Collider& box = collider_view.get<Collider>(j);
                 
                 //if box
-                if (colliders[j].collider_type == ColliderTypeBox) {
+                if (box.collider_type == ColliderTypeBox) {
                     //test collision
                     float col_distance = 0; //temp var to store distance
-                    if (intersectSegmentBox(colliders[i], //the ray
-                                            colliders[j], //the box
+                    if (intersectSegmentBox(ray, ray_world, //the ray
+                                            box, transform_system.world(collider_view.index<Transform>(j)), //the box
                                             col_point, //reference to collision point
                                             col_distance, //reference to collision distance
-                                            colliders[i].collision_distance)){ //only look as far as current nearest collider
-                        colliders[i].colliding = colliders[j].colliding = true;
-						colliders[i].other = (int)j; colliders[j].other = (int)i;
-                        colliders[i].collision_point = colliders[j].collision_point = col_point;
-                        colliders[i].collision_distance = colliders[j].collision_distance = col_distance;
+                                            ray_collision.collision_distance)){ //only look as far as current nearest collider
+                        Collision& box_collision = collider_view.get<Collision>(j);
+                        ray_collision.colliding = box_collision.colliding = true;
+						ray_collision.other_entity = box.owner; box_collision.other_entity = ray.owner;
+                        ray_collision.collision_point = box_collision.collision_point = col_point;
+                        ray_collision.collision_distance = box_collision.collision_distance = col_distance;
                     }
                 }
-            }
+            });
         }
-    }
+    });
+}
+
+// Overload which looks up the transform of each collider
+bool CollisionSystem::intersectSegmentBox(Collider& ray, Collider& box, lm::vec3& col_point, float& col_distance, float max_distance) {
+    return intersectSegmentBox(ray, ECS.getComponentFromEntity<Transform>(ray.owner),
+                               box, ECS.getComponentFromEntity<Transform>(box.owner),
+                               col_point, col_distance, max_distance);
 }
 
 // Calculates whether a Ray collider (treated as a segment with a finite distance)
@@ -59,7 +80,15 @@ void CollisionSystem::update(float dt) {
 // - col_point: reference to an empty vec3 which will be updated with the collision point
 // - reference to a float which will be updated with the distance to the nearest collider
 // - optional variable which specifies the maximum distance along ray which to search
-bool CollisionSystem::intersectSegmentBox(Collider& ray, Collider& box, lm::vec3& col_point, float& col_distance, float max_distance) {
+bool CollisionSystem::intersectSegmentBox(Collider& ray, Transform& ray_model, Collider& box, Transform& box_model, lm::vec3& col_point, float& col_distance, float max_distance) {
+    //world matrices are cached by the transform system
+    const TransformSystem& transform_system = Game::instance->transform_system_;
+    return intersectSegmentBox(ray, transform_system.world(ray_model), box, transform_system.world(box_model),
+                               col_point, col_distance, max_distance);
+}
+
+// Same, with the world matrix of each collider's transform
+bool CollisionSystem::intersectSegmentBox(Collider& ray, const lm::mat4& ray_world, Collider& box, const lm::mat4& box_world, lm::vec3& col_point, float& col_distance, float max_distance) {
     //the general approach of this function is as follows
     // - transform ray and box into world space and apply any offsets
     // - create six planes of box
@@ -68,15 +97,8 @@ bool CollisionSystem::intersectSegmentBox(Collider& ray, Collider& box, lm::vec3
     // function already discards cases where ray points in same direction as quad
     // normal, so in fact we only test collisions for maximum 3 faces
     
-    //get model matrices
-    Transform& ray_model = ECS.getComponentFromEntity<Transform>(ray.owner);
-    Transform& box_model = ECS.getComponentFromEntity<Transform>(box.owner);
-    //get reference to all transforms in ECS, for world pos calculations
-    std::vector<Transform>& all_transforms = ECS.getAllComponents<Transform>();
-    
     //*** TRANSFORM BOX TO WORLD ***//
-    //get world matrices from scene graph
-    mat4 box_global = box_model.getGlobalMatrix(all_transforms);
+    const mat4& box_global = box_world;
     
     //get each corner of box in local space
     float x = box.local_halfwidth.x;
@@ -102,7 +124,7 @@ bool CollisionSystem::intersectSegmentBox(Collider& ray, Collider& box, lm::vec3
     
     
     //*** TRANSFORM RAY TO WORLD ***//
-    mat4 ray_global = ray_model.getGlobalMatrix(all_transforms);
+    mat4 ray_global = ray_world;
     
     //translate the center of ray locally before applying global positionthen get position
     ray_global.translateLocal(ray.local_center.x, ray.local_center.y, ray.local_center.z);
@@ -113,7 +135,7 @@ bool CollisionSystem::intersectSegmentBox(Collider& ray, Collider& box, lm::vec3
     //setting translation component to zero first. This is similar to the normal matrix in a shader
     mat4 inv = ray_global;
     inv.m[12] = 0.0; inv.m[13] = 0.0; inv.m[14] = 0.0;
-    inv.inverse();
+    inv.inverseAffine();
     mat4 inv_trans = inv.transpose();
     vec3 q = inv_trans * ray.direction.normalize(); //normalize direction as there's no guarantee it's length = 1!
     
@@ -7,6 +7,8 @@ public:
     void init();
     void update(float dt);
     bool intersectSegmentBox(Collider& ray, Collider& box, lm::vec3& col_point, float& col_distance, float max_distance = 100000.0f);
+    bool intersectSegmentBox(Collider& ray, Transform& ray_model, Collider& box, Transform& box_model, lm::vec3& col_point, float& col_distance, float max_distance = 100000.0f);
+    bool intersectSegmentBox(Collider& ray, const lm::mat4& ray_world, Collider& box, const lm::mat4& box_world, lm::vec3& col_point, float& col_distance, float max_distance = 100000.0f);
     
     bool intersectSegmentTriangle(lm::vec3 p, lm::vec3 q, lm::vec3 a, lm::vec3 b, lm::vec3 c);
     bool intersectSegmentQuad(lm::vec3 p, lm::vec3 q, lm::vec3 a, lm::vec3 b, lm::vec3 c, lm::vec3 d, lm::vec3& r);
@@ -0,0 +1,153 @@
+//
+//  ComponentRegistry.h
+//
+//  Compile-time list of component types. The index of each type, the tuple of
+//  component arrays and the entity signature are all derived from the list, so
+//  adding a component type only means adding it to ComponentTypes in Components.h
+//
+//  Each entry also chooses a storage policy, which decides how the ECS finds the
+//  component of an entity. Components themselves are always stored in one
+//  contiguous std::vector per type, so systems can still loop over all of them.
+//  - DenseStorage: one index per entity. Fastest lookup, but costs 4 bytes on every
+//    entity, so only for types which most entities have
+//  - SparseSetStorage: sparse entity -> index array split in pages, which are only
+//    allocated once an entity in their range has the component
+//  - PooledStorage: hash map entity -> index, for types only a handful of entities
+//    have. The component array is reserved in blocks of POOL_SIZE, so references to
+//    components stay valid until the pool fills up
+//
+#pragma once
+#include <vector>
+#include <tuple>
+#include <bitset>
+#include <memory>
+#include <unordered_map>
+#include <algorithm>
+
+//position of T in the type list Ts
+template<typename T, typename... Ts>
+struct type_position;
+template<typename T, typename... Ts>
+struct type_position<T, T, Ts...> { enum { result = 0 }; };
+template<typename T, typename U, typename... Ts>
+struct type_position<T, U, Ts...> { enum { result = 1 + type_position<T, Ts...>::result }; };
+
+/**** INDEX MAPS ****/
+
+//every index map returns -1 for entities which do not have the component
+//reserve() makes room before many components are added at once
+struct DenseIndexMap {
+    std::vector<int> indices;
+
+    int get(int entity_id) const {
+        return entity_id < (int)indices.size() ? indices[entity_id] : -1;
+    }
+    void set(int entity_id, int comp_index) {
+        if (entity_id >= (int)indices.size()) indices.resize(entity_id + 1, -1);
+        indices[entity_id] = comp_index;
+    }
+    void reserve(size_t num_entities, size_t) { indices.reserve(num_entities); }
+};
+
+template<int PAGE_SIZE>
+struct PagedIndexMap {
+    std::vector<std::unique_ptr<int[]>> pages;
+
+    int get(int entity_id) const {
+        const size_t page = entity_id / PAGE_SIZE;
+        if (page >= pages.size() || !pages[page]) return -1;
+        return pages[page][entity_id % PAGE_SIZE];
+    }
+    void set(int entity_id, int comp_index) {
+        const size_t page = entity_id / PAGE_SIZE;
+        if (page >= pages.size()) {
+            if (comp_index == -1) return;
+            pages.resize(page + 1);
+        }
+        if (!pages[page]) {
+            if (comp_index == -1) return;
+            pages[page].reset(new int[PAGE_SIZE]);
+            for (int i = 0; i < PAGE_SIZE; i++) pages[page][i] = -1;
+        }
+        pages[page][entity_id % PAGE_SIZE] = comp_index;
+    }
+    void reserve(size_t, size_t) {}
+};
+
+struct HashIndexMap {
+    std::unordered_map<int, int> indices;
+
+    int get(int entity_id) const {
+        auto it = indices.find(entity_id);
+        return it != indices.end() ? it->second : -1;
+    }
+    void set(int entity_id, int comp_index) {
+        if (comp_index == -1) indices.erase(entity_id);
+        else indices[entity_id] = comp_index;
+    }
+    void reserve(size_t, size_t num_components) { indices.reserve(num_components); }
+};
+
+/**** STORAGE POLICIES ****/
+
+//reserve() is called before a component is added to the array
+
+template<typename T>
+struct DenseStorage {
+    typedef T component_type;
+    typedef DenseIndexMap IndexMap;
+    static void reserve(std::vector<T>&) {}
+};
+
+template<typename T, int PAGE_SIZE = 256>
+struct SparseSetStorage {
+    typedef T component_type;
+    typedef PagedIndexMap<PAGE_SIZE> IndexMap;
+    static void reserve(std::vector<T>&) {}
+};
+
+template<typename T, size_t POOL_SIZE = 16>
+struct PooledStorage {
+    typedef T component_type;
+    typedef HashIndexMap IndexMap;
+    //grows by at least POOL_SIZE, and geometrically so large arrays are not
+    //copied on every pool
+    static void reserve(std::vector<T>& the_vec) {
+        if (the_vec.size() == the_vec.capacity())
+            the_vec.reserve(std::max(the_vec.size() + POOL_SIZE, 2 * the_vec.capacity()));
+    }
+};
+
+/**** REGISTRY ****/
+
+template<typename... Policies>
+struct ComponentRegistry {
+    static const int NUM_TYPES = sizeof...(Policies);
+
+    //one value of each component type
+    typedef std::tuple<typename Policies::component_type...> Values;
+    //one std::vector per component type
+    typedef std::tuple<std::vector<typename Policies::component_type>...> Arrays;
+    //one entity -> component index map per component type
+    typedef std::tuple<typename Policies::IndexMap...> IndexMaps;
+    //one bit per component type
+    typedef std::bitset<sizeof...(Policies)> Signature;
+
+    //index of component type T in the registry
+    template<typename T>
+    static constexpr int index() { return type_position<T, typename Policies::component_type...>::result; }
+
+    //storage policy chosen for T
+    template<typename T>
+    using Policy = typename std::tuple_element<index<T>(), std::tuple<Policies...>>::type;
+
+    //signature with the bits of all types in Ts set
+    template<typename... Ts>
+    static Signature signatureOf() {
+        Signature signature;
+        const int indices[] = { -1, index<Ts>()... };
+        for (int i : indices)
+            if (i != -1) signature.set(i);
+        return signature;
+    }
+};
@@ -0,0 +1,159 @@
+//
+//  ComponentView.h
+//
+//  A view is the set of entities which own all of a list of component types,
+//  e.g. ECS.view<Mesh, Transform>() gives every entity with a mesh and a transform.
+//  The ECS caches each match as a row of component array indices, so iterating a
+//  view goes straight to each component array instead of through the entity.
+//  Usage:
+//      ECS.view<Mesh, Transform>().each([](Mesh& mesh, Transform& transform) { ... });
+//  or
+//      auto meshes = ECS.view<Mesh, Transform>();
+//      for (size_t i = 0; i < meshes.size(); i++) { Mesh& m = meshes.get<Mesh>(i); ... }
+//  view.changedSince(tick) gives the same view, but each() and iteration skip entities
+//  none of whose components changed after tick (see change tracking in the ECS)
+//  each() and iteration also skip inactive entities (see ECS.setActive), using a
+//  bitset of the enabled matches, so they pass over 64 disabled entities at a time.
+//  Indexed loops see every match, and can test view.enabled(i) or use eachIndex()
+//  parallelEach() and parallelEachIndex() split the matches into chunks run as
+//  jobs (see JobSystem), so fn must only write the components of its match
+//
+#pragma once
+#include <vector>
+#include <array>
+#include <tuple>
+#include <cstdint>
+#include "ComponentRegistry.h" //type_position
+#include "EnabledBits.h"
+#include "JobSystem.h"
+
+//base class so the ECS can store caches of different views in one container
+struct ViewCacheBase {
+    virtual ~ViewCacheBase() {}
+    //structure version of the ECS when rows were last built
+    unsigned int version = 0;
+    bool built = false;
+};
+
+//one row per matching entity, each row stores the index of each component in its array
+template<typename... Ts>
+struct ViewCache : public ViewCacheBase {
+    typedef std::array<int, sizeof...(Ts)> Row;
+    std::vector<Row> rows;
+    //bit per row, set if its entity is active, and ECS activation version it was built at
+    EnabledBits enabled;
+    unsigned int activation_version = 0;
+};
+
+template<typename... Ts>
+class ComponentView {
+public:
+    typedef std::array<int, sizeof...(Ts)> Row;
+    //change versions of each component type, parallel to the component arrays
+    typedef std::array<const std::vector<uint32_t>*, sizeof...(Ts)> Versions;
+
+    //jobs may be null, then parallel loops run on the calling thread
+    ComponentView(const std::vector<Row>& rows, const EnabledBits& enabled, const Versions& versions, JobSystem* jobs, std::vector<Ts>*... arrays) :
+        rows_(&rows), enabled_(&enabled), jobs_(jobs), versions_(versions), arrays_(arrays...) {}
+
+    //number of entities matching the view
+    size_t size() const { return rows_->size(); }
+    bool empty() const { return rows_->empty(); }
+
+    //index of component of type T in its array, for match i
+    template<typename T>
+    int index(size_t i) const { return (*rows_)[i][type_position<T, Ts...>::result]; }
+
+    //component of type T for match i
+    template<typename T>
+    T& get(size_t i) const { return (*std::get<std::vector<T>*>(arrays_))[index<T>(i)]; }
+
+    //id of entity for match i
+    int owner(size_t i) const { return get<typename std::tuple_element<0, std::tuple<Ts...>>::type>(i).owner; }
+
+    //tuple of references to all components for match i
+    std::tuple<Ts&...> operator[](size_t i) const { return std::tuple<Ts&...>(get<Ts>(i)...); }
+
+    //newest change version among the components of match i
+    uint32_t version(size_t i) const {
+        uint32_t newest = 0;
+        for (size_t k = 0; k < sizeof...(Ts); k++) {
+            const uint32_t v = (*versions_[k])[(*rows_)[i][k]];
+            if (v > newest) newest = v;
+        }
+        return newest;
+    }
+
+    //copy of view which skips matches with no component changed after tick
+    //(size() and get() still see all matches)
+    ComponentView changedSince(uint32_t tick) const {
+        ComponentView filtered(*this);
+        filtered.since_ = tick;
+        return filtered;
+    }
+
+    //true if match i passes the changedSince filter
+    bool changed(size_t i) const { return since_ == 0 || version(i) > since_; }
+
+    //true if entity of match i is active
+    bool enabled(size_t i) const { return enabled_->test(i); }
+
+    //calls fn(i) for each enabled match which passes the changedSince filter
+    template<typename F>
+    void eachIndex(F fn) const {
+        enabled_->forEach([&](size_t i) {
+            if (changed(i)) fn(i);
+        });
+    }
+
+    //calls fn(Ts&...) for each enabled match
+    template<typename F>
+    void each(F fn) const {
+        eachIndex([&](size_t i) { fn(get<Ts>(i)...); });
+    }
+
+    //eachIndex in chunks of about grain matches, run concurrently
+    template<typename F>
+    void parallelEachIndex(F fn, size_t grain = 256) const {
+        auto chunk = [&](size_t begin, size_t end) {
+            enabled_->forEachInRange(begin, end, [&](size_t i) {
+                if (changed(i)) fn(i);
+            });
+        };
+        if (jobs_) jobs_->parallelForArray(nullptr, 0, size(), grain, chunk);
+        else chunk(0, size());
+    }
+
+    //each in chunks of about grain matches, run concurrently
+    template<typename F>
+    void parallelEach(F fn, size_t grain = 256) const {
+        parallelEachIndex([&](size_t i) { fn(get<Ts>(i)...); }, grain);
+    }
+
+    //iterator which dereferences to a tuple of references
+    class iterator {
+    public:
+        iterator(const ComponentView* view, size_t i) : view_(view), i_(i) { skip_(); }
+        std::tuple<Ts&...> operator*() const { return (*view_)[i_]; }
+        iterator& operator++() { i_++; skip_(); return *this; }
+        bool operator!=(const iterator& other) const { return i_ != other.i_; }
+        bool operator==(const iterator& other) const { return i_ == other.i_; }
+    private:
+        const ComponentView* view_;
+        size_t i_;
+        void skip_() {
+            i_ = view_->enabled_->findNext(i_);
+            while (i_ < view_->size() && !view_->changed(i_)) i_ = view_->enabled_->findNext(i_ + 1);
+        }
+    };
+    iterator begin() const { return iterator(this, 0); }
+    iterator end() const { return iterator(this, rows_->size()); }
+
+private:
+    const std::vector<Row>* rows_;
+    const EnabledBits* enabled_;
+    JobSystem* jobs_;
+    Versions versions_;
+    uint32_t since_ = 0;
+    std::tuple<std::vector<Ts>*...> arrays_;
+};
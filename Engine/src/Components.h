@@ -10,15 +10,21 @@
 //
 //    TO ADD A NEW COMPONENT TYPE:
 //    - define it as a sub-class of Component
-//    - add it to the ComponentArrays tuple
-//    - add it as a subtemplate of typetoint() and increment 'result' variable
-//    - increment NUM_TYPE_COMPONENTS
+//    - add it to the ComponentTypes list, choosing a storage policy
+//
+//    Components which are read in tight per-frame loops are kept small (see the
+//    size report in the debug GUI). Data those loops don't need lives in a
+//    separate component on the same entity, so it is stored in its own array
+//    and only loaded into cache by the code that uses it
 //
 #pragma once
 #include "includes.h"
 #include <vector>
 #include <functional>
+#include <cstdint>
 #include "Curve.h"
+#include "StringTable.h"
+#include "ComponentRegistry.h"
 
 /**** COMPONENTS ****/
 
@@ -26,19 +32,81 @@
 // - owner: id of Entity which owns the instance of the component
 struct Component {
     int owner;
-    int index = -1;
 };
 
 // Transform Component
-// - inherits a mat4 which represents a model matrix
-// - all_transform - reference to vector of all transforms
-struct Transform : public Component, public lm::mat4 {
+// - local transform stored in parts: position, rotation and scale, applied as
+//   scale, then rotation, then translation. Editing a part is exact (no drift
+//   from repeated matrix products) and parts can be interpolated
+// - the local matrix is composed whenever a part is set, so matrix() only
+//   reads and many systems may call it at the same time
+// - uniform scale (same size on every axis) is flagged, so the normal matrix
+//   needs no inverse (see TransformSystem)
+// - parent, first_child, next_sibling: hierarchy links, as indices into the
+//   transform array. Maintained by the ECS, so change them with ECS.setParent
+struct Transform : public Component {
     int parent = -1;
+    int first_child = -1;
+    int next_sibling = -1;
+
+    //local matrix
+    const lm::mat4& matrix() const { return matrix_; }
+
+    lm::vec3 position() const { return position_; }
+    void position(const lm::vec3& p) { position_ = p; updateMatrix_(); }
+    void position(float x, float y, float z) { position(lm::vec3(x, y, z)); }
+
+    const lm::quat& rotation() const { return rotation_; }
+    void rotation(const lm::quat& q) { rotation_ = q; rotation_.normalize(); updateMatrix_(); }
+
+    const lm::vec3& scale() const { return scale_; }
+    void scale(const lm::vec3& s) { setScale_(s); updateMatrix_(); }
+    void scale(float x, float y, float z) { scale(lm::vec3(x, y, z)); }
+    bool hasUniformScale() const { return uniform_scale_; }
+
+    //move in parent space
+    void translate(const lm::vec3& t) { position(position_ + t); }
+    void translate(float x, float y, float z) { translate(lm::vec3(x, y, z)); }
+    //rotate about own axis (applied before current rotation)
+    void rotateLocal(float angle_in_rad, const lm::vec3& axis) { rotation(rotation_ * lm::quat(angle_in_rad, axis)); }
+    //scale along own axes
+    void scaleLocal(float x, float y, float z) { scale(scale_.x * x, scale_.y * y, scale_.z * z); }
+
+    //sets the parts from matrix, which must be translation, rotation and scale
+    void set(const lm::mat4& m) {
+        lm::vec3 p, s;
+        lm::quat q;
+        m.decompose(p, q, s);
+        set(p, q, s);
+    }
+    //sets all three parts, composing the matrix once
+    void set(const lm::vec3& p, const lm::quat& q, const lm::vec3& s) {
+        position_ = p;
+        rotation_ = q;
+        rotation_.normalize();
+        setScale_(s);
+        updateMatrix_();
+    }
+
+    //multiplies up the parent chain on every call. Systems should read the
+    //world matrix cached by TransformSystem instead
     lm::mat4 getGlobalMatrix(std::vector<Transform>& transforms) {
         if (parent != - 1){
-            return transforms.at(parent).getGlobalMatrix(transforms) * *this;
+            return transforms.at(parent).getGlobalMatrix(transforms) * matrix();
         }
-        else return *this;
+        else return matrix();
+    }
+
+private:
+    lm::vec3 position_;
+    lm::quat rotation_;
+    lm::vec3 scale_ = lm::vec3(1.0f, 1.0f, 1.0f);
+    bool uniform_scale_ = true;
+    lm::mat4 matrix_;
+    void updateMatrix_() { matrix_.makeTransformMatrix(position_, rotation_, scale_); }
+    void setScale_(const lm::vec3& s) {
+        scale_ = s;
+        uniform_scale_ = fabsf(s.x) == fabsf(s.y) && fabsf(s.y) == fabsf(s.z);
     }
 };
 
@@ -146,20 +214,18 @@ enum LightType {
     LightTypeSpot= 2
 };
 
-//Light Component
-// - id of transform in ECS array
-struct Light : public Camera {
-    //position is given by transform
-    
+//Light Component - what is uploaded to the lights UBO every time a light changes,
+//in one cache line. Shadow data is in LightShadow
+// - position is given by transform
+struct Light : public Component {
     int type; //0 - directional; 1 - point; 2 - spot
+    int cast_shadow; //only used if entity also has a LightShadow
     lm::vec3 direction;
     lm::vec3 color;
     float linear_att;
     float quadratic_att;
     float spot_inner;
     float spot_outer;
-	int resolution;
-    int cast_shadow;
 	float radius = 0;
     
     Light() {
@@ -170,7 +236,6 @@ struct Light : public Camera {
         quadratic_att = 0.032f;
         spot_inner = 20.0f;
         spot_outer = 30.0f;
-		resolution = 1024;
         cast_shadow = 0;
 		calculateRadius();
     }
@@ -183,13 +248,23 @@ struct Light : public Camera {
 	}
 };
 
+//LightShadow Component - shadow map setup of a Light on the same entity. Only
+//lights with one (and cast_shadow set) are rendered in the shadow pass
+// - view_projection: light space matrix the shadow map is rendered with
+// - resolution: size of shadow map
+struct LightShadow : public Component {
+    lm::mat4 view_projection;
+    int resolution = 1024;
+};
+
 enum ColliderType {
     ColliderTypeBox,
     ColliderTypeRay
 };
 
 //ColliderComponent. Only specifies size - collider location is given by any
-//associated TransformComponent
+//associated TransformComponent. Results of collision tests are in Collision,
+//which ECS.createComponentForEntity<Collider> adds to the entity as well
 // - collider_type is the type according to enum above
 // - local_center is offset from transform
 // - local_halfwidth is used for box,
@@ -202,20 +277,22 @@ struct Collider: public Component {
     lm::vec3 direction; // for ray
     float max_distance; // for segment
     
-    //collision state
-    bool colliding;
-    int other;
-    lm::vec3 collision_point;
-    float collision_distance;
-    
     Collider() {
         local_halfwidth = lm::vec3(0.5, 0.5, 0.5); //default dimensions = 1 in each axis
         max_distance = 10000000.0f; //infinite ray by default
-        colliding = false; // not colliding
-        other = -1; //no other collider
     }
 };
 
+//Collision Component - collision state of a Collider, reset and written by
+//CollisionSystem every frame
+// - other_entity is the entity of the nearest collider hit, -1 if none
+struct Collision : public Component {
+    bool colliding = false;
+    int other_entity = -1;
+    lm::vec3 collision_point;
+    float collision_distance = 10000000.0f;
+};
+
 //Anchors GUI to part of screen
 enum GUIAnchor {
 	GUIAnchorTopLeft,
@@ -261,6 +338,14 @@ struct GUIText : public GUIElement {
 	lm::vec3 color = lm::vec3(1.0, 1.0, 1.0);
 };
 
+//pose of a transform at one animation frame
+struct AnimationKey {
+    lm::vec3 position;
+    lm::quat rotation;
+    lm::vec3 scale = lm::vec3(1.0f, 1.0f, 1.0f);
+};
+
+//plays keyframes in a loop, blending between consecutive frames
 struct Animation : public Component {
     std::string name = "";
     GLint target_transform = -1;
@@ -268,62 +353,94 @@ struct Animation : public Component {
     GLuint curr_frame = 0;
     float ms_frame = 0;
     float ms_counter = 0;
-    std::vector<lm::mat4> keyframes;
+    std::vector<AnimationKey> keyframes;
 };
 
+//components read in tight loops must stay within one cache line
+static_assert(sizeof(Light) <= 64, "Light must fit in one cache line");
+static_assert(sizeof(Collider) <= 64, "Collider must fit in one cache line");
+static_assert(sizeof(Collision) <= 32, "Collision must fit in half a cache line");
+
 /**** COMPONENT STORAGE ****/
 
-//add new component type vectors here to store them in *ECS*
-typedef std::tuple<
-std::vector<Transform>,
-std::vector<Mesh>,
-std::vector<Camera>,
-std::vector<Light>,
-std::vector<Collider>,
-std::vector<GUIElement>,
-std::vector<GUIText>,
-std::vector<Animation>,
-std::vector<ViewTrack>
-> ComponentArrays;
+//add new component types here to store them in *ECS*, with their storage
+//policy (see ComponentRegistry.h)
+typedef ComponentRegistry<
+DenseStorage<Transform>,
+DenseStorage<Mesh>,
+PooledStorage<Camera>,
+PooledStorage<Light>,
+PooledStorage<LightShadow>,
+SparseSetStorage<Collider>,
+SparseSetStorage<Collision>,
+SparseSetStorage<GUIElement>,
+SparseSetStorage<GUIText>,
+SparseSetStorage<Animation>,
+PooledStorage<ViewTrack>
+> ComponentTypes;
+
+//tuple with one std::vector per component type
+typedef ComponentTypes::Arrays ComponentArrays;
+
+//number of component types
+const int NUM_TYPE_COMPONENTS = ComponentTypes::NUM_TYPES;
+
+//one bit per component type, set if the entity has that component
+typedef ComponentTypes::Signature ComponentSignature;
 
 //way of mapping different types to an integer value i.e.
 //the index within ComponentArrays
-template< typename T >
-struct type2int{};
-template<> struct type2int<Transform> { enum { result = 0 }; };
-template<> struct type2int<Mesh> { enum { result = 1 }; };
-template<> struct type2int<Camera> { enum { result = 2 }; };
-template<> struct type2int<Light> { enum { result = 3 }; };
-template<> struct type2int<Collider> { enum { result = 4 }; };
-template<> struct type2int<GUIElement> { enum { result = 5 }; };
-template<> struct type2int<GUIText> { enum { result = 6 }; };
-template<> struct type2int<Animation> { enum { result = 7 }; };
-template<> struct type2int<ViewTrack> { enum { result = 8 }; };
-
-//UPDATE THIS!
-const int NUM_TYPE_COMPONENTS = 9;
+template<typename T>
+constexpr int componentIndex() { return ComponentTypes::index<T>(); }
 
 /**** ENTITY ****/
 
+//32-bit generational handle to an entity
+// - low INDEX_BITS bits are the index of the entity in the ECS entities array
+// - high bits are the generation of that slot when the handle was created
+//when an entity is destroyed its slot generation is incremented, so any handle
+//still pointing at it (or at a recycled entity in the same slot) is detected as stale
+struct EntityHandle {
+    static const uint32_t INDEX_BITS = 20;
+    static const uint32_t INDEX_MASK = (1u << INDEX_BITS) - 1;
+    static const uint32_t GENERATION_MASK = (1u << (32 - INDEX_BITS)) - 1;
+    static const uint32_t NULL_VALUE = 0xffffffff;
+
+    uint32_t value = NULL_VALUE;
+
+    EntityHandle() {}
+    EntityHandle(int index, uint32_t generation) {
+        value = ((generation & GENERATION_MASK) << INDEX_BITS) | ((uint32_t)index & INDEX_MASK);
+    }
+
+    int index() const { return (int)(value & INDEX_MASK); }
+    uint32_t generation() const { return value >> INDEX_BITS; }
+    bool isNull() const { return value == NULL_VALUE; }
+
+    bool operator == (const EntityHandle& other) const { return value == other.value; }
+    bool operator != (const EntityHandle& other) const { return value != other.value; }
+};
+
 struct Entity {
-    //name is used to store entity
-    std::string name;
-    //array of handles into ECM component arrays
-    int components[NUM_TYPE_COMPONENTS];
+    //name is used to store entity - interned, see StringTable.h
+    StringID name;
+    //which component types the entity has. Indices of the components
+    //are kept by the ECS, see ComponentRegistry.h
+    ComponentSignature signature;
     //sets active or not
     bool active = true;
+    //false once destroyed, until the slot is recycled by a new entity
+    bool alive = true;
+    //incremented every time this slot is destroyed, see EntityHandle
+    uint32_t generation = 0;
     
-    Entity() {
-        for (int i = 0; i < NUM_TYPE_COMPONENTS; i++) { components[i] = -1;}
-    }
-    Entity(std::string a_name) : name(a_name) {
-        for (int i = 0; i < NUM_TYPE_COMPONENTS; i++) { components[i] = -1;}
-    }
+    Entity() {}
+    Entity(std::string a_name) : name(a_name) {}
 
     // Improve this method, check if entity exists and is initialized.
     bool isValid()
     {
-        if (name != "")
+        if (!name.empty())
             return true;
 
         return false;
@@ -16,14 +16,16 @@ void ControlSystem::key_mouse_callback(int key_button, int action, int mods) {
 }
 
 //called from hardware input (via game)
+//movement adds up until the next simulation step uses it, so none is lost or
+//applied twice when frames and steps don't match one to one
 void ControlSystem::updateMousePosition(int new_x, int new_y) {
-	mouse.delta_x = new_x - mouse.x;
-	mouse.delta_y = new_y - mouse.y;
+	mouse.delta_x += new_x - mouse.x;
+	mouse.delta_y += new_y - mouse.y;
 	mouse.x = new_x;
 	mouse.y = new_y;
 }
 
-//called once per frame
+//called once per fixed simulation step
 void ControlSystem::update(float dt) {
 	if (control_type == ControlTypeFPS) {
 		updateFPS(dt);
@@ -31,6 +33,7 @@ void ControlSystem::update(float dt) {
 	else {
 		updateFree(dt);
 	}
+	mouse.delta_x = mouse.delta_y = 0;
 
 	//check if switch to Debug cam
 	if (input[GLFW_KEY_O] == true) {
@@ -46,8 +49,8 @@ void ControlSystem::update(float dt) {
 //update an entity with a free movement control component 
 void ControlSystem::updateFree(float dt) {
 
-	Camera& camera = ECS.getComponentInArray<Camera>(ECS.main_camera);
-	Transform& transform = ECS.getComponentFromEntity<Transform>(camera.owner);
+	Camera& camera = ECS.getComponentInArrayForWrite<Camera>(ECS.main_camera);
+	Transform& transform = ECS.getComponentFromEntityForWrite<Transform>(camera.owner);
 
 	//multiply speeds by delta time 
 	float move_speed_dt = move_speed_ * dt;
@@ -81,8 +84,8 @@ void ControlSystem::updateFree(float dt) {
 }
 
 void ControlSystem::updateFPS(float dt) {
-	Camera& camera = ECS.getComponentInArray<Camera>(ECS.main_camera);
-	Transform& transform = ECS.getComponentFromEntity<Transform>(camera.owner);
+	Camera& camera = ECS.getComponentInArrayForWrite<Camera>(ECS.main_camera);
+	Transform& transform = ECS.getComponentFromEntityForWrite<Transform>(camera.owner);
 
 	//multiply speeds by delta time 
 	float move_speed_dt = move_speed_ * dt;
@@ -100,13 +103,12 @@ void ControlSystem::updateFPS(float dt) {
 		camera.forward = R_pitch * camera.forward;
 	}
 
-	//fps control should have five ray colliders assigned
-	auto& colliders = ECS.getAllComponents<Collider>();
-	Collider& collider_down = colliders[FPS_collider_down];
-	Collider& collider_forward = colliders[FPS_collider_forward];
-	Collider& collider_left = colliders[FPS_collider_left];
-	Collider& collider_right = colliders[FPS_collider_right];
-	Collider& collider_back = colliders[FPS_collider_back];
+	//fps control should have five ray colliders assigned - read their collision state
+	Collision& collider_down = ECS.getComponentFromEntity<Collision>(FPS_collider_down);
+	Collision& collider_forward = ECS.getComponentFromEntity<Collision>(FPS_collider_forward);
+	Collision& collider_left = ECS.getComponentFromEntity<Collision>(FPS_collider_left);
+	Collision& collider_right = ECS.getComponentFromEntity<Collision>(FPS_collider_right);
+	Collision& collider_back = ECS.getComponentFromEntity<Collision>(FPS_collider_back);
 
 	//collisions and gravity
 	//player down ray is always colliding, we need to keep player at 'FPS_height' units above nearest collider
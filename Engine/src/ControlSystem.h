@@ -5,9 +5,9 @@
 
 //struct to store mouse state
 struct Mouse {
-	int x;
-	int y;
-	int delta_x, delta_y;
+	int x = 0;
+	int y = 0;
+	int delta_x = 0, delta_y = 0;
 };
 
 enum ControlType {
@@ -35,7 +35,7 @@ public:
 	//mouse is public, it's just four ints
 	Mouse mouse;
 
-	//FPS stuff
+	//FPS stuff - ids of the entities which own the ray colliders
 	int FPS_collider_down;
 	int FPS_collider_left;
 	int FPS_collider_right;
@@ -3,6 +3,23 @@
 #include "Parsers.h"
 #include "shaders_default.h"
 #include "Game.h"
+#include "linmath_batch.h"
+#include "ArchetypeStorage.h"
+#include <chrono>
+
+//benchmark loops write their result here, so the optimiser cannot remove them
+static volatile float benchmark_sink = 0.0f;
+
+//layout measured by the storage benchmark in the imGUI window. Define
+//ECS_ARCHETYPE_STORAGE in the project settings to measure archetype chunks,
+//otherwise the tuple-of-vectors layout used by the EntityComponentStore
+#ifdef ECS_ARCHETYPE_STORAGE
+typedef ArchetypeStorage<Transform, Mesh, Light, Collider> BenchmarkStorage;
+#define BENCHMARK_STORAGE_NAME "archetype chunks"
+#else
+typedef VectorStorage<Transform, Mesh, Light, Collider> BenchmarkStorage;
+#define BENCHMARK_STORAGE_NAME "component vectors"
+#endif
 
 DebugSystem::~DebugSystem() {
 	delete grid_shader_;
@@ -13,6 +30,19 @@ void DebugSystem::init(GraphicsSystem* gs) {
 	graphics_system_ = gs;
 }
 
+//the picking ray is an entity, so a new world needs its own
+void DebugSystem::onWorldSwapped() {
+	createPickingRay_();
+}
+
+void DebugSystem::createPickingRay_() {
+	ent_picking_ray_ = ECS.createEntity("picking_ray");
+	Collider& picking_ray = ECS.createComponentForEntity<Collider>(ent_picking_ray_);
+	picking_ray.collider_type = ColliderTypeRay;
+	picking_ray.direction = lm::vec3(0, 0, -1);
+	picking_ray.max_distance = 0.001f;
+}
+
 void DebugSystem::lateInit() {
 	//init booleans
 	draw_grid_ = false;
@@ -37,11 +67,7 @@ void DebugSystem::lateInit() {
 	icon_camera_texture_ = Parsers::parseTexture("data/assets/icon_camera.tga");
 
 	//picking collider
-	ent_picking_ray_ = ECS.createEntity("picking_ray");
-	Collider& picking_ray = ECS.createComponentForEntity<Collider>(ent_picking_ray_);
-	picking_ray.collider_type = ColliderTypeRay;
-	picking_ray.direction = lm::vec3(0, 0, -1);
-	picking_ray.max_distance = 0.001f;
+	createPickingRay_();
 
 	setActive(true);
 
@@ -110,6 +136,12 @@ void DebugSystem::setActive(bool a) {
 //called once per frame
 void DebugSystem::update(float dt) {
 
+	//requested from imGUI last frame
+	if (defragment_requested_) {
+		defragmentScene_();
+		defragment_requested_ = false;
+	}
+
 	//get the camera view projection matrix
 	lm::mat4 vp = ECS.getComponentInArray<Camera>(Game::instance->camera_system_.GetOutputCamera()).view_projection;
     Geometry::drawLine(lm::vec3(0, 0, 0), lm::vec3(0, 10, 0));
@@ -167,7 +199,7 @@ void DebugSystem::update(float dt) {
                 cc.setPerspective(cc.fov, (float)Game::instance->window_width_ / (float)Game::instance->window_height_,cc.near, 2);
                 cc.update();
 				lm::mat4 cam_iv = cc.view_matrix;
-				cam_iv.inverse();
+				cam_iv.inverseAffine();
 				lm::mat4 cam_ip = cc.projection_matrix;
 				cam_ip.inverse();
 				lm::mat4 cam_ivp = cc.view_projection;
@@ -184,10 +216,10 @@ void DebugSystem::update(float dt) {
 			}
 
 			//now for lights
-			auto& lights = ECS.getAllComponents<Light>();
-			for (auto& ll : lights) {
-				if (!ll.cast_shadow) continue;
-				lm::mat4 light_ivp = ll.view_projection;
+			auto shadow_lights = ECS.view<Light, LightShadow>();
+			for (size_t i = 0; i < shadow_lights.size(); i++) {
+				if (!shadow_lights.get<Light>(i).cast_shadow) continue;
+				lm::mat4 light_ivp = shadow_lights.get<LightShadow>(i).view_projection;
 				light_ivp.inverse();
 				lm::mat4 mvp = vp * light_ivp;
 
@@ -206,7 +238,7 @@ void DebugSystem::update(float dt) {
 				//get transform for collider
 				Transform& tc = ECS.getComponentFromEntity<Transform>(cc.owner);
 				//get the colliders local model matrix in order to draw correctly
-				lm::mat4 collider_matrix = tc.getGlobalMatrix(ECS.getAllComponents<Transform>());
+				lm::mat4 collider_matrix = Game::instance->transform_system_.renderWorld(tc);
 
 				if (cc.collider_type == ColliderTypeBox) {
 
@@ -281,7 +313,7 @@ void DebugSystem::update(float dt) {
 		for (auto& curr_light : lights) {
 			Transform& curr_light_transform = ECS.getComponentFromEntity<Transform>(curr_light.owner);
 
-			lm::mat4 mvp_matrix = vp * curr_light_transform.getGlobalMatrix(ECS.getAllComponents<Transform>());;
+			lm::mat4 mvp_matrix = vp * Game::instance->transform_system_.renderWorld(curr_light_transform);
 			//BILLBOARDS
 			//the mvp for the light contains rotation information. We want it to look at the camera always.
 			//So we zero out first three columns of matrix, which contain the rotation information
@@ -306,20 +338,30 @@ void DebugSystem::update(float dt) {
 	updateimGUI_(dt);
 }
 
-// recursive function to render a transform node in imGUI
-void DebugSystem::imGuiRenderTransformNode(TransformNode& trans) {
-	auto& ent = ECS.entities[trans.entity_owner];
+// recursive function to render a transform node, and its children, in imGUI
+void DebugSystem::imGuiRenderTransformNode(int trans_id) {
+	auto& transforms = ECS.getAllComponents<Transform>();
+	const int entity_owner = transforms[trans_id].owner;
+	auto& ent = ECS.entities[entity_owner];
 	if (ImGui::TreeNode(ent.name.c_str())) {
-		Transform& transform = ECS.getComponentFromEntity<Transform>(ent.name);
-		if (ECS.getComponentID<Light>(trans.entity_owner) != -1) {
-			graphics_system_->needUpdateLights = true;
-		}
+		Transform& transform = transforms[trans_id];
 		lm::vec3 pos = transform.position();
 		float pos_array[3] = { pos.x, pos.y, pos.z };
-		ImGui::DragFloat3("Position", pos_array);
-		transform.position(pos_array[0], pos_array[1], pos_array[2]);
+		if (ImGui::DragFloat3("Position", pos_array)) {
+			transform.position(pos_array[0], pos_array[1], pos_array[2]);
+			ECS.markChanged<Transform>(trans_id);
+		}
+		lm::vec3 scale = transform.scale();
+		float scale_array[3] = { scale.x, scale.y, scale.z };
+		if (ImGui::DragFloat3("Scale", scale_array, 0.01f)) {
+			transform.scale(scale_array[0], scale_array[1], scale_array[2]);
+			ECS.markChanged<Transform>(trans_id);
+		}
+		bool active = ent.active;
+		if (ImGui::Checkbox("Active", &active))
+			ECS.setActive(entity_owner, active);
 
-		for (auto& child : trans.children) {
+		for (int child = transform.first_child; child != -1; child = transforms[child].next_sibling) {
 
 			imGuiRenderTransformNode(child);
 		}
@@ -380,47 +422,18 @@ void DebugSystem::updateimGUI_(float dt) {
 		//	ImGui::TreePop();
 		//}
 
-		//create a tree of TransformNodes objects (defined in DebugSystem.h)
-        //which represents the current scene graph
-        
-        // 1) create a temporary array with ALL transforms
-		std::vector<TransformNode> transform_nodes;
-		auto& all_transforms = ECS.getAllComponents<Transform>();
-		for (size_t i = 0; i < all_transforms.size(); i++) {
-			TransformNode tn;
-			tn.trans_id = (int)i;
-			tn.entity_owner = all_transforms[i].owner;
-			tn.ent_name = ECS.entities[tn.entity_owner].name;
-			if (all_transforms[i].parent == -1)
-				tn.isTop = true;
-			transform_nodes.push_back(tn);
-		}
-        
-		// 2) traverse array to assign children to their parents
-		for (size_t i = 0; i < transform_nodes.size(); i++) {
-			int parent = all_transforms[i].parent;
-			if (parent != -1) {
-				transform_nodes[parent].children.push_back(transform_nodes[i]);
-			}
-		}
-        
-		// 3) create a new array with only top level nodes of transform tree
-		std::vector<TransformNode> transform_topnodes;
-		for (size_t i = 0; i < transform_nodes.size(); i++) {
-			if (transform_nodes[i].isTop)
-				transform_topnodes.push_back(transform_nodes[i]);
-		}
-
         //create 2 imGUI columns, first contains transform tree
         //second contains selected item from picking
 		ImGui::Columns(2, "columns");
 
-		//draw all the nodes
-		for (auto& trans : transform_topnodes) {
+		//draw the scene graph from each top level transform
+		auto& all_transforms = ECS.getAllComponents<Transform>();
+		for (size_t i = 0; i < all_transforms.size(); i++) {
+			if (all_transforms[i].parent != -1) continue;
             //this is a recursive function (defined above)
             //which draws a transform node (and its children)
-            //using imGUI
-			imGuiRenderTransformNode(trans);
+            //using imGUI, following the hierarchy links of the ECS
+			imGuiRenderTransformNode((int)i);
 		}
 
         //*** PICKING*** //
@@ -435,22 +448,99 @@ void DebugSystem::updateimGUI_(float dt) {
         //next column for picking
 		ImGui::NextColumn();
     
-		//get the pick ray first
-		Collider& pick_ray_collider = ECS.getComponentFromEntity<Collider>(ent_picking_ray_);
+		//get the pick ray collision first
+		Collision& pick_ray_collision = ECS.getComponentFromEntity<Collision>(ent_picking_ray_);
 
 		//is it colliding? if so, get pitcked, entity, and transform, and render imGUI text
 		int picked_entity = -1;
-		if (pick_ray_collider.colliding) {
-			//get the other collider and entity
-			Collider& picked_collider = ECS.getComponentInArray<Collider>(pick_ray_collider.other);
-			picked_entity = picked_collider.owner;
+		if (pick_ray_collision.colliding) {
+			//get the entity of the other collider
+			picked_entity = pick_ray_collision.other_entity;
 			Transform& picked_transform = ECS.getComponentFromEntity<Transform>(picked_entity);
 			ImGui::Text("Selected entity:");
-			ImGui::TextColored(ImVec4(1, 1, 0, 1), ECS.entities[picked_collider.owner].name.c_str());
+			ImGui::TextColored(ImVec4(1, 1, 0, 1), ECS.entities[picked_entity].name.c_str());
+			if (ImGui::Button("Delete")) {
+				//deferred, as destroying now could move the pick ray collider
+				ECS.getCommandBuffer(0).destroyEntity(ECS.getHandle(picked_entity));
+				pick_ray_collision.colliding = false;
+			}
 		}
 
         Game::instance->camera_system_.renderInMenu();
 
+		//storage benchmark
+		if (ImGui::Button("Benchmark storage"))
+			benchmarkStorage_(100);
+		if (benchmark_entities_) {
+			ImGui::Text("%s, %d entities", BENCHMARK_STORAGE_NAME, benchmark_entities_);
+			ImGui::Text("cull: %.3f ms (%d visible) shadow: %.3f ms", benchmark_cull_ms_, benchmark_visible_, benchmark_shadow_ms_);
+		}
+		//run at start of next update, as it moves the components referenced here
+		if (ImGui::Button("Defragment"))
+			defragment_requested_ = true;
+		if (defragment_before_ms_ > 0.0)
+			ImGui::Text("traverse: %.3f ms before, %.3f ms after", defragment_before_ms_, defragment_after_ms_);
+
+		if (ImGui::CollapsingHeader("Component sizes"))
+			imGuiComponentSizes_();
+
+		//last step's and last frame's systems: a row per thread, a bar per
+		//system while it ran
+		if (ImGui::CollapsingHeader("Systems")) {
+			ImGui::Text("%d fixed steps of %.2f ms last frame, interpolated at %.2f", Game::instance->getStepsLastFrame(),
+				Game::FIXED_DT * 1000.0f, Game::instance->getInterpolationAlpha());
+			ImGui::Text("simulate and extract %.2f ms, draw last frame %.2f ms (overlapped)",
+				Game::instance->getSimulateMs(), Game::instance->getDrawMs());
+			bool rewind = Game::instance->isRewindEnabled();
+			if (ImGui::Checkbox("Rewind snapshots", &rewind)) Game::instance->setRewindEnabled(rewind);
+			imGuiSystemTimeline_("simulation step", Game::instance->getSimulationTimeline());
+			imGuiSystemTimeline_("after draw", Game::instance->getRenderTimeline());
+		}
+
+		//work spread over frames under a budget, and what it has left
+		if (ImGui::CollapsingHeader("Time slicing")) {
+			const TimeSlicedScheduler& sliced = Game::instance->getTimeSlicedScheduler();
+			ImGui::Text("%.3f of %.3f ms spent, backlog %d", sliced.getSpentMs(), sliced.getBudgetMs(), (int)sliced.getBacklog());
+			for (int i = 0; i < sliced.getNumWorkloads(); i++) {
+				const TimeSlicedScheduler::Workload& workload = sliced.getWorkload(i);
+				ImGui::Text("%s (priority %d): %.3f ms, backlog %d, waited %d frames", workload.name, workload.priority,
+					workload.ms, (int)workload.backlog, workload.frames_waiting);
+			}
+		}
+
+		//transform propagation: serial or by hierarchy level as parallel jobs
+		if (ImGui::CollapsingHeader("Transforms")) {
+			TransformSystem& transform_system = Game::instance->transform_system_;
+			bool parallel = transform_system.isParallel();
+			if (ImGui::Checkbox("Parallel propagation", &parallel))
+				transform_system.setParallel(parallel);
+			ImGui::Text("%d threads, %d world matrices updated", transform_system.getNumThreads(), transform_system.getNumUpdated());
+			if (ImGui::Button("Benchmark transforms"))
+				transform_benchmark_ = transform_system.benchmark(50000);
+			if (transform_benchmark_.num_transforms) {
+				const TransformSystem::Benchmark& b = transform_benchmark_;
+				ImGui::Text("%d transforms%s", b.num_transforms, b.results_match ? "" : " (results differ!)");
+				ImGui::Text("flat: serial %.3f ms parallel %.3f ms", b.flat_serial_ms, b.flat_parallel_ms);
+				ImGui::Text("deep: serial %.3f ms parallel %.3f ms", b.deep_serial_ms, b.deep_parallel_ms);
+			}
+		}
+
+		//SIMD math backend, timed and checked against the scalar code
+		if (ImGui::CollapsingHeader("Math")) {
+			ImGui::Text("lm backend: %s", lm::simdBackend());
+			if (ImGui::Button("Check SIMD math"))
+				simd_check_ = lm::checkSimd(100000);
+			ImGui::SameLine();
+			if (ImGui::Button("Check batch math"))
+				batch_check_ = lm::checkBatch(100000);
+			for (const lm::SimdCheck* check : { &simd_check_, &batch_check_ }) {
+				if (!check->num_inputs) continue;
+				ImGui::Text("%d inputs, tolerance %g: %s", check->num_inputs, check->tolerance, check->passed ? "passed" : "FAILED");
+				for (const lm::SimdCheck::Op& op : check->ops)
+					ImGui::Text("%s: scalar %.3f ms %s %.3f ms, error %g", op.name, op.scalar_ms, check->backend, op.simd_ms, op.max_error);
+			}
+		}
+
 		ImGui::End();
 
 		// Rendering
@@ -459,6 +549,133 @@ void DebugSystem::updateimGUI_(float dt) {
 	}
 }
 
+//draws when and on which thread each system of a timeline ran
+void DebugSystem::imGuiSystemTimeline_(const char* label, const SystemTimeline& timeline) {
+	const int num_threads = Game::instance->job_system_.getNumThreads();
+	ImGui::Text("%s %.3f ms on %d threads, parallelism %.2f", label, timeline.frame_ms, num_threads, timeline.parallelism);
+	if (timeline.frame_ms <= 0) return;
+
+	const float row_height = ImGui::GetTextLineHeightWithSpacing();
+	const float width = ImGui::GetContentRegionAvail().x;
+	const float ms_to_px = width / (float)timeline.frame_ms;
+	const ImVec2 origin = ImGui::GetCursorScreenPos();
+	ImDrawList* draw_list = ImGui::GetWindowDrawList();
+	draw_list->AddRectFilled(origin, ImVec2(origin.x + width, origin.y + row_height * num_threads), IM_COL32(40, 40, 40, 255));
+	for (const SystemTimeline::Entry& entry : timeline.entries) {
+		const ImVec2 from(origin.x + (float)entry.start_ms * ms_to_px, origin.y + row_height * entry.thread);
+		const ImVec2 to(std::max(origin.x + (float)entry.end_ms * ms_to_px, from.x + 1.0f), from.y + row_height - 1.0f);
+		draw_list->AddRectFilled(from, to, IM_COL32(70, 130, 180, 255));
+		if (to.x - from.x > ImGui::CalcTextSize(entry.name).x)
+			draw_list->AddText(from, IM_COL32_WHITE, entry.name);
+	}
+	ImGui::Dummy(ImVec2(width, row_height * num_threads));
+
+	for (const SystemTimeline::Entry& entry : timeline.entries)
+		ImGui::Text("%s: thread %d, %.3f to %.3f ms", entry.name, entry.thread, entry.start_ms, entry.end_ms);
+}
+
+//copies current scene 'copies' times into a BenchmarkStorage, then times
+//two passes which read few fields of many entities:
+// - cull: reads transform position of every entity
+// - shadow: reads transform matrix of every entity with a mesh
+//build twice, with and without ECS_ARCHETYPE_STORAGE, to compare layouts
+void DebugSystem::benchmarkStorage_(int copies) {
+	BenchmarkStorage storage;
+	auto& entities = ECS.entities;
+	storage.reserve(entities.size() * copies);
+	benchmark_entities_ = 0;
+	for (int c = 0; c < copies; c++) {
+		for (size_t i = 0; i < entities.size(); i++) {
+			if (!entities[i].alive) continue;
+			int e = storage.createEntity();
+			if (ECS.getComponentID<Transform>((int)i) != -1)
+				storage.add<Transform>(e) = ECS.getComponentFromEntity<Transform>((int)i);
+			if (ECS.getComponentID<Mesh>((int)i) != -1)
+				storage.add<Mesh>(e) = ECS.getComponentFromEntity<Mesh>((int)i);
+			if (ECS.getComponentID<Light>((int)i) != -1)
+				storage.add<Light>(e) = ECS.getComponentFromEntity<Light>((int)i);
+			if (ECS.getComponentID<Collider>((int)i) != -1)
+				storage.add<Collider>(e) = ECS.getComponentFromEntity<Collider>((int)i);
+			benchmark_entities_++;
+		}
+	}
+
+	Camera& cam = ECS.getComponentInArray<Camera>(Game::instance->camera_system_.GetOutputCamera());
+	lm::vec3 cam_pos = cam.position;
+	lm::mat4 vp = cam.view_projection;
+
+	auto t0 = std::chrono::high_resolution_clock::now();
+	int visible = 0;
+	storage.each<Transform>([&](Transform& t) {
+		const lm::vec3 pos = t.position();
+		float dx = pos.x - cam_pos.x, dy = pos.y - cam_pos.y, dz = pos.z - cam_pos.z;
+		if (dx * dx + dy * dy + dz * dz < 10000.0f) visible++;
+	});
+	auto t1 = std::chrono::high_resolution_clock::now();
+	float checksum = 0.0f;
+	storage.each<Mesh, Transform>([&](Mesh&, Transform& t) {
+		lm::mat4 mvp = vp * t.matrix();
+		checksum += mvp.m[15];
+	});
+	auto t2 = std::chrono::high_resolution_clock::now();
+
+	benchmark_cull_ms_ = std::chrono::duration<double, std::milli>(t1 - t0).count();
+	benchmark_shadow_ms_ = std::chrono::duration<double, std::milli>(t2 - t1).count();
+	benchmark_visible_ = visible;
+	benchmark_sink = checksum;
+}
+
+template<typename T>
+void DebugSystem::imGuiComponentSize_(const char* name) {
+	const int size = (int)sizeof(T);
+	const int count = (int)ECS.getAllComponents<T>().size();
+	ImGui::Text("%-12s %4d B %2d line(s) x %5d = %8d B", name, size, (size + 63) / 64, count, size * count);
+}
+
+//hot components (read in tight loops) should take one cache line or less
+void DebugSystem::imGuiComponentSizes_() {
+	ImGui::Text("%-12s %4d B", "Entity", (int)sizeof(Entity));
+	imGuiComponentSize_<Transform>("Transform");
+	imGuiComponentSize_<Mesh>("Mesh");
+	imGuiComponentSize_<Camera>("Camera");
+	imGuiComponentSize_<Light>("Light");
+	imGuiComponentSize_<LightShadow>("LightShadow");
+	imGuiComponentSize_<Collider>("Collider");
+	imGuiComponentSize_<Collision>("Collision");
+	imGuiComponentSize_<GUIElement>("GUIElement");
+	imGuiComponentSize_<GUIText>("GUIText");
+	imGuiComponentSize_<Animation>("Animation");
+	imGuiComponentSize_<ViewTrack>("ViewTrack");
+}
+
+//walks the scene resolving the world matrix of every mesh and collider through
+//parent transforms, without the transform system cache, so the timing shows
+//the effect of memory order. Returns time in ms
+double DebugSystem::traverseScene_() {
+	auto& transforms = ECS.getAllComponents<Transform>();
+	auto t0 = std::chrono::high_resolution_clock::now();
+	float checksum = 0.0f;
+	ECS.view<Mesh, Transform>().each([&](Mesh&, Transform& t) {
+		checksum += t.getGlobalMatrix(transforms).m[12];
+	});
+	ECS.view<Collider, Transform>().each([&](Collider&, Transform& t) {
+		checksum += t.getGlobalMatrix(transforms).m[12];
+	});
+	auto t1 = std::chrono::high_resolution_clock::now();
+	benchmark_sink = checksum;
+	return std::chrono::duration<double, std::milli>(t1 - t0).count();
+}
+
+//defragments ECS into spatial order, timing a traversal before and after.
+//Timing differences come from cache misses, which can be counted with a
+//profiler (e.g. VTune, perf) around these two calls
+void DebugSystem::defragmentScene_() {
+	defragment_before_ms_ = traverseScene_();
+	ECS.defragment(EntityComponentStore::DefragmentMorton);
+	graphics_system_->sortMeshes();
+	defragment_after_ms_ = traverseScene_();
+}
+
 //this function takes a mouse screen point and fires a ray into the world
 //using the inverse viewprojection matrux
 void DebugSystem::setPickingRay(int mouse_x, int mouse_y, int screen_width, int screen_height) {
@@ -487,7 +704,7 @@ void DebugSystem::setPickingRay(int mouse_x, int mouse_y, int screen_width, int
 
     //set the picking ray
     //the actual collision detection will be done next frame in the CollisionSystem
-	Transform& pick_ray_transform = ECS.getComponentFromEntity<Transform>(ent_picking_ray_);
+	Transform& pick_ray_transform = ECS.getComponentFromEntityForWrite<Transform>(ent_picking_ray_);
 	Collider& pick_ray_collider = ECS.getComponentFromEntity<Collider>(ent_picking_ray_);
 	pick_ray_transform.position(cam.position);
 	pick_ray_collider.direction = (mouse_world_3 - cam.position).normalize();
@@ -3,16 +3,10 @@
 #include "Shader.h"
 #include <vector>
 #include "GraphicsSystem.h"
+#include "TransformSystem.h"
+#include "SystemScheduler.h"
 
 
-struct TransformNode {
-	std::vector<TransformNode> children;
-	int trans_id;
-	int entity_owner;
-	std::string ent_name;
-	bool isTop = false;
-};
-
 class DebugSystem {
 public:
 	
@@ -20,6 +14,8 @@ public:
 	void init(GraphicsSystem* gs);
 	void lateInit();
 	void update(float dt);
+	//call after the ECS world is swapped (see LevelLoader.h)
+	void onWorldSwapped();
 
 	void setActive(bool a);
 
@@ -76,13 +72,40 @@ private:
 	Shader* icon_shader_;
 
 	//imGUI
-	void imGuiRenderTransformNode(TransformNode& trans);
+	void imGuiRenderTransformNode(int trans_id);
 	bool show_imGUI_ = false;
 	void updateimGUI_(float dt);
 
 	//picking
 	bool can_fire_picking_ray_ = true;
 	int ent_picking_ray_;
+	void createPickingRay_();
+
+	//component storage benchmark
+	void benchmarkStorage_(int copies);
+	int benchmark_entities_ = 0;
+	int benchmark_visible_ = 0;
+	double benchmark_cull_ms_ = 0.0;
+	double benchmark_shadow_ms_ = 0.0;
+
+	//serial vs parallel transform propagation benchmark
+	TransformSystem::Benchmark transform_benchmark_;
+	//SIMD vs scalar math check, and batch kernels vs single value functions
+	lm::SimdCheck simd_check_;
+	lm::SimdCheck batch_check_;
+
+	//size report: bytes and cache lines per component, and bytes per array
+	template<typename T>
+	void imGuiComponentSize_(const char* name);
+	void imGuiComponentSizes_();
+	void imGuiSystemTimeline_(const char* label, const SystemTimeline& timeline);
+
+	//defragment with traversal timing before/after
+	double traverseScene_();
+	void defragmentScene_();
+	double defragment_before_ms_ = 0.0;
+	double defragment_after_ms_ = 0.0;
+	bool defragment_requested_ = false;
 	
 };
 
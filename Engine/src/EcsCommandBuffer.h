@@ -0,0 +1,116 @@
+//
+//  EcsCommandBuffer.h
+//
+//  Records structural changes to the ECS (create/destroy entity, add/remove
+//  component) so they can be applied later, at a sync point where no system is
+//  iterating component arrays. Adding or removing components moves other
+//  components in their arrays, so doing it in the middle of a loop invalidates
+//  the references and indices the loop holds.
+//
+//  Each thread records into its own buffer (ECS.getCommandBuffer(thread_index)),
+//  and ECS.playbackCommands() applies the buffers in thread index order, and the
+//  commands of each buffer in the order they were recorded.
+//  Usage:
+//      EcsCommandBuffer& cmd = ECS.getCommandBuffer(0);
+//      int bullet = cmd.createEntity("bullet");   //deferred id, only valid in cmd
+//      cmd.addComponent<Mesh>(bullet, bullet_mesh);
+//      cmd.addComponent<Transform>(bullet, spawn_transform); //replaces its Transform
+//      cmd.destroyEntity(ECS.getHandle(target));
+//
+#pragma once
+#include "Components.h"
+#include <vector>
+#include <string>
+#include <functional>
+
+class EcsCommandBuffer {
+public:
+    enum CommandType {
+        CommandCreateEntity,
+        CommandDestroyEntity,
+        CommandAddComponent,
+        CommandRemoveComponent
+    };
+
+    //entity is either an existing entity id (>= 0) or a deferred id (< 0)
+    //returned by createEntity of this buffer
+    struct Command {
+        CommandType type;
+        int entity = -1;
+        EntityHandle handle;
+        int component_type = -1;
+        std::string name;
+        std::function<void(void*)> init; //copies recorded value into new component
+    };
+
+    //records creation of entity (with Transform, as ECS.createEntity)
+    //returns a deferred id which can be passed to further commands of this buffer
+    int createEntity(const std::string& name) {
+        Command cmd;
+        cmd.type = CommandCreateEntity;
+        cmd.entity = -(++num_created_);
+        cmd.name = name;
+        commands_.push_back(std::move(cmd));
+        return -num_created_;
+    }
+
+    //records destruction of entity. Using a handle means the command is
+    //skipped if the entity has already been destroyed and its slot reused
+    void destroyEntity(EntityHandle handle) {
+        if (handle.isNull()) return;
+        Command cmd;
+        cmd.type = CommandDestroyEntity;
+        cmd.handle = handle;
+        commands_.push_back(std::move(cmd));
+    }
+    //records destruction of entity created earlier in this buffer
+    void destroyEntity(int deferred_entity) {
+        Command cmd;
+        cmd.type = CommandDestroyEntity;
+        cmd.entity = deferred_entity;
+        commands_.push_back(std::move(cmd));
+    }
+
+    //records adding a default constructed component of type T
+    template<typename T>
+    void addComponent(int entity) {
+        Command cmd;
+        cmd.type = CommandAddComponent;
+        cmd.entity = entity;
+        cmd.component_type = componentIndex<T>();
+        commands_.push_back(std::move(cmd));
+    }
+
+    //records adding a component of type T, initialised with a copy of value.
+    //If the entity already has one (like the Transform of every entity), its
+    //value is replaced. owner, and the hierarchy links of a Transform, are set
+    //by the ECS; those of value are ignored
+    template<typename T>
+    void addComponent(int entity, const T& value) {
+        addComponent<T>(entity);
+        commands_.back().init = [value](void* comp) { *static_cast<T*>(comp) = value; };
+    }
+
+    //records removal of component of type T
+    template<typename T>
+    void removeComponent(int entity) {
+        Command cmd;
+        cmd.type = CommandRemoveComponent;
+        cmd.entity = entity;
+        cmd.component_type = componentIndex<T>();
+        commands_.push_back(std::move(cmd));
+    }
+
+    const std::vector<Command>& getCommands() const { return commands_; }
+    int getNumCreated() const { return num_created_; }
+    bool empty() const { return commands_.empty(); }
+
+    void clear() {
+        commands_.clear();
+        num_created_ = 0;
+    }
+
+private:
+    std::vector<Command> commands_;
+    int num_created_ = 0;
+};
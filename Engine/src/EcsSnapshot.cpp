@@ -0,0 +1,148 @@
+//
+//  EcsSnapshot.cpp
+//
+
+#include "EcsSnapshot.h"
+#include <algorithm>
+
+/**** DELTA ****/
+
+//delta layout: [varint size of current] then repeated
+//[varint zero run][varint literal count][literal bytes] of current XOR previous
+
+static void writeVarint_(std::vector<uint8_t>& out, size_t value) {
+    while (value >= 0x80) {
+        out.push_back((uint8_t)(value | 0x80));
+        value >>= 7;
+    }
+    out.push_back((uint8_t)value);
+}
+
+static size_t readVarint_(const std::vector<uint8_t>& in, size_t& pos) {
+    size_t value = 0;
+    int shift = 0;
+    while (pos < in.size()) {
+        uint8_t byte = in[pos++];
+        value |= (size_t)(byte & 0x7f) << shift;
+        if (!(byte & 0x80)) break;
+        shift += 7;
+    }
+    return value;
+}
+
+std::vector<uint8_t> SnapshotDelta::encode(const std::vector<uint8_t>& previous, const std::vector<uint8_t>& current) {
+    std::vector<uint8_t> out;
+    writeVarint_(out, current.size());
+
+    auto xorAt = [&](size_t i) -> uint8_t {
+        return current[i] ^ (i < previous.size() ? previous[i] : 0);
+    };
+
+    size_t i = 0;
+    while (i < current.size()) {
+        size_t zeros = 0;
+        while (i < current.size() && xorAt(i) == 0) { zeros++; i++; }
+        //literals end at the next run of zeros worth a new block (more than 2 bytes)
+        size_t start = i;
+        while (i < current.size()) {
+            if (xorAt(i) == 0) {
+                size_t run = 0;
+                while (i + run < current.size() && run < 3 && xorAt(i + run) == 0) run++;
+                if (run == 3 || i + run == current.size()) break;
+                i += run;
+            }
+            else i++;
+        }
+        writeVarint_(out, zeros);
+        writeVarint_(out, i - start);
+        for (size_t j = start; j < i; j++) out.push_back(xorAt(j));
+    }
+    return out;
+}
+
+std::vector<uint8_t> SnapshotDelta::decode(const std::vector<uint8_t>& previous, const std::vector<uint8_t>& delta) {
+    size_t pos = 0;
+    std::vector<uint8_t> current(readVarint_(delta, pos));
+    const size_t common = std::min(previous.size(), current.size());
+    std::copy(previous.begin(), previous.begin() + common, current.begin());
+
+    size_t i = 0;
+    while (pos < delta.size() && i < current.size()) {
+        i += readVarint_(delta, pos);
+        size_t literals = readVarint_(delta, pos);
+        for (size_t j = 0; j < literals && i < current.size(); j++)
+            current[i++] ^= delta[pos++];
+    }
+    return current;
+}
+
+/**** RING ****/
+
+SnapshotRing::SnapshotRing(size_t capacity, int keyframe_interval) :
+    capacity_(std::max(capacity, (size_t)1)),
+    keyframe_interval_(std::max(keyframe_interval, 1)) {
+}
+
+void SnapshotRing::push(const EcsSnapshot& snapshot) {
+    Entry entry;
+    entry.keyframe = entries_.empty() || since_keyframe_ >= keyframe_interval_;
+    entry.bytes = entry.keyframe ? snapshot.data : SnapshotDelta::encode(newest_data_, snapshot.data);
+    entry.arrays = snapshot.arrays;
+    entry.type_versions = snapshot.type_versions;
+    since_keyframe_ = entry.keyframe ? 1 : since_keyframe_ + 1;
+    newest_data_ = snapshot.data;
+    entries_.push_back(std::move(entry));
+
+    if (entries_.size() > capacity_) {
+        //the second oldest becomes the base of the ring, so store it whole
+        if (!entries_[1].keyframe) {
+            entries_[1].bytes = decodeEntry_(1);
+            entries_[1].keyframe = true;
+        }
+        entries_.pop_front();
+    }
+}
+
+std::vector<uint8_t> SnapshotRing::decodeEntry_(size_t index) const {
+    size_t key = index;
+    while (!entries_[key].keyframe) key--;
+    std::vector<uint8_t> data = entries_[key].bytes;
+    for (size_t i = key + 1; i <= index; i++)
+        data = SnapshotDelta::decode(data, entries_[i].bytes);
+    return data;
+}
+
+EcsSnapshot SnapshotRing::get(size_t age) const {
+    EcsSnapshot snapshot;
+    if (age >= entries_.size()) return snapshot;
+    const size_t index = entries_.size() - 1 - age;
+    snapshot.data = age == 0 ? newest_data_ : decodeEntry_(index);
+    snapshot.arrays = entries_[index].arrays;
+    snapshot.type_versions = entries_[index].type_versions;
+    return snapshot;
+}
+
+void SnapshotRing::discardNewest(size_t count) {
+    count = std::min(count, entries_.size());
+    if (!count) return;
+    entries_.erase(entries_.end() - count, entries_.end());
+    newest_data_ = entries_.empty() ? std::vector<uint8_t>() : decodeEntry_(entries_.size() - 1);
+    //count pushes since the newest keyframe again
+    since_keyframe_ = 0;
+    for (size_t i = entries_.size(); i > 0; i--) {
+        since_keyframe_++;
+        if (entries_[i - 1].keyframe) break;
+    }
+}
+
+void SnapshotRing::clear() {
+    entries_.clear();
+    newest_data_.clear();
+    since_keyframe_ = 0;
+}
+
+size_t SnapshotRing::memoryUsage() const {
+    size_t bytes = newest_data_.capacity();
+    for (auto& entry : entries_) bytes += entry.bytes.capacity();
+    return bytes;
+}
@@ -0,0 +1,135 @@
+//
+//  EcsSnapshot.h
+//
+//  In-memory copies of the whole ECS state, for quicksave and rewind.
+//  ECS.snapshot() writes entities and every trivially copyable component array
+//  (Transform, Mesh, Camera, Light, Collider) into one binary blob with memcpy.
+//  Arrays which can't be copied as bytes (they hold strings, vectors or
+//  std::function) are copied by value, and shared between consecutive snapshots
+//  as long as their type has not changed. ECS.restore() loads a snapshot back.
+//
+//  SnapshotRing keeps the last N snapshots for rewinding. Every few snapshots is
+//  stored whole (keyframe), the rest as deltas: XOR against the previous blob,
+//  which is mostly zeros when little has moved, then run length encoded.
+//
+//  Snapshots store interned string ids, so they are only valid in the process
+//  which created them.
+//
+#pragma once
+#include "Components.h"
+#include <vector>
+#include <deque>
+#include <array>
+#include <memory>
+#include <cstdint>
+#include <cstring>
+#include <type_traits>
+
+//copy of a non trivially copyable component array
+struct SnapshotArrayBase {
+    virtual ~SnapshotArrayBase() {}
+};
+template<typename T>
+struct SnapshotArray : public SnapshotArrayBase {
+    std::vector<T> components;
+};
+
+struct EcsSnapshot {
+    //entities, free list and trivially copyable component arrays
+    std::vector<uint8_t> data;
+    //copies of the other component arrays, by component index (null for trivial types)
+    std::array<std::shared_ptr<const SnapshotArrayBase>, NUM_TYPE_COMPONENTS> arrays;
+    //type versions when the snapshot was taken, to decide what can be shared
+    std::array<uint32_t, NUM_TYPE_COMPONENTS> type_versions = {};
+
+    bool empty() const { return data.empty(); }
+};
+
+//appends plain values and arrays of plain values to a byte buffer
+struct SnapshotWriter {
+    std::vector<uint8_t>& data;
+
+    SnapshotWriter(std::vector<uint8_t>& a_data) : data(a_data) {}
+
+    void writeBytes(const void* bytes, size_t size) {
+        const size_t offset = data.size();
+        data.resize(offset + size);
+        if (size) memcpy(&data[offset], bytes, size);
+    }
+    template<typename T>
+    void write(const T& value) {
+        static_assert(std::is_trivially_copyable<T>::value, "snapshot values must be trivially copyable");
+        writeBytes(&value, sizeof(T));
+    }
+    template<typename T>
+    void writeArray(const std::vector<T>& values) {
+        static_assert(std::is_trivially_copyable<T>::value, "snapshot arrays must be trivially copyable");
+        write((uint32_t)values.size());
+        writeBytes(values.data(), values.size() * sizeof(T));
+    }
+};
+
+//reads back what SnapshotWriter wrote, in the same order
+struct SnapshotReader {
+    const std::vector<uint8_t>& data;
+    size_t offset = 0;
+
+    SnapshotReader(const std::vector<uint8_t>& a_data) : data(a_data) {}
+
+    void readBytes(void* bytes, size_t size) {
+        if (size) memcpy(bytes, &data[offset], size);
+        offset += size;
+    }
+    template<typename T>
+    void read(T& value) { readBytes(&value, sizeof(T)); }
+    template<typename T>
+    void readArray(std::vector<T>& values) {
+        uint32_t size = 0;
+        read(size);
+        values.resize(size);
+        readBytes(values.data(), size * sizeof(T));
+    }
+};
+
+//XOR + run length delta between two blobs
+namespace SnapshotDelta {
+    //encodes current relative to previous (the shorter is treated as zero padded)
+    std::vector<uint8_t> encode(const std::vector<uint8_t>& previous, const std::vector<uint8_t>& current);
+    //rebuilds current from previous and the output of encode
+    std::vector<uint8_t> decode(const std::vector<uint8_t>& previous, const std::vector<uint8_t>& delta);
+}
+
+//ring buffer of the most recent snapshots, delta compressed
+class SnapshotRing {
+public:
+    //capacity: number of snapshots kept (e.g. 5 seconds at 60 fps = 300)
+    //keyframe_interval: a whole snapshot is stored every keyframe_interval pushes
+    SnapshotRing(size_t capacity = 300, int keyframe_interval = 30);
+
+    //adds snapshot as newest, dropping the oldest if full
+    void push(const EcsSnapshot& snapshot);
+    //snapshot pushed 'age' pushes ago (0 is newest)
+    EcsSnapshot get(size_t age) const;
+    //drops the 'count' newest snapshots, e.g. after restoring an older one
+    void discardNewest(size_t count);
+    void clear();
+
+    size_t size() const { return entries_.size(); }
+    //bytes used by stored blobs (not counting shared non trivial arrays)
+    size_t memoryUsage() const;
+
+private:
+    struct Entry {
+        bool keyframe;
+        std::vector<uint8_t> bytes; //whole blob if keyframe, delta to previous entry otherwise
+        std::array<std::shared_ptr<const SnapshotArrayBase>, NUM_TYPE_COMPONENTS> arrays;
+        std::array<uint32_t, NUM_TYPE_COMPONENTS> type_versions;
+    };
+    std::deque<Entry> entries_;
+    std::vector<uint8_t> newest_data_; //decoded blob of newest entry, base for next delta
+    size_t capacity_;
+    int keyframe_interval_;
+    int since_keyframe_ = 0;
+
+    std::vector<uint8_t> decodeEntry_(size_t index) const;
+};
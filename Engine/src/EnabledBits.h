@@ -0,0 +1,111 @@
+//
+//  EnabledBits.h
+//
+//  Growable bitset with one bit per component (or view match), set while the
+//  owning entity is active. forEach only visits set bits: it reads 64 bits at a
+//  time, skips words which are all zero and jumps between set bits with a count
+//  of trailing zeros, so a large pool of inactive components costs one load per
+//  64 of them
+//
+#pragma once
+#include <vector>
+#include <cstdint>
+#include <cstddef>
+#if defined(_MSC_VER)
+#include <intrin.h>
+#endif
+
+//index of lowest set bit of x. x must not be 0
+inline int countTrailingZeros64(uint64_t x) {
+#if defined(_MSC_VER) && defined(_WIN64)
+    unsigned long index;
+    _BitScanForward64(&index, x);
+    return (int)index;
+#elif defined(_MSC_VER)
+    unsigned long index;
+    if (_BitScanForward(&index, (unsigned long)x)) return (int)index;
+    _BitScanForward(&index, (unsigned long)(x >> 32));
+    return (int)index + 32;
+#else
+    return __builtin_ctzll(x);
+#endif
+}
+
+class EnabledBits {
+public:
+    size_t size() const { return size_; }
+
+    bool test(size_t i) const { return (words_[i >> 6] >> (i & 63)) & 1; }
+
+    void set(size_t i, bool value) {
+        const uint64_t bit = (uint64_t)1 << (i & 63);
+        if (value) words_[i >> 6] |= bit;
+        else words_[i >> 6] &= ~bit;
+    }
+
+    void pushBack(bool value) {
+        if ((size_ & 63) == 0) words_.push_back(0);
+        set(size_++, value);
+    }
+
+    void popBack() {
+        set(--size_, false);
+        if ((size_ & 63) == 0) words_.pop_back();
+    }
+
+    //moves last bit into i and shrinks by one, to mirror swap-and-pop removal
+    void removeSwap(size_t i) {
+        set(i, test(size_ - 1));
+        popBack();
+    }
+
+    void clear() {
+        words_.clear();
+        size_ = 0;
+    }
+
+    void reserve(size_t n) { words_.reserve((n + 63) >> 6); }
+
+    //index of first set bit at or after i, or size() if there is none
+    size_t findNext(size_t i) const {
+        if (i >= size_) return size_;
+        size_t w = i >> 6;
+        uint64_t bits = words_[w] & (~(uint64_t)0 << (i & 63));
+        while (!bits) {
+            if (++w == words_.size()) return size_;
+            bits = words_[w];
+        }
+        return (w << 6) + countTrailingZeros64(bits);
+    }
+
+    //calls fn(i) for each set bit, in increasing order
+    template<typename F>
+    void forEach(F fn) const {
+        for (size_t w = 0; w < words_.size(); w++) {
+            uint64_t bits = words_[w];
+            while (bits) {
+                fn((w << 6) + countTrailingZeros64(bits));
+                bits &= bits - 1;
+            }
+        }
+    }
+
+    //calls fn(i) for each set bit in [begin, end), in increasing order
+    template<typename F>
+    void forEachInRange(size_t begin, size_t end, F fn) const {
+        end = end < size_ ? end : size_;
+        for (size_t w = begin >> 6; (w << 6) < end; w++) {
+            uint64_t bits = words_[w];
+            if ((w << 6) < begin) bits &= ~0ull << (begin & 63);
+            if (((w + 1) << 6) > end) bits &= ~(~0ull << (end & 63));
+            while (bits) {
+                fn((w << 6) + countTrailingZeros64(bits));
+                bits &= bits - 1;
+            }
+        }
+    }
+
+private:
+    std::vector<uint64_t> words_;
+    size_t size_ = 0;
+};
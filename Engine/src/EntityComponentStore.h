@@ -1,8 +1,21 @@
 #pragma once
 #include "Components.h"
+#include "ComponentView.h"
+#include "EcsCommandBuffer.h"
+#include "Prefab.h"
+#include "EcsSnapshot.h"
 #include <vector>
 #include <unordered_map>
 #include <map>
+#include <utility>
+#include <memory>
+#include <typeindex>
+#include <algorithm>
+#include <deque>
+#include <mutex>
+#include <array>
+#include <cstdint>
+#include <cfloat>
 
 using namespace std;
 
@@ -18,19 +31,127 @@ struct EntityComponentStore {
     ComponentArrays components; // defined at bottom of Components.h
     
     //create Entity and add transform component by default
+    //slots of destroyed entities are recycled before the array grows
     //return array id of new entity
     int createEntity(string name) {
-        entities.emplace_back(name);
-        createComponentForEntity<Transform>((int)entities.size() - 1);
-        return (int)entities.size() - 1;
+        int entity_id;
+        if (!free_entities_.empty()) {
+            entity_id = free_entities_.back();
+            free_entities_.pop_back();
+            Entity& recycled = entities[entity_id];
+            recycled.name = StringID(name);
+            recycled.active = true;
+            recycled.alive = true;
+        }
+        else {
+            entities.emplace_back(name);
+            entity_id = (int)entities.size() - 1;
+        }
+        //index by name. If name is already taken, first entity keeps it
+        indexName_(entity_id);
+        createComponentForEntity<Transform>(entity_id);
+        return entity_id;
     }
 
-	//returns id of entity
+	//returns id of entity, or -1 if no entity has that name
+	int getEntity(StringID name) {
+		auto it = name_index_.find(name.id);
+		return it != name_index_.end() ? it->second.first : -1;
+	}
+
+	//returns id of entity. Name is looked up without adding it to string table
 	int getEntity(string name) {
-		for (size_t i = 0; i < entities.size(); i++)
-			if (entities[i].name == name) return (int)i;
-		return -1;
+		const uint32_t name_id = StringTable::find(name);
+		if (name_id == StringTable::EMPTY_ID) return -1;
+		auto it = name_index_.find(name_id);
+		return it != name_index_.end() ? it->second.first : -1;
 	}
+
+    //returns generational handle for entity at id in array
+    EntityHandle getHandle(int entity_id) {
+        return EntityHandle(entity_id, entities[entity_id].generation);
+    }
+
+    //true if handle refers to an entity which has not been destroyed since
+    //the handle was created
+    bool isAlive(EntityHandle handle) {
+        if (handle.isNull()) return false;
+        const int entity_id = handle.index();
+        if (entity_id >= (int)entities.size()) return false;
+        const Entity& ent = entities[entity_id];
+        return ent.alive && (ent.generation & EntityHandle::GENERATION_MASK) == handle.generation();
+    }
+
+    //returns array id of entity from handle, or -1 if handle is stale
+    int getEntity(EntityHandle handle) {
+        return isAlive(handle) ? handle.index() : -1;
+    }
+
+    //destroys entity and all its components. The slot is put on the free list
+    //and its generation incremented so existing handles become stale
+    void destroyEntity(int entity_id) {
+        Entity& ent = entities[entity_id];
+        if (!ent.alive) return;
+        removeAllComponents_(entity_id, std::make_index_sequence<NUM_TYPE_COMPONENTS>());
+        unindexName_(entity_id);
+        ent.name = StringID();
+        ent.active = false;
+        ent.alive = false;
+        ent.generation++;
+        free_entities_.push_back(entity_id);
+    }
+
+    //destroys entity only if handle is still valid
+    void destroyEntity(EntityHandle handle) {
+        if (isAlive(handle)) destroyEntity(handle.index());
+    }
+
+    //activates or deactivates entity. Inactive entities keep their components,
+    //but each() of views and eachEnabled() skip them, so systems ignore them.
+    //Components of the entity are marked as changed so cached data is refreshed
+    void setActive(int entity_id, bool active) {
+        Entity& ent = entities[entity_id];
+        if (!ent.alive || ent.active == active) return;
+        ent.active = active;
+        setEnabled_(entity_id, active, std::make_index_sequence<NUM_TYPE_COMPONENTS>());
+        activation_version_++;
+    }
+
+    bool isActive(int entity_id) { return entities[entity_id].active; }
+
+    //true if owner of component at index in array of type T is active
+    template<typename T>
+    bool isEnabled(int comp_index) { return enabled_<T>().test(comp_index); }
+
+    //calls fn(comp_index) for each component of type T whose owner is active,
+    //skipping 64 inactive components at a time
+    template<typename T, typename F>
+    void eachEnabledIndex(F fn) { enabled_<T>().forEach(fn); }
+
+    //calls fn(T&) for each component of type T whose owner is active
+    template<typename T, typename F>
+    void eachEnabled(F fn) {
+        vector<T>& the_vec = get<vector<T>>(components);
+        enabled_<T>().forEach([&](size_t i) { fn(the_vec[i]); });
+    }
+
+    //eachEnabled split into chunks of about grain components, run as jobs.
+    //Chunks start on cache lines, so fn may write its component (and only
+    //that) without threads sharing lines. Serial without a job system
+    template<typename T, typename F>
+    void parallelEach(F fn, size_t grain = 1024) {
+        vector<T>& the_vec = get<vector<T>>(components);
+        const EnabledBits& enabled = enabled_<T>();
+        auto chunk = [&](size_t begin, size_t end) {
+            enabled.forEachInRange(begin, end, [&](size_t i) { fn(the_vec[i]); });
+        };
+        if (jobs_) jobs_->parallelForArray(the_vec.data(), sizeof(T), the_vec.size(), grain, chunk);
+        else chunk(0, the_vec.size());
+    }
+
+    //job system for parallelEach and the parallel loops of views
+    void setJobSystem(JobSystem* jobs) { jobs_ = jobs; }
+    JobSystem* getJobSystem() const { return jobs_; }
     
     //creates a new component with no entity parent
     template<typename T>
@@ -49,21 +170,47 @@ struct EntityComponentStore {
         // get reference to vector
         vector<T>& the_vec = get<vector<T>>(components);
         // add a new object at back of vector
+        ComponentTypes::Policy<T>::reserve(the_vec);
         the_vec.emplace_back();
         
-        //get index type of ComponentType
-        const int type_index = type2int<T>::result;
-        
-        //set index of entity component array to index of newly added component
-        entities[entity_id].components[type_index] = (int)the_vec.size() - 1;
-        
-        //set owner of component to entity
-        Component& new_comp = the_vec.back();
-        new_comp.owner = entity_id;
+        //link it to entity
+        registerComponent_<T>(entity_id);
+        onComponentCreated_(the_vec.back());
+
+        structureChanged();
         
         return the_vec.back(); // return pointer to new component
     }
     
+    //removes component of type T from entity in O(1): the last component in the
+    //array is moved into the hole left by the removed one, and the entity which
+    //owns the moved component is updated to point at its new index
+    template<typename T>
+    void removeComponentFromEntity(int entity_id) {
+        const int comp_index = indexMap_<T>().get(entity_id);
+        if (comp_index == -1) return;
+
+        vector<T>& the_vec = get<vector<T>>(components);
+        vector<uint32_t>& versions = versions_<T>();
+        const int last_index = (int)the_vec.size() - 1;
+
+        onComponentRemoved_(the_vec[comp_index], comp_index);
+        if (comp_index != last_index) {
+            the_vec[comp_index] = std::move(the_vec[last_index]);
+            versions[comp_index] = versions[last_index];
+            indexMap_<T>().set(the_vec[comp_index].owner, comp_index);
+            onComponentMoved_(the_vec[comp_index], last_index, comp_index);
+        }
+        the_vec.pop_back();
+        versions.pop_back();
+        enabled_<T>().removeSwap(comp_index);
+        indexMap_<T>().set(entity_id, -1);
+        entities[entity_id].signature.reset(componentIndex<T>());
+        type_versions_[componentIndex<T>()] = change_tick_;
+
+        structureChanged();
+    }
+
     //return reference to component at id in array
     template<typename T>
     T& getComponentInArray(int an_id) {
@@ -73,10 +220,8 @@ struct EntityComponentStore {
     //return reference to component stored in entity
     template<typename T>
     T& getComponentFromEntity(int entity_id) {
-        //get index for type
-        const int type_index = type2int<T>::result;
         //get index for component
-        const int comp_index = entities[entity_id].components[type_index];
+        const int comp_index = indexMap_<T>().get(entity_id);
         //return component from vector in tuple
         return get<vector<T>>(components)[comp_index];
     }
@@ -84,24 +229,355 @@ struct EntityComponentStore {
 	//return reference to component stored in entity, accessed by name
 	template<typename T>
 	T& getComponentFromEntity(std::string entity_name) {
-		//get entity id
-		const int entity_id = getEntity(entity_name);
-		//get index for type
-		const int type_index = type2int<T>::result;
-		//get index for component
-		const int comp_index = entities[entity_id].components[type_index];
-		//return component from vector in tuple
-		return get<vector<T>>(components)[comp_index];
+		return getComponentFromEntity<T>(getEntity(entity_name));
 	}
+
+	//return reference to component stored in entity, accessed by interned name
+	template<typename T>
+	T& getComponentFromEntity(StringID entity_name) {
+		return getComponentFromEntity<T>(getEntity(entity_name));
+	}
+
+    //as getComponentInArray/getComponentFromEntity, but mark the component as
+    //changed. Use these to write components other systems track changes of
+    template<typename T>
+    T& getComponentInArrayForWrite(int an_id) {
+        markChanged<T>(an_id);
+        return get<vector<T>>(components)[an_id];
+    }
+    template<typename T>
+    T& getComponentFromEntityForWrite(int entity_id) {
+        return getComponentInArrayForWrite<T>(indexMap_<T>().get(entity_id));
+    }
+    template<typename T>
+    T& getComponentFromEntityForWrite(StringID entity_name) {
+        return getComponentFromEntityForWrite<T>(getEntity(entity_name));
+    }
     
     //return id of component in relevant array
     template<typename T>
     int getComponentID(int entity_id) {
-        //get identifier of type
-        const int type_index = type2int<T>::result;
         //return id of this component type for this
-        return entities[entity_id].components[type_index];
+        return indexMap_<T>().get(entity_id);
+    }
+
+    //true if entity has a component of every type in Ts
+    template<typename... Ts>
+    bool hasComponents(int entity_id) {
+        const ComponentSignature mask = ComponentTypes::signatureOf<Ts...>();
+        return (entities[entity_id].signature & mask) == mask;
+    }
+
+    //sorts the array of component type T, keeping entity -> component links valid
+    //indices stored in other components (e.g. Transform::parent) are NOT updated
+    //sort is stable, so it keeps the order of a previous defragment() within equal keys
+    template<typename T, typename Compare>
+    void sortComponents(Compare compare) {
+        vector<T>& the_vec = get<vector<T>>(components);
+        std::stable_sort(the_vec.begin(), the_vec.end(), compare);
+        for (size_t i = 0; i < the_vec.size(); i++) {
+            indexMap_<T>().set(the_vec[i].owner, (int)i);
+            markChanged<T>((int)i);
+        }
+        rebuildEnabled_<T>();
+        structureChanged();
     }
+
+    /**** PREFABS ****/
+
+    //spawns count copies of prefab, the root of copy i placed at root_transforms[i]
+    //(or at the root node's local matrix if root_transforms is null).
+    //Every array is grown once up front, and new entities are appended (free slots
+    //are not reused) so the entities of each copy are contiguous, in node order.
+    //returns entity id of the root of each copy
+    vector<int> instantiate(const Prefab& prefab, int count, const lm::mat4* root_transforms = nullptr) {
+        vector<int> roots;
+        const int num_nodes = (int)prefab.nodes.size();
+        if (count <= 0 || num_nodes == 0) return roots;
+        roots.reserve(count);
+
+        const int first_entity = (int)entities.size();
+        entities.resize(first_entity + count * num_nodes);
+        reservePrefab_(prefab, count, std::make_index_sequence<NUM_TYPE_COMPONENTS>());
+
+        vector<Transform>& transforms = get<vector<Transform>>(components);
+        for (int i = 0; i < count; i++) {
+            const int first_node_entity = first_entity + i * num_nodes;
+            //every node has a transform, added in node order
+            const int first_transform = (int)transforms.size();
+            for (int n = 0; n < num_nodes; n++) {
+                const Prefab::Node& node = prefab.nodes[n];
+                const int entity_id = first_node_entity + n;
+                entities[entity_id].name = node.name;
+                indexName_(entity_id);
+
+                Transform& transform = appendComponent_(entity_id, Transform());
+                if (node.parent == -1) {
+                    transform.set(root_transforms ? root_transforms[i] * node.local : node.local);
+                }
+                else {
+                    transform.set(node.local);
+                    linkChild_(first_transform + node.parent, (int)transforms.size() - 1);
+                }
+                instantiateComponents_(entity_id, node, std::make_index_sequence<NUM_TYPE_COMPONENTS>());
+            }
+            roots.push_back(first_node_entity);
+        }
+        structureChanged();
+        return roots;
+    }
+
+    //copies entity, and all entities below it in the transform hierarchy, into
+    //a prefab. The root node gets an identity local matrix
+    Prefab createPrefab(int entity_id) {
+        Prefab prefab;
+        vector<Transform>& transforms = get<vector<Transform>>(components);
+        vector<int> node_entities(1, entity_id);
+        prefab.addNode(entities[entity_id].name.str());
+        copyToPrefab_(prefab.nodes[0], entity_id, std::make_index_sequence<NUM_TYPE_COMPONENTS>());
+
+        //breadth first, so parents are always added before their children
+        for (size_t n = 0; n < node_entities.size(); n++) {
+            const int parent_transform = getComponentID<Transform>(node_entities[n]);
+            for (int t = transforms[parent_transform].first_child; t != -1; t = transforms[t].next_sibling) {
+                const int child = transforms[t].owner;
+                const int node = prefab.addNode(entities[child].name.str(), (int)n, transforms[t].matrix());
+                copyToPrefab_(prefab.nodes[node], child, std::make_index_sequence<NUM_TYPE_COMPONENTS>());
+                node_entities.push_back(child);
+            }
+        }
+        return prefab;
+    }
+
+    /**** HIERARCHY ****/
+
+    //transforms form a tree through Transform::parent, first_child and
+    //next_sibling (children are listed newest first), so hierarchy operations
+    //cost O(subtree) instead of a search of every transform. The transform array
+    //is kept in depth order: parents are stored before their children, so one
+    //pass over the array can resolve all world matrices. Operations which break
+    //the order (reparenting under a transform stored later, removals) only flag
+    //it, and sortHierarchy restores it at the next sync point
+
+    //makes parent_entity the parent of entity, or a root if parent_entity is -1.
+    //If keep_world is true, the local matrix is changed so the entity doesn't move.
+    //returns false if parent_entity is the entity itself or one of its descendants
+    bool setParent(int entity_id, int parent_entity, bool keep_world = false) {
+        vector<Transform>& transforms = get<vector<Transform>>(components);
+        const int child = getComponentID<Transform>(entity_id);
+        const int parent = parent_entity == -1 ? -1 : getComponentID<Transform>(parent_entity);
+        if (child == -1 || (parent_entity != -1 && parent == -1)) return false;
+        for (int t = parent; t != -1; t = transforms[t].parent)
+            if (t == child) return false;
+        Transform& transform = transforms[child];
+        if (transform.parent == parent) return true;
+
+        if (keep_world) {
+            lm::mat4 local = transform.getGlobalMatrix(transforms);
+            if (parent != -1) {
+                lm::mat4 parent_inverse = transforms[parent].getGlobalMatrix(transforms);
+                parent_inverse.inverseAffine();
+                local = parent_inverse * local;
+            }
+            transform.set(local);
+        }
+        unlinkChild_(child);
+        linkChild_(parent, child);
+        if (parent > child) hierarchy_unsorted_ = true;
+        markChanged<Transform>(child);
+        structureChanged();
+        return true;
+    }
+
+    //returns id of parent entity, or -1 if entity is a root
+    int getParent(int entity_id) {
+        const int t = getComponentID<Transform>(entity_id);
+        if (t == -1) return -1;
+        const int parent = get<vector<Transform>>(components)[t].parent;
+        return parent == -1 ? -1 : ownerOf_<Transform>(parent);
+    }
+
+    //calls fn(child entity id) for each direct child of entity.
+    //fn must not change the hierarchy
+    template<typename F>
+    void eachChild(int entity_id, F fn) {
+        vector<Transform>& transforms = get<vector<Transform>>(components);
+        const int t = getComponentID<Transform>(entity_id);
+        if (t == -1) return;
+        for (int c = transforms[t].first_child; c != -1; c = transforms[c].next_sibling)
+            fn(transforms[c].owner);
+    }
+
+    //calls fn(Transform&) for transform of entity and every transform below it,
+    //depth first, parents before children. fn must not change the hierarchy
+    template<typename F>
+    void eachInSubtree(int entity_id, F fn) {
+        const int root = getComponentID<Transform>(entity_id);
+        vector<Transform>& transforms = get<vector<Transform>>(components);
+        for (int t = root; t != -1; t = nextInSubtree_(root, t))
+            fn(transforms[t]);
+    }
+
+    //destroys entity and every entity below it in the hierarchy
+    void destroyHierarchy(int entity_id) {
+        vector<int> subtree;
+        eachInSubtree(entity_id, [&](Transform& t) { subtree.push_back(t.owner); });
+        if (subtree.empty()) subtree.push_back(entity_id);
+        //children before parents, so no transform has to be orphaned on the way
+        for (auto it = subtree.rbegin(); it != subtree.rend(); ++it)
+            destroyEntity(*it);
+    }
+
+    //false if an operation left a child stored before its parent
+    bool isHierarchySorted() const { return !hierarchy_unsorted_; }
+
+    //restores depth order of the transform array, if it was broken. The sort is
+    //stable, so transforms at the same depth keep their (e.g. spatial) order.
+    //Like defragment, transform indices held outside the ECS become invalid,
+    //so only call at a sync point
+    void sortHierarchy() {
+        if (!hierarchy_unsorted_) return;
+        vector<Transform>& transforms = get<vector<Transform>>(components);
+        //depth of each transform, breadth first from the roots
+        vector<uint64_t> entity_keys(entities.size(), UINT64_MAX);
+        vector<int> depth(transforms.size(), 0);
+        vector<int> queue;
+        queue.reserve(transforms.size());
+        for (size_t i = 0; i < transforms.size(); i++)
+            if (transforms[i].parent == -1) queue.push_back((int)i);
+        for (size_t q = 0; q < queue.size(); q++) {
+            const int t = queue[q];
+            entity_keys[transforms[t].owner] = depth[t];
+            for (int c = transforms[t].first_child; c != -1; c = transforms[c].next_sibling) {
+                depth[c] = depth[t] + 1;
+                queue.push_back(c);
+            }
+        }
+        defragmentArray_<Transform>(entity_keys);
+        hierarchy_unsorted_ = false;
+        structureChanged();
+    }
+
+    /**** DEFRAGMENTATION ****/
+
+    //order used by defragment
+    enum DefragmentKey {
+        DefragmentMorton, //Morton (Z-order) code of world position: entities close in space are close in memory
+        DefragmentDepth //hierarchy depth, then Morton code: parents are stored before their children
+    };
+
+    //reorders every component array by the key of its owner entity, and fixes
+    //entity -> component indices, Transform links and main_camera. The transform
+    //array is then put back in depth order (see sortHierarchy), keeping the key
+    //order within each depth. Component indices held outside the ECS become
+    //invalid, so run it while loading, before systems store any
+    void defragment(DefragmentKey key = DefragmentMorton) {
+        const vector<uint64_t> entity_keys = computeEntityKeys_(key);
+        defragmentArrays_(entity_keys, std::make_index_sequence<NUM_TYPE_COMPONENTS>());
+        sortHierarchy();
+        structureChanged();
+    }
+
+    /**** SNAPSHOTS ****/
+
+    //copies entities and all components into a snapshot (see EcsSnapshot.h).
+    //If previous is given, arrays which are not trivially copyable and have not
+    //changed since previous was taken are shared with it instead of copied
+    EcsSnapshot snapshot(const EcsSnapshot* previous = nullptr) {
+        EcsSnapshot snap;
+        SnapshotWriter writer(snap.data);
+        writer.writeArray(entities);
+        writer.writeArray(free_entities_);
+        writer.write(main_camera);
+        snapshotArrays_(snap, writer, previous, std::make_index_sequence<NUM_TYPE_COMPONENTS>());
+        snap.type_versions = type_versions_;
+        //changes made after the snapshot must get a newer version than it recorded
+        change_tick_++;
+        return snap;
+    }
+
+    //replaces all entities and components with those of snapshot. Index maps
+    //and name index are rebuilt, and every component counts as changed so
+    //systems refresh what they cache. Like defragment, component references and
+    //indices held outside the ECS become invalid, so only call at a sync point
+    void restore(const EcsSnapshot& snap) {
+        if (snap.empty()) return;
+        SnapshotReader reader(snap.data);
+        reader.readArray(entities);
+        reader.readArray(free_entities_);
+        reader.read(main_camera);
+        component_indices_ = ComponentTypes::IndexMaps();
+        restoreArrays_(snap, reader, std::make_index_sequence<NUM_TYPE_COMPONENTS>());
+        markAllChanged_(std::make_index_sequence<NUM_TYPE_COMPONENTS>());
+        rebuildAllEnabled_(std::make_index_sequence<NUM_TYPE_COMPONENTS>());
+        hierarchy_unsorted_ = !hierarchyInOrder_();
+
+        name_index_.clear();
+        name_links_.clear();
+        for (size_t i = 0; i < entities.size(); i++)
+            if (entities[i].alive) indexName_((int)i);
+        structureChanged();
+    }
+
+    /**** WORLDS ****/
+
+    //exchanges all entities and components with other, so a world built by a
+    //loader thread (see LevelLoader.h) can replace the live one between frames.
+    //Command buffers stay with their store and should be empty. Change ticks
+    //continue from the newer of the two, and all components of both count as
+    //changed, so systems refresh everything they cache
+    void swap(EntityComponentStore& other) {
+        entities.swap(other.entities);
+        components.swap(other.components);
+        std::swap(main_camera, other.main_camera);
+        free_entities_.swap(other.free_entities_);
+        view_caches_.swap(other.view_caches_);
+        component_indices_.swap(other.component_indices_);
+        component_versions_.swap(other.component_versions_);
+        enabled_components_.swap(other.enabled_components_);
+        std::swap(hierarchy_unsorted_, other.hierarchy_unsorted_);
+        name_index_.swap(other.name_index_);
+        name_links_.swap(other.name_links_);
+
+        change_tick_ = other.change_tick_ = std::max(change_tick_, other.change_tick_) + 1;
+        markAllChanged_(std::make_index_sequence<NUM_TYPE_COMPONENTS>());
+        other.markAllChanged_(std::make_index_sequence<NUM_TYPE_COMPONENTS>());
+        activation_version_ = other.activation_version_ = std::max(activation_version_, other.activation_version_) + 1;
+        //views swapped with their worlds, but anything else caching by structure must rebuild
+        structure_version_ = other.structure_version_ = std::max(structure_version_, other.structure_version_) + 1;
+    }
+
+    /**** CHANGE TRACKING ****/
+
+    //every component has a version: the change tick when it was created or last
+    //marked as changed. Each type also has a version, updated when any of its
+    //components is created, removed or marked.
+    //To process only what changed, a system keeps the tick from its last run:
+    //    uint32_t now = ECS.takeChangeTick();
+    //    ECS.view<Light, Transform>().changedSince(last_tick_).each(...);
+    //    last_tick_ = now;
+
+    //returns current change tick, and advances it so changes made from now on
+    //are newer than the returned tick
+    uint32_t takeChangeTick() { return change_tick_++; }
+
+    //marks component at index in array of type T as changed
+    template<typename T>
+    void markChanged(int comp_index) {
+        versions_<T>()[comp_index] = change_tick_;
+        type_versions_[componentIndex<T>()] = change_tick_;
+    }
+
+    template<typename T>
+    uint32_t getComponentVersion(int comp_index) { return versions_<T>()[comp_index]; }
+
+    //versions of all components of type T, parallel to their array
+    template<typename T>
+    const vector<uint32_t>& getComponentVersions() { return versions_<T>(); }
+
+    //true if any component of type T was created, removed or marked after tick
+    template<typename T>
+    bool changedSince(uint32_t tick) { return type_versions_[componentIndex<T>()] > tick; }
     
     //returns a const (i.e. non-editable) reference to vector of Type
     //i.e. array will not be editable
@@ -109,7 +585,619 @@ struct EntityComponentStore {
     std::vector<T>& getAllComponents() {
         return get<vector<T>>(components);
     }
+    //returns view of all entities which have every component in Ts
+    //matches are cached and only rebuilt after a structural change, their
+    //enabled bits after an entity is activated or deactivated. Systems running
+    //at the same time (see SystemScheduler) may ask for views concurrently
+    template<typename... Ts>
+    ComponentView<Ts...> view() {
+        lock_guard<mutex> lock(view_caches_mutex_);
+        unique_ptr<ViewCacheBase>& slot = view_caches_[type_index(typeid(ViewCache<Ts...>))];
+        if (!slot) slot.reset(new ViewCache<Ts...>());
+        ViewCache<Ts...>& cache = static_cast<ViewCache<Ts...>&>(*slot);
+        if (!cache.built || cache.version != structure_version_) {
+            rebuildView_(cache);
+            rebuildViewEnabled_(cache);
+        }
+        else if (cache.activation_version != activation_version_)
+            rebuildViewEnabled_(cache);
+        const typename ComponentView<Ts...>::Versions versions = { { &versions_<Ts>()... } };
+        return ComponentView<Ts...>(cache.rows, cache.enabled, versions, jobs_, &get<vector<Ts>>(components)...);
+    }
+
+    //invalidates cached views. Called automatically when components are added
+    //or removed; must be called by anything which reorders a component array
+    void structureChanged() { structure_version_++; }
+
+    //changes whenever components are added, removed or reordered, or an entity
+    //is reparented, so systems can cache data derived from array layout
+    unsigned int getStructureVersion() const { return structure_version_; }
+
+    //returns the command buffer of a thread, creating it on first use.
+    //structural changes made while systems iterate must be recorded here
+    EcsCommandBuffer& getCommandBuffer(int thread_index) {
+        lock_guard<mutex> lock(command_buffers_mutex_);
+        while ((int)command_buffers_.size() <= thread_index)
+            command_buffers_.emplace_back();
+        return command_buffers_[thread_index];
+    }
+
+    //applies all recorded commands, buffer by buffer in thread index order,
+    //then clears the buffers. Only call where no system is iterating
+    void playbackCommands() {
+        vector<int> created;
+        for (auto& buffer : command_buffers_) {
+            if (buffer.empty()) continue;
+            created.assign(buffer.getNumCreated(), -1);
+            for (auto& cmd : buffer.getCommands())
+                playCommand_(cmd, created);
+            buffer.clear();
+        }
+    }
+
     //stores main camera id
     int main_camera = -1;
-    
+
+private:
+    //per-thread command buffers. deque so references stay valid as it grows
+    deque<EcsCommandBuffer> command_buffers_;
+    mutex command_buffers_mutex_;
+
+    //created maps deferred ids of the buffer being played to real entity ids
+    void playCommand_(const EcsCommandBuffer::Command& cmd, vector<int>& created) {
+        if (cmd.type == EcsCommandBuffer::CommandCreateEntity) {
+            created[-cmd.entity - 1] = createEntity(cmd.name);
+            return;
+        }
+        int entity_id = cmd.entity;
+        if (!cmd.handle.isNull()) entity_id = getEntity(cmd.handle);
+        else if (entity_id < 0) entity_id = created[-entity_id - 1];
+        if (entity_id == -1 || !entities[entity_id].alive) return;
+
+        switch (cmd.type) {
+        case EcsCommandBuffer::CommandDestroyEntity:
+            destroyEntity(entity_id);
+            break;
+        case EcsCommandBuffer::CommandAddComponent:
+            playAddComponent_(cmd.component_type, entity_id, cmd.init, std::make_index_sequence<NUM_TYPE_COMPONENTS>());
+            break;
+        case EcsCommandBuffer::CommandRemoveComponent:
+            playRemoveComponent_(cmd.component_type, entity_id, std::make_index_sequence<NUM_TYPE_COMPONENTS>());
+            break;
+        default:
+            break;
+        }
+    }
+
+    //typed add/remove, selected from component_type by the functions below.
+    //Adding a component the entity already has (e.g. the Transform of a
+    //deferred entity) replaces its value
+    template<typename T>
+    void addComponentFromCommand_(int entity_id, const function<void(void*)>& init) {
+        const int existing = getComponentID<T>(entity_id);
+        if (existing != -1 && !init) return;
+        T& comp = existing != -1 ? getComponentInArrayForWrite<T>(existing) : createComponentForEntity<T>(entity_id);
+        if (!init) return;
+        initFromCommand_(comp, init);
+        comp.owner = entity_id;
+    }
+    template<typename T>
+    void initFromCommand_(T& comp, const function<void(void*)>& init) { init(&comp); }
+    //hierarchy links belong to the ECS, not to the recorded value
+    void initFromCommand_(Transform& comp, const function<void(void*)>& init) {
+        const int parent = comp.parent, first_child = comp.first_child, next_sibling = comp.next_sibling;
+        init(&comp);
+        comp.parent = parent;
+        comp.first_child = first_child;
+        comp.next_sibling = next_sibling;
+    }
+    template<typename T>
+    void removeComponentFromCommand_(int entity_id) {
+        removeComponentFromEntity<T>(entity_id);
+    }
+
+    template<size_t... I>
+    void playAddComponent_(int component_type, int entity_id, const function<void(void*)>& init, std::index_sequence<I...>) {
+        typedef void (EntityComponentStore::*AddFunction)(int, const function<void(void*)>&);
+        const AddFunction functions[] = { &EntityComponentStore::addComponentFromCommand_<typename tuple_element<I, ComponentArrays>::type::value_type>... };
+        (this->*functions[component_type])(entity_id, init);
+    }
+    template<size_t... I>
+    void playRemoveComponent_(int component_type, int entity_id, std::index_sequence<I...>) {
+        typedef void (EntityComponentStore::*RemoveFunction)(int);
+        const RemoveFunction functions[] = { &EntityComponentStore::removeComponentFromCommand_<typename tuple_element<I, ComponentArrays>::type::value_type>... };
+        (this->*functions[component_type])(entity_id);
+    }
+
+    //ids of destroyed entities, ready to be recycled by createEntity
+    vector<int> free_entities_;
+
+    //cached view matches, and counter which invalidates them
+    unordered_map<type_index, unique_ptr<ViewCacheBase>> view_caches_;
+    mutex view_caches_mutex_;
+
+    //not swapped with worlds: it belongs to the game, not the world
+    JobSystem* jobs_ = nullptr;
+    unsigned int structure_version_ = 0;
+
+    //owner of component at index in array of type T
+    template<typename T>
+    int ownerOf_(int comp_index) { return get<vector<T>>(components)[comp_index].owner; }
+
+    //entity -> component index map of each type
+    ComponentTypes::IndexMaps component_indices_;
+
+    //change tracking: version of every component, parallel to component
+    //arrays, and version of each type. Tick starts at 1 so all versions are
+    //newer than a tick of 0
+    array<vector<uint32_t>, NUM_TYPE_COMPONENTS> component_versions_;
+    array<uint32_t, NUM_TYPE_COMPONENTS> type_versions_ = {};
+    uint32_t change_tick_ = 1;
+
+    template<typename T>
+    vector<uint32_t>& versions_() { return component_versions_[componentIndex<T>()]; }
+
+    //enabled bit of every component, parallel to component arrays: set while
+    //owner is active. Activation version invalidates enabled bits of cached views
+    array<EnabledBits, NUM_TYPE_COMPONENTS> enabled_components_;
+    unsigned int activation_version_ = 0;
+
+    template<typename T>
+    EnabledBits& enabled_() { return enabled_components_[componentIndex<T>()]; }
+
+    //set when a transform may be stored before its parent (see HIERARCHY)
+    bool hierarchy_unsorted_ = false;
+
+    bool hierarchyInOrder_() {
+        vector<Transform>& transforms = get<vector<Transform>>(components);
+        for (size_t i = 0; i < transforms.size(); i++)
+            if (transforms[i].parent >= (int)i) return false;
+        return true;
+    }
+
+    //adds transform t to the front of parent's child list (nothing if parent is -1)
+    void linkChild_(int parent, int t) {
+        if (parent == -1) return;
+        vector<Transform>& transforms = get<vector<Transform>>(components);
+        transforms[t].parent = parent;
+        transforms[t].next_sibling = transforms[parent].first_child;
+        transforms[parent].first_child = t;
+    }
+
+    //removes transform t from the child list of its parent, making it a root
+    void unlinkChild_(int t) {
+        vector<Transform>& transforms = get<vector<Transform>>(components);
+        Transform& child = transforms[t];
+        if (child.parent == -1) return;
+        int* link = &transforms[child.parent].first_child;
+        while (*link != t) link = &transforms[*link].next_sibling;
+        *link = child.next_sibling;
+        child.parent = -1;
+        child.next_sibling = -1;
+    }
+
+    //next transform after t in a depth first walk of the subtree of root, or -1
+    int nextInSubtree_(int root, int t) {
+        vector<Transform>& transforms = get<vector<Transform>>(components);
+        if (transforms[t].first_child != -1) return transforms[t].first_child;
+        for (; t != root; t = transforms[t].parent)
+            if (transforms[t].next_sibling != -1) return transforms[t].next_sibling;
+        return -1;
+    }
+
+    //links component at back of array T to entity: index map, signature, owner
+    //and change version (a new component counts as changed)
+    template<typename T>
+    T& registerComponent_(int entity_id) {
+        vector<T>& the_vec = get<vector<T>>(components);
+        indexMap_<T>().set(entity_id, (int)the_vec.size() - 1);
+        entities[entity_id].signature.set(componentIndex<T>());
+        the_vec.back().owner = entity_id;
+        versions_<T>().push_back(change_tick_);
+        type_versions_[componentIndex<T>()] = change_tick_;
+        enabled_<T>().pushBack(entities[entity_id].active);
+        return the_vec.back();
+    }
+
+    //appends copy of value to array T, linked to entity (no structureChanged)
+    template<typename T>
+    T& appendComponent_(int entity_id, const T& value) {
+        get<vector<T>>(components).push_back(value);
+        return registerComponent_<T>(entity_id);
+    }
+
+    //grows every array, version array and index map once for count copies of prefab
+    template<size_t... I>
+    void reservePrefab_(const Prefab& prefab, int count, std::index_sequence<I...>) {
+        int expand[] = { 0, (reservePrefabType_<typename tuple_element<I, ComponentTypes::Values>::type>(prefab, count), 0)... };
+        (void)expand;
+    }
+    template<typename T>
+    void reservePrefabType_(const Prefab& prefab, int count) {
+        const int num = prefab.count<T>() * count;
+        if (num == 0) return;
+        vector<T>& the_vec = get<vector<T>>(components);
+        the_vec.reserve(the_vec.size() + num);
+        versions_<T>().reserve(the_vec.size() + num);
+        enabled_<T>().reserve(the_vec.size() + num);
+        indexMap_<T>().reserve(entities.size(), the_vec.size() + num);
+    }
+
+    //copies node components (other than Transform) to entity
+    template<size_t... I>
+    void instantiateComponents_(int entity_id, const Prefab::Node& node, std::index_sequence<I...>) {
+        int expand[] = { 0, (instantiateComponent_(entity_id, node, get<I>(node.components)), 0)... };
+        (void)expand;
+    }
+    template<typename T>
+    void instantiateComponent_(int entity_id, const Prefab::Node& node, const T& value) {
+        if (node.signature.test(componentIndex<T>()))
+            appendComponent_(entity_id, value);
+    }
+    //transform is built from the node's local matrix by instantiate
+    void instantiateComponent_(int, const Prefab::Node&, const Transform&) {}
+
+    //defragment key of every entity (entities without transform go last)
+    vector<uint64_t> computeEntityKeys_(DefragmentKey key) {
+        vector<Transform>& transforms = get<vector<Transform>>(components);
+        const size_t num = transforms.size();
+
+        //world matrix and depth of each transform, resolving parents first
+        vector<lm::mat4> world(num);
+        vector<int> depth(num, -1);
+        vector<int> chain;
+        for (size_t i = 0; i < num; i++) {
+            chain.clear();
+            for (int t = (int)i; t != -1 && depth[t] == -1; t = transforms[t].parent)
+                chain.push_back(t);
+            for (auto it = chain.rbegin(); it != chain.rend(); ++it) {
+                const int parent = transforms[*it].parent;
+                world[*it] = parent == -1 ? transforms[*it].matrix() : world[parent] * transforms[*it].matrix();
+                depth[*it] = parent == -1 ? 0 : depth[parent] + 1;
+            }
+        }
+
+        //quantize positions to 21 bits per axis inside the bounds of the scene
+        float bounds_min[3] = { FLT_MAX, FLT_MAX, FLT_MAX }, bounds_max[3] = { -FLT_MAX, -FLT_MAX, -FLT_MAX };
+        for (size_t i = 0; i < num; i++) {
+            for (int a = 0; a < 3; a++) {
+                bounds_min[a] = std::min(bounds_min[a], world[i].m[12 + a]);
+                bounds_max[a] = std::max(bounds_max[a], world[i].m[12 + a]);
+            }
+        }
+
+        vector<uint64_t> entity_keys(entities.size(), UINT64_MAX);
+        for (size_t i = 0; i < num; i++) {
+            uint64_t morton = 0;
+            for (int a = 0; a < 3; a++) {
+                const float range = bounds_max[a] - bounds_min[a];
+                const float normalized = range > 0.0f ? (world[i].m[12 + a] - bounds_min[a]) / range : 0.0f;
+                morton |= spreadBits_((uint64_t)(normalized * 2097151.0f)) << a;
+            }
+            const uint64_t depth_key = (uint64_t)std::min(depth[i], 255);
+            entity_keys[transforms[i].owner] = key == DefragmentDepth ? (depth_key << 56) | (morton >> 8) : morton;
+        }
+        return entity_keys;
+    }
+
+    //inserts two zero bits between each of the low 21 bits of x
+    static uint64_t spreadBits_(uint64_t x) {
+        x &= 0x1fffff;
+        x = (x | x << 32) & 0x1f00000000ffffull;
+        x = (x | x << 16) & 0x1f0000ff0000ffull;
+        x = (x | x << 8) & 0x100f00f00f00f00full;
+        x = (x | x << 4) & 0x10c30c30c30c30c3ull;
+        x = (x | x << 2) & 0x1249249249249249ull;
+        return x;
+    }
+
+    template<size_t... I>
+    void defragmentArrays_(const vector<uint64_t>& entity_keys, std::index_sequence<I...>) {
+        int expand[] = { 0, (defragmentArray_<typename tuple_element<I, ComponentTypes::Values>::type>(entity_keys), 0)... };
+        (void)expand;
+    }
+
+    //writes or copies each component array into snap
+    template<size_t... I>
+    void snapshotArrays_(EcsSnapshot& snap, SnapshotWriter& writer, const EcsSnapshot* previous, std::index_sequence<I...>) {
+        typedef typename ComponentTypes::Values Values;
+        int expand[] = { 0, (snapshotArray_<typename tuple_element<I, Values>::type>(snap, writer, previous,
+            std::is_trivially_copyable<typename tuple_element<I, Values>::type>()), 0)... };
+        (void)expand;
+    }
+    template<typename T>
+    void snapshotArray_(EcsSnapshot&, SnapshotWriter& writer, const EcsSnapshot*, std::true_type) {
+        writer.writeArray(get<vector<T>>(components));
+    }
+    template<typename T>
+    void snapshotArray_(EcsSnapshot& snap, SnapshotWriter&, const EcsSnapshot* previous, std::false_type) {
+        const int t = componentIndex<T>();
+        if (previous && previous->arrays[t] && previous->type_versions[t] == type_versions_[t]) {
+            snap.arrays[t] = previous->arrays[t];
+            return;
+        }
+        shared_ptr<SnapshotArray<T>> copy = make_shared<SnapshotArray<T>>();
+        copy->components = get<vector<T>>(components);
+        snap.arrays[t] = copy;
+    }
+
+    //loads each component array from snap, and relinks it to its owners
+    template<size_t... I>
+    void restoreArrays_(const EcsSnapshot& snap, SnapshotReader& reader, std::index_sequence<I...>) {
+        typedef typename ComponentTypes::Values Values;
+        int expand[] = { 0, (restoreArray_<typename tuple_element<I, Values>::type>(snap, reader,
+            std::is_trivially_copyable<typename tuple_element<I, Values>::type>()), 0)... };
+        (void)expand;
+    }
+    template<typename T>
+    void restoreArray_(const EcsSnapshot&, SnapshotReader& reader, std::true_type) {
+        reader.readArray(get<vector<T>>(components));
+        relinkArray_<T>();
+    }
+    template<typename T>
+    void restoreArray_(const EcsSnapshot& snap, SnapshotReader&, std::false_type) {
+        const SnapshotArrayBase* copy = snap.arrays[componentIndex<T>()].get();
+        if (copy) get<vector<T>>(components) = static_cast<const SnapshotArray<T>*>(copy)->components;
+        else get<vector<T>>(components).clear();
+        relinkArray_<T>();
+    }
+    template<typename T>
+    void relinkArray_() {
+        vector<T>& the_vec = get<vector<T>>(components);
+        for (size_t i = 0; i < the_vec.size(); i++)
+            indexMap_<T>().set(the_vec[i].owner, (int)i);
+    }
+
+    //stamps every component of every type with the current change tick
+    template<size_t... I>
+    void markAllChanged_(std::index_sequence<I...>) {
+        int expand[] = { 0, (component_versions_[I].assign(get<I>(components).size(), change_tick_),
+            type_versions_[I] = change_tick_, 0)... };
+        (void)expand;
+    }
+
+    //stable sorts array T (and its versions) by owner key
+    template<typename T>
+    void defragmentArray_(const vector<uint64_t>& entity_keys) {
+        vector<T>& the_vec = get<vector<T>>(components);
+        vector<uint32_t>& versions = versions_<T>();
+        const int num = (int)the_vec.size();
+        if (num < 2) return;
+
+        vector<int> order(num);
+        for (int i = 0; i < num; i++) order[i] = i;
+        std::stable_sort(order.begin(), order.end(), [&](int a, int b) {
+            return entity_keys[the_vec[a].owner] < entity_keys[the_vec[b].owner];
+        });
+
+        vector<T> sorted;
+        vector<uint32_t> sorted_versions;
+        vector<int> new_index(num);
+        sorted.reserve(num);
+        sorted_versions.reserve(num);
+        for (int i = 0; i < num; i++) {
+            sorted.push_back(std::move(the_vec[order[i]]));
+            sorted_versions.push_back(versions[order[i]]);
+            new_index[order[i]] = i;
+        }
+        the_vec.swap(sorted);
+        versions.swap(sorted_versions);
+
+        for (int i = 0; i < num; i++)
+            indexMap_<T>().set(the_vec[i].owner, i);
+        rebuildEnabled_<T>();
+        onComponentsReordered_(the_vec, new_index);
+        type_versions_[componentIndex<T>()] = change_tick_;
+    }
+
+    //copies every component of entity into prefab node
+    template<size_t... I>
+    void copyToPrefab_(Prefab::Node& node, int entity_id, std::index_sequence<I...>) {
+        int expand[] = { 0, (copyComponentToPrefab_(node, entity_id, get<I>(node.components)), 0)... };
+        (void)expand;
+    }
+    template<typename T>
+    void copyComponentToPrefab_(Prefab::Node& node, int entity_id, T& value) {
+        const int comp_index = getComponentID<T>(entity_id);
+        if (comp_index == -1) return;
+        value = get<vector<T>>(components)[comp_index];
+        node.signature.set(componentIndex<T>());
+    }
+
+    template<typename T>
+    auto& indexMap_() { return get<componentIndex<T>()>(component_indices_); }
+
+    //refills rows of a view cache, iterating the smallest of the component arrays
+    //and matching the signatures of its owners against the view's types
+    template<typename... Ts>
+    void rebuildView_(ViewCache<Ts...>& cache) {
+        typedef int (EntityComponentStore::*OwnerFunction)(int);
+        const OwnerFunction owner_functions[] = { &EntityComponentStore::ownerOf_<Ts>... };
+        const size_t sizes[] = { get<vector<Ts>>(components).size()... };
+        const ComponentSignature mask = ComponentTypes::signatureOf<Ts...>();
+        const size_t num_types = sizeof...(Ts);
+
+        size_t smallest = 0;
+        for (size_t k = 1; k < num_types; k++)
+            if (sizes[k] < sizes[smallest]) smallest = k;
+
+        cache.rows.clear();
+        for (size_t i = 0; i < sizes[smallest]; i++) {
+            const int owner = (this->*owner_functions[smallest])((int)i);
+            if ((entities[owner].signature & mask) != mask) continue;
+            cache.rows.push_back({ { getComponentID<Ts>(owner)... } });
+        }
+        cache.version = structure_version_;
+        cache.built = true;
+    }
+
+    //sets bit of each view match whose entity is active
+    template<typename... Ts>
+    void rebuildViewEnabled_(ViewCache<Ts...>& cache) {
+        typedef typename tuple_element<0, tuple<Ts...>>::type First;
+        const EnabledBits& first_enabled = enabled_<First>();
+        cache.enabled.clear();
+        cache.enabled.reserve(cache.rows.size());
+        for (auto& row : cache.rows)
+            cache.enabled.pushBack(first_enabled.test(row[0]));
+        cache.activation_version = activation_version_;
+    }
+
+    //recomputes enabled bits of array T from the owners, after a reorder or reload
+    template<typename T>
+    void rebuildEnabled_() {
+        vector<T>& the_vec = get<vector<T>>(components);
+        EnabledBits& enabled = enabled_<T>();
+        enabled.clear();
+        enabled.reserve(the_vec.size());
+        for (auto& comp : the_vec)
+            enabled.pushBack(entities[comp.owner].active);
+        activation_version_++;
+    }
+    template<size_t... I>
+    void rebuildAllEnabled_(std::index_sequence<I...>) {
+        int expand[] = { 0, (rebuildEnabled_<typename tuple_element<I, ComponentTypes::Values>::type>(), 0)... };
+        (void)expand;
+    }
+
+    //sets enabled bit of entity's component of type T, if it has one
+    template<typename T>
+    void setComponentEnabled_(int entity_id, bool value) {
+        const int comp_index = getComponentID<T>(entity_id);
+        if (comp_index == -1) return;
+        enabled_<T>().set(comp_index, value);
+        markChanged<T>(comp_index);
+    }
+    template<size_t... I>
+    void setEnabled_(int entity_id, bool value, std::index_sequence<I...>) {
+        int expand[] = { 0, (setComponentEnabled_<typename tuple_element<I, ComponentTypes::Values>::type>(entity_id, value), 0)... };
+        (void)expand;
+    }
+
+    //interned name id -> first and last live entity with that name. Entities
+    //sharing a name (e.g. prefab copies) are linked in creation order through
+    //name_links_, so destroying any of them is O(1), and getEntity returns the
+    //oldest
+    struct NameList { int first, last; };
+    struct NameLink { int prev = -1, next = -1; };
+    unordered_map<uint32_t, NameList> name_index_;
+    //parallel to entities
+    vector<NameLink> name_links_;
+
+    void indexName_(int entity_id) {
+        const StringID& name = entities[entity_id].name;
+        if (name.empty()) return;
+        if ((int)name_links_.size() < (int)entities.size()) name_links_.resize(entities.size());
+        NameLink& link = name_links_[entity_id];
+        link.next = -1;
+        auto it = name_index_.find(name.id);
+        if (it == name_index_.end()) {
+            link.prev = -1;
+            name_index_.emplace(name.id, NameList{ entity_id, entity_id });
+            return;
+        }
+        link.prev = it->second.last;
+        name_links_[it->second.last].next = entity_id;
+        it->second.last = entity_id;
+    }
+
+    //removes entity from name index. The next live entity with the same name,
+    //if any, takes over getEntity
+    void unindexName_(int entity_id) {
+        const StringID name = entities[entity_id].name;
+        if (name.empty()) return;
+        auto it = name_index_.find(name.id);
+        if (it == name_index_.end()) return;
+        const NameLink link = name_links_[entity_id];
+        if (link.prev != -1) name_links_[link.prev].next = link.next;
+        else it->second.first = link.next;
+        if (link.next != -1) name_links_[link.next].prev = link.prev;
+        else it->second.last = link.prev;
+        name_links_[entity_id] = NameLink();
+        if (it->second.first == -1) name_index_.erase(it);
+    }
+
+    //calls removeComponentFromEntity for every type in ComponentArrays
+    template<size_t... I>
+    void removeAllComponents_(int entity_id, std::index_sequence<I...>) {
+        int expand[] = { 0, (removeComponentFromEntity<typename tuple_element<I, ComponentArrays>::type::value_type>(entity_id), 0)... };
+        (void)expand;
+    }
+
+    //hook to add components which always go together with T. Only called by
+    //createComponentForEntity: prefabs must contain both. Default does nothing
+    template<typename T>
+    void onComponentCreated_(T&) {}
+
+    //a collider stores its collision state in a Collision component
+    void onComponentCreated_(Collider& comp) {
+        if (getComponentID<Collision>(comp.owner) == -1)
+            createComponentForEntity<Collision>(comp.owner);
+    }
+
+    //hooks to repair indices held by other components when a component is
+    //removed, or moved to fill the removed slot. Default does nothing
+    template<typename T>
+    void onComponentRemoved_(T&, int) {}
+
+    void onComponentRemoved_(Collider& comp, int) {
+        removeComponentFromEntity<Collision>(comp.owner);
+    }
+    template<typename T>
+    void onComponentMoved_(T&, int, int) {}
+
+    //children of a removed transform keep their world position but become roots
+    void onComponentRemoved_(Transform& comp, int comp_index) {
+        vector<Transform>& transforms = get<vector<Transform>>(components);
+        int c = comp.first_child;
+        while (c != -1) {
+            Transform& child = transforms[c];
+            const int next = child.next_sibling;
+            child.set(child.getGlobalMatrix(transforms));
+            child.parent = -1;
+            child.next_sibling = -1;
+            markChanged<Transform>(c);
+            c = next;
+        }
+        comp.first_child = -1;
+        unlinkChild_(comp_index);
+    }
+    //links to a moved transform must use its new index. It may now be stored
+    //before its parent, or after its children
+    void onComponentMoved_(Transform& comp, int old_index, int new_index) {
+        vector<Transform>& transforms = get<vector<Transform>>(components);
+        if (comp.parent != -1) {
+            int* link = &transforms[comp.parent].first_child;
+            while (*link != old_index) link = &transforms[*link].next_sibling;
+            *link = new_index;
+            if (comp.parent > new_index) hierarchy_unsorted_ = true;
+        }
+        for (int c = comp.first_child; c != -1; c = transforms[c].next_sibling) {
+            transforms[c].parent = new_index;
+            if (c < new_index) hierarchy_unsorted_ = true;
+        }
+    }
+
+    //fix indices into an array after defragment, new_index maps old -> new
+    template<typename T>
+    void onComponentsReordered_(vector<T>&, const vector<int>&) {}
+    void onComponentsReordered_(vector<Transform>& transforms, const vector<int>& new_index) {
+        for (auto& t : transforms) {
+            if (t.parent != -1) t.parent = new_index[t.parent];
+            if (t.first_child != -1) t.first_child = new_index[t.first_child];
+            if (t.next_sibling != -1) t.next_sibling = new_index[t.next_sibling];
+        }
+        hierarchy_unsorted_ = !hierarchyInOrder_();
+    }
+    void onComponentsReordered_(vector<Camera>&, const vector<int>& new_index) {
+        if (main_camera != -1) main_camera = new_index[main_camera];
+    }
+
+    //main camera is stored as index into camera array
+    void onComponentRemoved_(Camera&, int comp_index) {
+        if (main_camera == comp_index) main_camera = -1;
+    }
+    void onComponentMoved_(Camera&, int old_index, int new_index) {
+        if (main_camera == old_index) main_camera = new_index;
+    }
 };
@@ -0,0 +1,75 @@
+//
+//  FramePacket.h
+//
+//  Everything GraphicsSystem needs from the ECS to draw one frame, copied out
+//  by GraphicsSystem::extract. Drawing it (GraphicsSystem::render) reads no
+//  component, so it can run on the thread with the OpenGL context while the
+//  next frame is simulated and extracted into a second packet.
+//  Usage:
+//      graphics_system.extract(packets[next]);       //simulation side, no OpenGL
+//      graphics_system.render(packets[drawn]);       //OpenGL thread, at the same time
+//
+#pragma once
+#include "includes.h"
+#include "Components.h"
+#include <vector>
+#include <cstdint>
+
+//one light of the lights uniform buffer, std140 layout
+struct LightUniform {
+	GLfloat data[16]; //position, direction, color, attenuation and spot cosines
+	GLfloat matrix[16];
+	GLint type;
+	GLint cast_shadow;
+	GLint padding[2];
+};
+static_assert(sizeof(LightUniform) == 144, "LightUniform must match the std140 layout of the shader block");
+
+//one row of ECS.view<Mesh, Transform>(), in mesh array order (sorted by material)
+struct DrawItem {
+	lm::mat4 world;
+	lm::mat4 normal;
+	int geometry;
+	int material;
+	RenderMode render_mode;
+	uint8_t enabled; //entity is active: drawn into shadow maps
+	uint8_t visible; //enabled and inside the camera frustum
+};
+
+//light volume of the deferred pass, one per light in light array order
+struct LightVolume {
+	int type;
+	bool enabled;
+	lm::vec3 position;
+	lm::vec3 direction;
+	float radius;
+	float spot_outer;
+};
+
+//shadow map redrawn from a light
+struct ShadowPass {
+	int shadow_map;
+	lm::mat4 view_projection;
+};
+
+struct FramePacket {
+	//output camera
+	lm::mat4 view_projection;
+	lm::mat4 view_matrix;
+	lm::mat4 projection_matrix;
+	lm::vec3 camera_position;
+
+	std::vector<DrawItem> draws;
+
+	//lights. light_uniforms is only filled, and uploaded, if lights changed
+	bool lights_changed = false;
+	std::vector<LightUniform> light_uniforms;
+	std::vector<LightVolume> lights;
+
+	//shadow maps are kept from the last drawn frame unless shadows changed
+	bool shadows_changed = false;
+	std::vector<ShadowPass> shadow_passes;
+
+	//false until the first extract
+	bool valid = false;
+};
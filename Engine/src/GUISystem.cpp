@@ -23,7 +23,10 @@ void GUISystem::init(int w, int h) {
 void GUISystem::lateInit() {
 	//for all images
 	auto& elements = ECS.getAllComponents<GUIElement>();
-	for (auto& el : elements) {
+	for (size_t i = 0; i < elements.size(); i++) {
+		GUIElement& el = elements[i];
+		//sizes and bounds change here, so snapshots must copy them again
+		ECS.markChanged<GUIElement>((int)i);
 
 		//check to see if we have specified gui width and height, if not, set them according to texture
 		glBindTexture(GL_TEXTURE_2D, el.texture);
@@ -53,10 +56,12 @@ void GUISystem::lateInit() {
 
 	//for all texts
 	auto& text_elements = ECS.getAllComponents<GUIText>();
-	for (auto& el : text_elements) {
+	for (size_t i = 0; i < text_elements.size(); i++) {
+		GUIText& el = text_elements[i];
 		//check if texture has been created
 		if (el.texture == 0) {
 			el.texture = createTextTexture(el.text, el.font_face, el.font_size, el.width, el.height);
+			ECS.markChanged<GUIText>((int)i);
 		}
 	}
 }
@@ -70,9 +75,8 @@ void GUISystem::update(float dt) {
 	//draw GUI images first
 	glUseProgram(icon_shader_->program);
 
-	//for all images
-	auto& elements = ECS.getAllComponents<GUIElement>();
-	for (auto& el : elements) {
+	//for all images of active entities
+	ECS.eachEnabled<GUIElement>([&](GUIElement& el) {
 
 		//scale -1->+1 quad to size of image
 		lm::mat4 model;
@@ -97,14 +101,13 @@ void GUISystem::update(float dt) {
 		//draw
 		glBindVertexArray(vao_);
 		glDrawElements(GL_TRIANGLES, 6, GL_UNSIGNED_INT, 0);
-	}
+	});
 
 	//use a different shader for text
 	glUseProgram(text_shader_->program);
 
-	//for all texts
-	auto& text_elements = ECS.getAllComponents<GUIText>();
-	for (auto& el : text_elements) {
+	//for all texts of active entities
+	ECS.eachEnabled<GUIText>([&](GUIText& el) {
 
 		//scale -1->+1 quad to size of image
 		lm::mat4 model;
@@ -132,7 +135,7 @@ void GUISystem::update(float dt) {
 		//draw
 		glBindVertexArray(vao_);
 		glDrawElements(GL_TRIANGLES, 6, GL_UNSIGNED_INT, 0);
-	}
+	});
 
 	glEnable(GL_DEPTH_TEST);
 	glDisable(GL_BLEND);
@@ -266,12 +269,12 @@ GLuint GUISystem::createTextTexture(std::string text, std::string font_path, int
 void GUISystem::key_mouse_callback(int key, int action, int mods) {
 	if (key == GLFW_MOUSE_BUTTON_1 && action == GLFW_PRESS) {
 
-		auto& elements = ECS.getAllComponents<GUIElement>();
-		for (auto& el : elements) {
+		//inactive elements can't be clicked
+		ECS.eachEnabled<GUIElement>([&](GUIElement& el) {
 			if (el.screen_bounds.pointInBounds(mouse_x_, mouse_y_)) {
 				el.onClick();
 			}
-		}
+		});
 	}
 }
 
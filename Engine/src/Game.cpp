@@ -8,8 +8,11 @@
 #include "Shader.h"
 #include "extern.h"
 #include "Parsers.h"
+#include <cmath>
 
 Game* Game::instance = 0;
+constexpr float Game::FIXED_DT;
+constexpr double Game::TIME_SLICED_BUDGET_MS;
 
 Game::Game() {
 
@@ -20,6 +23,7 @@ Game::Game() {
 void Game::init(int w, int h) {
 
 	window_width_ = w; window_height_ = h;
+	ECS.setJobSystem(&job_system_);
 	//******* INIT SYSTEMS *******
 
 	//init systems except debug, which needs info about scene
@@ -30,6 +34,7 @@ void Game::init(int w, int h) {
 	gui_system_.init(window_width_, window_height_);
     animation_system_.init();
     camera_system_.init();
+    transform_system_.init(&job_system_);
 
 	/******** SHADERS **********/
 
@@ -71,12 +76,16 @@ void Game::init(int w, int h) {
 	sphere_mesh2.geometry = graphics_system_.createGeometryFromFile("data/assets/ball.obj");
 	sphere_mesh2.material = mat_red_index;
 
-	Parsers::parseJSONLevel("data/assets/cameras.json", graphics_system_, control_system_);
+	Parsers::parseJSONLevel(level_file_, graphics_system_, control_system_);
 
 	//create camera
 	createFreeCamera_();
     
+    //store components in spatial order, before systems sort or index them
+    ECS.defragment(EntityComponentStore::DefragmentMorton);
+
     //******* LATE INIT AFTER LOADING RESOURCES *******//
+    transform_system_.lateInit();
     graphics_system_.lateInit();
     script_system_.lateInit();
     animation_system_.lateInit();
@@ -85,46 +94,199 @@ void Game::init(int w, int h) {
 
 	debug_system_.setActive(true);
 
+	addSystemsToSchedulers_();
+
+	//first frame draws the loaded level as it is
+	graphics_system_.extract(frame_packets_[drawn_packet_]);
+}
+
+//declares what each system reads and writes, so systems which don't conflict
+//run at the same time. Where they do, they run in the order added here.
+//Systems which change the world go in the fixed step, which runs while the
+//last frame is drawn, so none of them (scripts included) may use OpenGL.
+//Systems which draw over the frame run once it is drawn
+void Game::addSystemsToSchedulers_() {
+	/**** SIMULATION, ONCE PER FIXED STEP ****/
+
+	//view tracks, camera blending and input move cameras
+	simulation_scheduler_.add("view tracks", SystemAccess().write<ViewTrack, Camera, Transform>().read(ResourceChangeTick),
+		[this](float dt) { camera_system_.updateTracks(dt); });
+	simulation_scheduler_.add("camera", SystemAccess().write<Camera, Transform>().read(ResourceInput | ResourceChangeTick).write(ResourceCameras),
+		[this](float dt) { camera_system_.update(dt); });
+	simulation_scheduler_.add("control", SystemAccess().write<Camera, Transform>().read<Collision>().read(ResourceInput | ResourceChangeTick).write(ResourceCameras),
+		[this](float dt) { control_system_.update(dt); });
+
+	//world matrices, for collision. Sorting the hierarchy may reorder transforms
+	simulation_scheduler_.add("transform", SystemAccess().write<Transform>().write(ResourceTransformCache | ResourceChangeTick),
+		[this](float dt) { transform_system_.update(dt); });
+
+	//collision reads cached world matrices only, so it overlaps animation
+	simulation_scheduler_.add("collision", SystemAccess().read<Collider>().write<Collision>().read(ResourceTransformCache),
+		[this](float dt) { collision_system_.update(dt); });
+	simulation_scheduler_.add("animation", SystemAccess().write<Animation, Transform>().read(ResourceChangeTick),
+		[this](float dt) { animation_system_.update(dt); });
+
+	//scripts may touch anything
+	simulation_scheduler_.add("scripts", SystemAccess().setExclusive(), [this](float dt) { script_system_.update(dt); });
+
+	simulation_scheduler_.add("sync point", SystemAccess().setExclusive(), [this](float) { syncPoint_(); });
+
+	//world matrices again, after animation, scripts and structural changes.
+	//Only transforms which changed since the first update are recomputed
+	simulation_scheduler_.add("transform (late)", SystemAccess().write<Transform>().write(ResourceTransformCache | ResourceChangeTick),
+		[this](float dt) { transform_system_.update(dt); });
+
+	/**** ONCE PER FRAME, AFTER THE SCENE IS DRAWN ****/
+
+	//time sliced work gets whatever is left of the frame's budget. Uploads
+	//first: a level waiting for them holds up the swap
+	time_sliced_.add("level uploads", 1, [this](const TimeSlice& slice) { return level_loader_.uploadGeometries(graphics_system_, slice); });
+	time_sliced_.add("far scripts", 0, [this](const TimeSlice& slice) { return script_system_.updateFarScripts(slice); });
+	render_scheduler_.add("time sliced", SystemAccess().setExclusive().write(ResourceGL), [this](float) { time_sliced_.run(); });
+
+	render_scheduler_.add("gui", SystemAccess().read<GUIElement, GUIText>().write(ResourceGL),
+		[this](float dt) { gui_system_.update(dt); });
+
+	//the debug gui edits anything
+	render_scheduler_.add("debug", SystemAccess().setExclusive(), [this](float dt) { debug_system_.update(dt); });
 }
 
-//update each system in turn
+//draws the packet extracted last frame while the simulation steps and the
+//next packet is extracted on the job system, then runs what needs both the
+//OpenGL context and the whole ECS. The scene on screen is one frame behind
+//the simulation. See addSystemsToSchedulers_ for which systems run where
 void Game::update(float dt) {
 
 	if (ECS.getAllComponents<Camera>().size() == 0) {print("There is no camera set!"); return;}
 
-    //camera
-    camera_system_.update(dt);
+	FramePacket& next_packet = frame_packets_[1 - drawn_packet_];
+	JobCounter simulated;
+	job_system_.run([this, dt, &next_packet]() { simulate_(dt, next_packet); }, &simulated);
 
-	//update input
-	control_system_.update(dt);
+	const double draw_start = glfwGetTime();
+	graphics_system_.render(frame_packets_[drawn_packet_]);
+	draw_ms_ = (glfwGetTime() - draw_start) * 1000.0;
+	job_system_.wait(simulated);
+	drawn_packet_ = 1 - drawn_packet_;
 
-	//collision
-	collision_system_.update(dt);
+	//swap in a level loaded in the background. Creating its resources needs
+	//the context, so it waits for the simulation
+	if (level_loader_.ready())
+		finishLevelLoad_();
 
-    //animation
-    animation_system_.update(dt);
-    
-	//scripts
-	script_system_.update(dt);
+	//time sliced work runs after the draw, so the budget starts here
+	time_sliced_.beginFrame(TIME_SLICED_BUDGET_MS);
+	render_scheduler_.run(dt, job_system_);
 
-	//render
-	graphics_system_.update(dt);
-    
-	//gui
-	gui_system_.update(dt);
+	//the debug gui or a new level sorted the meshes after extraction
+	if (graphics_system_.isPacketStale())
+		graphics_system_.extract(frame_packets_[drawn_packet_]);
+}
 
-	//debug
-	debug_system_.update(dt);
-   
+//steps the simulation until it catches up with real time, then extracts
+//what to draw with transforms and camera interpolated between the last two
+//steps. Runs as a job, with no OpenGL
+void Game::simulate_(float dt, FramePacket& packet) {
+	const double start = glfwGetTime();
+	step_accumulator_ += dt;
+	steps_last_frame_ = 0;
+	while (step_accumulator_ >= FIXED_DT && steps_last_frame_ < MAX_STEPS_PER_FRAME) {
+		transform_system_.beginStep();
+		simulation_scheduler_.run(FIXED_DT, job_system_);
+		step_accumulator_ -= FIXED_DT;
+		steps_last_frame_++;
+	}
+	//too far behind (long frame, breakpoint): drop the time rather than
+	//spiral into ever more steps per frame
+	if (step_accumulator_ >= FIXED_DT)
+		step_accumulator_ = std::fmod(step_accumulator_, (double)FIXED_DT);
+
+	interpolation_alpha_ = (float)(step_accumulator_ / FIXED_DT);
+	transform_system_.interpolate(interpolation_alpha_);
+	camera_system_.interpolate(interpolation_alpha_);
+	graphics_system_.extract(packet);
+	simulate_ms_ = (glfwGetTime() - start) * 1000.0;
+}
+
+//apply structural changes recorded in ECS command buffers, and put transforms
+//back in hierarchy order if they were reparented. Runs with no other system
+void Game::syncPoint_() {
+	ECS.playbackCommands();
+	ECS.sortHierarchy();
+
+	//quicksave, quickload and rewind, while no system holds components
+	updateSnapshots_();
 }
+
+//takes a snapshot every step for rewinding, or restores an older one
+void Game::updateSnapshots_() {
+	if (quicksave_requested_) {
+		quicksave_ = ECS.snapshot(&last_snapshot_);
+		quicksave_requested_ = false;
+	}
+	if (quickload_requested_) {
+		if (!quicksave_.empty()) {
+			ECS.restore(quicksave_);
+			transform_system_.snapInterpolation();
+			rewind_buffer_.clear();
+			last_snapshot_ = EcsSnapshot();
+		}
+		quickload_requested_ = false;
+	}
+	if (!rewind_enabled_ || ++steps_since_rewind_snapshot_ < REWIND_INTERVAL) return;
+	steps_since_rewind_snapshot_ = 0;
+
+	//step back one snapshot, keeping the oldest
+	if (rewinding_ && rewind_buffer_.size() > 1) {
+		rewind_buffer_.discardNewest(1);
+		last_snapshot_ = rewind_buffer_.get(0);
+		ECS.restore(last_snapshot_);
+		return;
+	}
+	last_snapshot_ = ECS.snapshot(&last_snapshot_);
+	rewind_buffer_.push(last_snapshot_);
+}
+
+void Game::loadLevel(const std::string& filename) {
+	if (level_loader_.start(filename))
+		level_file_ = filename;
+}
+
+void Game::setRewindEnabled(bool enabled) {
+	rewind_enabled_ = enabled;
+	if (enabled) return;
+	rewind_buffer_.clear();
+	last_snapshot_ = EcsSnapshot();
+}
+
+//creates resources of the loaded level, swaps its world into ECS and lets
+//systems catch up with the new world
+void Game::finishLevelLoad_() {
+	if (!level_loader_.finish(graphics_system_, control_system_)) return;
+
+	//as in init, the free camera comes after those of the level
+	createFreeCamera_();
+	ECS.defragment(EntityComponentStore::DefragmentMorton);
+	transform_system_.lateInit();
+	graphics_system_.onWorldSwapped();
+	debug_system_.onWorldSwapped();
+	camera_system_.lateInit();
+
+	//snapshots belong to the previous world
+	rewind_buffer_.clear();
+	last_snapshot_ = EcsSnapshot();
+	quicksave_ = EcsSnapshot();
+}
+
 //update game viewports
 void Game::update_viewports(int window_width, int window_height) {
 	window_width_ = window_width;
 	window_height_ = window_height;
 
 	auto& cameras = ECS.getAllComponents<Camera>();
-	for (auto& cam : cameras) {
-		cam.setPerspective(60.0f*DEG2RAD, (float)window_width_ / (float) window_height_, 0.01f, 10000.0f);
+	for (size_t i = 0; i < cameras.size(); i++) {
+		cameras[i].setPerspective(60.0f*DEG2RAD, (float)window_width_ / (float) window_height_, 0.01f, 10000.0f);
+		ECS.markChanged<Camera>((int)i);
 	}
 
 	graphics_system_.updateMainViewport(window_width_, window_height_);
@@ -159,51 +321,46 @@ int Game::createPlayer_(float aspect, ControlSystem& sys) {
 	//FPS colliders 
 	//each collider ray entity is parented to the playerFPS entity
 	int ent_down_ray = ECS.createEntity("Down Ray");
-	Transform& down_ray_trans = ECS.getComponentFromEntity<Transform>(ent_down_ray);
-	down_ray_trans.parent = ECS.getComponentID<Transform>(ent_player); //set parent as player entity *transform*!
+	ECS.setParent(ent_down_ray, ent_player);
 	Collider& down_ray_collider = ECS.createComponentForEntity<Collider>(ent_down_ray);
 	down_ray_collider.collider_type = ColliderTypeRay;
 	down_ray_collider.direction = lm::vec3(0.0, -1.0, 0.0);
 	down_ray_collider.max_distance = 100.0f;
 
 	int ent_left_ray = ECS.createEntity("Left Ray");
-	Transform& left_ray_trans = ECS.getComponentFromEntity<Transform>(ent_left_ray);
-	left_ray_trans.parent = ECS.getComponentID<Transform>(ent_player); //set parent as player entity *transform*!
+	ECS.setParent(ent_left_ray, ent_player);
 	Collider& left_ray_collider = ECS.createComponentForEntity<Collider>(ent_left_ray);
 	left_ray_collider.collider_type = ColliderTypeRay;
 	left_ray_collider.direction = lm::vec3(-1.0, 0.0, 0.0);
 	left_ray_collider.max_distance = 1.0f;
 
 	int ent_right_ray = ECS.createEntity("Right Ray");
-	Transform& right_ray_trans = ECS.getComponentFromEntity<Transform>(ent_right_ray);
-	right_ray_trans.parent = ECS.getComponentID<Transform>(ent_player); //set parent as player entity *transform*!
+	ECS.setParent(ent_right_ray, ent_player);
 	Collider& right_ray_collider = ECS.createComponentForEntity<Collider>(ent_right_ray);
 	right_ray_collider.collider_type = ColliderTypeRay;
 	right_ray_collider.direction = lm::vec3(1.0, 0.0, 0.0);
 	right_ray_collider.max_distance = 1.0f;
 
 	int ent_forward_ray = ECS.createEntity("Forward Ray");
-	Transform& forward_ray_trans = ECS.getComponentFromEntity<Transform>(ent_forward_ray);
-	forward_ray_trans.parent = ECS.getComponentID<Transform>(ent_player); //set parent as player entity *transform*!
+	ECS.setParent(ent_forward_ray, ent_player);
 	Collider& forward_ray_collider = ECS.createComponentForEntity<Collider>(ent_forward_ray);
 	forward_ray_collider.collider_type = ColliderTypeRay;
 	forward_ray_collider.direction = lm::vec3(0.0, 0.0, -1.0);
 	forward_ray_collider.max_distance = 1.0f;
 
 	int ent_back_ray = ECS.createEntity("Back Ray");
-	Transform& back_ray_trans = ECS.getComponentFromEntity<Transform>(ent_back_ray);
-	back_ray_trans.parent = ECS.getComponentID<Transform>(ent_player); //set parent as player entity *transform*!
+	ECS.setParent(ent_back_ray, ent_player);
 	Collider& back_ray_collider = ECS.createComponentForEntity<Collider>(ent_back_ray);
 	back_ray_collider.collider_type = ColliderTypeRay;
 	back_ray_collider.direction = lm::vec3(0.0, 0.0, 1.0);
 	back_ray_collider.max_distance = 1.0f;
 
 	//the control system stores the FPS colliders 
-	sys.FPS_collider_down = ECS.getComponentID<Collider>(ent_down_ray);
-	sys.FPS_collider_left = ECS.getComponentID<Collider>(ent_left_ray);
-	sys.FPS_collider_right = ECS.getComponentID<Collider>(ent_right_ray);
-	sys.FPS_collider_forward = ECS.getComponentID<Collider>(ent_forward_ray);
-	sys.FPS_collider_back = ECS.getComponentID<Collider>(ent_back_ray);
+	sys.FPS_collider_down = ent_down_ray;
+	sys.FPS_collider_left = ent_left_ray;
+	sys.FPS_collider_right = ent_right_ray;
+	sys.FPS_collider_forward = ent_forward_ray;
+	sys.FPS_collider_back = ent_back_ray;
 
 	ECS.main_camera = ECS.getComponentID<Camera>(ent_player);
 
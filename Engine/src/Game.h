@@ -14,6 +14,12 @@
 #include "GUISystem.h"
 #include "AnimationSystem.h"
 #include "CameraSystem.h"
+#include "TransformSystem.h"
+#include "EcsSnapshot.h"
+#include "LevelLoader.h"
+#include "JobSystem.h"
+#include "SystemScheduler.h"
+#include "TimeSlicedScheduler.h"
 
 class Game
 {
@@ -38,6 +44,14 @@ public:
 		if (key == GLFW_KEY_0 && action == GLFW_PRESS && mods == GLFW_MOD_ALT)
 			debug_system_.toggleimGUI();
 
+		//F5 quicksave, F9 quickload, hold backspace to rewind
+		if (key == GLFW_KEY_F5 && action == GLFW_PRESS) quicksave_requested_ = true;
+		if (key == GLFW_KEY_F9 && action == GLFW_PRESS) quickload_requested_ = true;
+		if (key == GLFW_KEY_BACKSPACE && action != GLFW_REPEAT) rewinding_ = action == GLFW_PRESS;
+
+		//F6 reloads the level in the background
+		if (key == GLFW_KEY_F6 && action == GLFW_PRESS) loadLevel(level_file_);
+
 		if (!debug_system_.isShowGUI())
 			control_system_.key_mouse_callback(key, action, mods);
 	}
@@ -51,8 +65,47 @@ public:
 	}
 	void update_viewports(int window_width, int window_height);
 
+	//loads level file on a loader thread. The current level keeps running
+	//until the new one is ready, then it is swapped in between two frames
+	void loadLevel(const std::string& filename);
+
+    //one thread per core, for systems to split their work into jobs.
+    //Declared first, so it outlives every system
+    JobSystem job_system_;
+
     CameraSystem camera_system_;
     ControlSystem control_system_;
+    TransformSystem transform_system_;
+
+    //simulation systems run in fixed steps of FIXED_DT seconds, as many as
+    //real time needs but at most MAX_STEPS_PER_FRAME per frame; rendering
+    //runs once per frame and interpolates between the last two steps.
+    //The steps and the extraction of the next frame packet run as a job
+    //while this thread, which owns the OpenGL context, draws the last packet
+    static constexpr float FIXED_DT = 1.0f / 120.0f;
+    static const int MAX_STEPS_PER_FRAME = 8;
+    int getStepsLastFrame() const { return steps_last_frame_; }
+    float getInterpolationAlpha() const { return interpolation_alpha_; }
+
+    //when and where each system ran in the last simulation step and the last
+    //rendered frame
+    const SystemTimeline& getSimulationTimeline() const { return simulation_scheduler_.getTimeline(); }
+    const SystemTimeline& getRenderTimeline() const { return render_scheduler_.getTimeline(); }
+    //time spent last frame simulating and extracting, and drawing the packet
+    //meanwhile. Frame time is about the larger of the two, not their sum
+    double getSimulateMs() const { return simulate_ms_; }
+    double getDrawMs() const { return draw_ms_; }
+
+    //work which may lag behind (far scripts, level uploads) gets at most
+    //TIME_SLICED_BUDGET_MS of each frame
+    static constexpr double TIME_SLICED_BUDGET_MS = 2.0;
+    const TimeSlicedScheduler& getTimeSlicedScheduler() const { return time_sliced_; }
+
+    //rewind (hold backspace) snapshots the world every REWIND_INTERVAL fixed
+    //steps, and steps back at the same rate. Disabling it drops the history
+    static const int REWIND_INTERVAL = 4;
+    bool isRewindEnabled() const { return rewind_enabled_; }
+    void setRewindEnabled(bool enabled);
 
     int window_width_;
     int window_height_;
@@ -65,9 +118,44 @@ private:
 	GUISystem gui_system_;
     AnimationSystem animation_system_;
 
+	//systems of a fixed step and of a frame, each run as a graph on the job system
+	SystemScheduler simulation_scheduler_;
+	SystemScheduler render_scheduler_;
+	TimeSlicedScheduler time_sliced_;
+	void addSystemsToSchedulers_();
+	void syncPoint_();
+	void simulate_(float dt, FramePacket& packet);
+
+	//frame packets: one drawn while the other is filled, swapped every frame
+	FramePacket frame_packets_[2];
+	int drawn_packet_ = 0;
+	double simulate_ms_ = 0.0;
+	double draw_ms_ = 0.0;
+
+	//simulated time not yet stepped, less than FIXED_DT after each update
+	double step_accumulator_ = 0.0;
+	int steps_last_frame_ = 0;
+	float interpolation_alpha_ = 0.0f;
+
 	int createFreeCamera_();
 	int createPlayer_(float aspect, ControlSystem& sys);
 
+	//save and rewind, applied at the sync point of update
+	void updateSnapshots_();
+	EcsSnapshot quicksave_;
+	EcsSnapshot last_snapshot_;
+	SnapshotRing rewind_buffer_{ 150, 15 }; //last 5 seconds, one snapshot every REWIND_INTERVAL steps
+	int steps_since_rewind_snapshot_ = 0;
+	bool rewind_enabled_ = true;
+	bool quicksave_requested_ = false;
+	bool quickload_requested_ = false;
+	bool rewinding_ = false;
+
+	//background level loading
+	LevelLoader level_loader_;
+	std::string level_file_ = "data/assets/cameras.json";
+	void finishLevelLoad_();
+
 	int mouse_x_;
 	int mouse_y_;
 };
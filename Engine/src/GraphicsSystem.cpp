@@ -69,43 +69,149 @@ void GraphicsSystem::init(int window_width, int window_height, std::string asset
 //called after loading everything
 void GraphicsSystem::lateInit() {
 	// sort meshes initially
-    sortMeshes_();
+    sortMeshes();
 
-	//create shadow buffers depending on number of lights
-	for (size_t i = 0; i < ECS.getAllComponents<Light>().size(); i++) {
-		shadow_frame_[i].initDepth(2048, 2048);
-	}
+	createShadowMaps_();
+
+}
 
+//meshes of a new world are unsorted, and it may have more lights
+void GraphicsSystem::onWorldSwapped() {
+	sortMeshes();
+	createShadowMaps_();
 }
 
-void GraphicsSystem::update(float dt) {
+//create shadow buffers depending on number of lights, if not created yet
+void GraphicsSystem::createShadowMaps_() {
+	for (size_t i = 0; i < ECS.getAllComponents<Light>().size() && i < MAX_LIGHTS; i++) {
+		if (shadow_frame_[i].framebuffer == (GLuint)-1)
+			shadow_frame_[i].initDepth(2048, 2048);
+	}
+}
+
+/**** EXTRACTION ****/
+
+//copies what the frame draws out of the ECS. No OpenGL, so it runs on the
+//simulation side while render draws the previous packet
+void GraphicsSystem::extract(FramePacket& packet) {
+
+	//anything written after this tick is picked up next frame
+	const uint32_t tick = ECS.takeChangeTick();
+	//a packet replacing one which was never drawn (see sortMeshes) must
+	//upload and redraw everything the lost one would have
+	const bool redraw_all = packet_stale_ || !packet.valid;
     
-	updateAllCameras_(dt);
+	updateAllCameras_();
+	Camera& cam = ECS.getComponentInArray<Camera>(Game::instance->camera_system_.GetOutputCamera());
+	packet.view_projection = cam.view_projection;
+	packet.view_matrix = cam.view_matrix;
+	packet.projection_matrix = cam.projection_matrix;
+	packet.camera_position = cam.position;
+
+	//pack lights only if a light, its shadow setup, or the transform of one, changed
+	bool lights_changed = redraw_all || ECS.changedSince<Light>(last_tick_) || ECS.changedSince<LightShadow>(last_tick_);
+	auto light_view = ECS.view<Light, Transform>();
+	for (size_t i = 0; i < light_view.size() && !lights_changed; i++)
+		lights_changed = transformChangedSince_(light_view.index<Transform>(i), last_tick_);
+	packet.lights_changed = lights_changed;
+	if (lights_changed)
+		packLights_(packet.light_uniforms);
+	extractLightVolumes_(packet.lights);
+
+	//shadow maps are kept from last frame if no light or mesh moved. Only
+	//active lights which cast shadows; shadow map i belongs to light i
+	packet.shadows_changed = redraw_all || shadowsChanged_(lights_changed);
+	packet.shadow_passes.clear();
+	if (packet.shadows_changed) {
+		auto shadow_lights = ECS.view<Light, LightShadow>();
+		shadow_lights.eachIndex([&](size_t i) {
+			if (!shadow_lights.get<Light>(i).cast_shadow) return;
+			ShadowPass pass;
+			pass.shadow_map = shadow_lights.index<Light>(i);
+			pass.view_projection = shadow_lights.get<LightShadow>(i).view_projection;
+			packet.shadow_passes.push_back(pass);
+		});
+	}
+
+	cullMeshes_(cam.view_projection);
+	extractDraws_(packet.draws);
+
+	packet.valid = true;
+	packet_stale_ = false;
+	last_tick_ = tick;
+}
+
+//one draw per mesh row, in parallel for many meshes. Matrices are the
+//interpolated ones of the transform system
+void GraphicsSystem::extractDraws_(std::vector<DrawItem>& draws) {
+	auto meshes = ECS.view<Mesh, Transform>();
+	const TransformSystem& transform_system = Game::instance->transform_system_;
+	draws.resize(meshes.size());
+	auto fill = [&](size_t begin, size_t end) {
+		for (size_t i = begin; i < end; i++) {
+			const Mesh& mesh = meshes.get<Mesh>(i);
+			const Transform& transform = meshes.get<Transform>(i);
+			DrawItem& draw = draws[i];
+			draw.world = transform_system.renderWorld(transform);
+			draw.normal = transform_system.renderNormalMatrix(transform);
+			draw.geometry = mesh.geometry;
+			draw.material = mesh.material;
+			draw.render_mode = mesh.render_mode;
+			draw.enabled = meshes.enabled(i);
+			draw.visible = draw.enabled && mesh_visible_[i];
+		}
+	};
+	JobSystem* jobs = ECS.getJobSystem();
+	if (jobs) jobs->parallelForArray(draws.data(), sizeof(DrawItem), draws.size(), DRAW_EXTRACT_GRAIN, fill);
+	else fill(0, draws.size());
+}
+
+//every light, enabled or not, so index i matches light i in the ubo
+void GraphicsSystem::extractLightVolumes_(std::vector<LightVolume>& volumes) {
+	auto& lights = ECS.getAllComponents<Light>();
+	volumes.resize(lights.size());
+	for (size_t i = 0; i < lights.size(); i++) {
+		LightVolume& volume = volumes[i];
+		volume.type = lights[i].type;
+		volume.enabled = ECS.isEnabled<Light>((int)i);
+		volume.position = ECS.getComponentFromEntity<Transform>(lights[i].owner).position();
+		volume.direction = lights[i].direction;
+		volume.radius = lights[i].radius;
+		volume.spot_outer = lights[i].spot_outer;
+	}
+}
+
+/**** RENDERING ****/
 
-	if (needUpdateLights)
-		updateLights_();
+//draws a packet made by extract. Reads no component, only the packet and
+//the resources of the graphics system
+void GraphicsSystem::render(const FramePacket& packet) {
+	if (!packet.valid) return;
+	packet_ = &packet;
+
+	if (packet.lights_changed)
+		uploadLights_(packet.light_uniforms);
     
 	/* SHADOW PASS FOR ALL LIGHTS */
-	glCullFace(GL_FRONT);
-	useShader(depth_shader_);
-	const auto& lights = ECS.getAllComponents<Light>();
-	for (size_t i = 0; i < lights.size(); i++) {
-		shadow_frame_[i].bindAndClear();
-		auto& mesh_components = ECS.getAllComponents<Mesh>();
-		for (auto &curr_comp : mesh_components) {
-			renderDepth_(curr_comp, lights[i]);
+	if (packet.shadows_changed) {
+		glCullFace(GL_FRONT);
+		useShader(depth_shader_);
+		for (const ShadowPass& pass : packet.shadow_passes) {
+			shadow_frame_[pass.shadow_map].bindAndClear();
+			for (const DrawItem& draw : packet.draws)
+				if (draw.enabled) renderDepth_(draw, pass.view_projection);
 		}
+		glCullFace(GL_BACK);
 	}
-	glCullFace(GL_BACK);
 
     /* GBUFFER PASS */
     gbuffer_.bindAndClear(screen_background_color);
     useShader(gbuffer_shader_);
-    for (auto &mesh : ECS.getAllComponents<Mesh>()) {
-        if (mesh.render_mode != RenderModeDeferred)
+    for (const DrawItem& draw : packet.draws) {
+        if (draw.render_mode != RenderModeDeferred || !draw.visible)
             continue;
-        checkMaterial_(mesh);
-        renderMeshComponent_(mesh);
+        checkMaterial_(draw.material);
+        renderMeshComponent_(draw);
     }
     
 	/* SCREEN BUFFER */
@@ -117,11 +223,11 @@ void GraphicsSystem::update(float dt) {
     renderLightVolumes();
     
     /* FORWARD RENDERING */
-    for (auto &mesh : ECS.getAllComponents<Mesh>()) {
-        if (mesh.render_mode != RenderModeForward)
+    for (const DrawItem& draw : packet.draws) {
+        if (draw.render_mode != RenderModeForward || !draw.visible)
             continue;
-        checkShaderAndMaterial_(mesh);
-        renderMeshComponent_(mesh);
+        checkShaderAndMaterial_(draw.material);
+        renderMeshComponent_(draw);
     }
     
     /* ENVIRONMENT */
@@ -129,7 +235,8 @@ void GraphicsSystem::update(float dt) {
     
 	/* VIEW FRAMES */
     //previewTextureViewport(gbuffer_.color_textures[2]);
-    
+
+	packet_ = nullptr;
 }
 
 void GraphicsSystem::previewTextureViewport(GLuint texture_id) {
@@ -148,7 +255,7 @@ void GraphicsSystem::renderLightVolumes() {
     useShader(deferred_volume_shader_);
     
     //set uniforms common for all light passes
-    auto lights = ECS.getAllComponents<Light>();
+    const std::vector<LightVolume>& lights = packet_->lights;
     for (size_t i = 0; i < lights.size(); i++) {
         //this static cast assumes shadowmap enums are consecutive
         UniformID new_enum = static_cast<UniformID>((int)U_SHADOW_MAP0 + (int)i);
@@ -158,15 +265,15 @@ void GraphicsSystem::renderLightVolumes() {
     shader_->setTexture(U_TEX_POSITION, gbuffer_.color_textures[0], 8);
     shader_->setTexture(U_TEX_NORMAL, gbuffer_.color_textures[1], 9);
     shader_->setTexture(U_TEX_ALBEDO, gbuffer_.color_textures[2], 10);
-    shader_->setUniform(U_CAM_POS, ECS.getComponentInArray<Camera>(Game::instance->camera_system_.GetOutputCamera()).position);
+    shader_->setUniform(U_CAM_POS, packet_->camera_position);
     
     glBlendFunc(GL_ONE, GL_ONE);
     glEnable(GL_BLEND);
     glDepthMask(GL_FALSE);
 
-    //render directional 
+    //render directional, skipping inactive lights
     for (size_t i = 0; i < lights.size(); i++) {
-        if (lights[i].type == 0) {
+        if (lights[i].type == 0 && lights[i].enabled) {
             //set light id
             shader_->setUniform(U_LIGHT_ID,(int)i);
             //mvp is simple identity pass through
@@ -178,12 +285,12 @@ void GraphicsSystem::renderLightVolumes() {
     }
     
     for (size_t i = 0; i < lights.size(); i++) {
-        if (lights[i].type == 2) {
+        if (lights[i].type == 2 && lights[i].enabled) {
             //set light id
             shader_->setUniform(U_LIGHT_ID,(int)i);
             
             //set u_mvp
-            lm::vec3 light_pos = ECS.getComponentFromEntity<Transform>(lights[i].owner).position();
+            lm::vec3 light_pos = lights[i].position;
             lm::mat4 model;
             
             float cone_width_scale =
@@ -192,7 +299,8 @@ void GraphicsSystem::renderLightVolumes() {
             
             model.scale(cone_width_scale, lights[i].radius, cone_width_scale);
            
-            lm::vec3 minus = lights[i].forward.normalize();
+            lm::vec3 minus = lights[i].direction;
+            minus.normalize();
             
             float angle = minus.dot(lm::vec3(0,1,0));
             lm::vec3 axis = lm::vec3(0,1,0).cross(minus);
@@ -202,8 +310,7 @@ void GraphicsSystem::renderLightVolumes() {
             model = rotate_matrix * model;
             model.translate(light_pos);
             
-            lm::mat4 view_projection = ECS.getComponentInArray<Camera>(Game::instance->camera_system_.GetOutputCamera()).view_projection;
-            lm::mat4 mvp = view_projection * model;
+            lm::mat4 mvp = packet_->view_projection * model;
             shader_->setUniform(U_MVP, mvp);
             //draw
             glCullFace(GL_FRONT);
@@ -214,18 +321,17 @@ void GraphicsSystem::renderLightVolumes() {
     
     //now render point lights
     for (size_t i = 0; i < lights.size(); i++) {
-        if (lights[i].type != 1)
+        if (lights[i].type != 1 || !lights[i].enabled)
             continue;
         //set light id
         shader_->setUniform(U_LIGHT_ID,(int)i);
         
         //set u_mvp
-        lm::vec3 light_pos = ECS.getComponentFromEntity<Transform>(lights[i].owner).position();
+        lm::vec3 light_pos = lights[i].position;
         lm::mat4 model;
         model.scale(lights[i].radius, lights[i].radius, lights[i].radius);
         model.translate(light_pos);
-        lm::mat4 view_projection = ECS.getComponentInArray<Camera>(Game::instance->camera_system_.GetOutputCamera()).view_projection;
-        lm::mat4 mvp = view_projection * model;
+        lm::mat4 mvp = packet_->view_projection * model;
         shader_->setUniform(U_MVP, mvp);
         
         //draw
@@ -247,7 +353,7 @@ void GraphicsSystem::renderGbuffer() {
     //activate shader
     useShader(deferred_shader_);
     
-    auto lights = ECS.getAllComponents<Light>();
+    const std::vector<LightVolume>& lights = packet_->lights;
     for (size_t i = 0; i < lights.size(); i++) {
         //this static cast assumes shadowmap enums are consecutive
         UniformID new_enum = static_cast<UniformID>((int)U_SHADOW_MAP0 + (int)i);
@@ -256,14 +362,13 @@ void GraphicsSystem::renderGbuffer() {
     
     //set light uniforms
     shader_->setUniformBlock(U_LIGHTS_UBO, LIGHTS_BINDING_POINT);
-    shader_->setUniform(U_NUM_LIGHTS,
-                                 (int)ECS.getAllComponents<Light>().size());
+    shader_->setUniform(U_NUM_LIGHTS, (int)lights.size());
     
     //gbuffer textures
     shader_->setTexture(U_TEX_POSITION, gbuffer_.color_textures[0], 8);
     shader_->setTexture(U_TEX_NORMAL, gbuffer_.color_textures[1], 9);
     shader_->setTexture(U_TEX_ALBEDO, gbuffer_.color_textures[2], 10);
-    shader_->setUniform(U_CAM_POS, ECS.getComponentInArray<Camera>(Game::instance->camera_system_.GetOutputCamera()).position);
+    shader_->setUniform(U_CAM_POS, packet_->camera_position);
     
     //draw
     geometries_[screen_space_geom_].render();
@@ -274,47 +379,71 @@ void GraphicsSystem::renderGbuffer() {
     glBlitFramebuffer(0, 0, viewport_width_, viewport_height_, 0, 0, viewport_width_, viewport_height_, GL_DEPTH_BUFFER_BIT, GL_NEAREST);
 }
 
-//renders a mesh from a Light/Camera, only setting its MVP
+//renders a mesh from a light, only setting its MVP
 //i.e. only usable with a depth shader
-void GraphicsSystem::renderDepth_(Mesh& comp, const Light& light) {
-	//get transform and matrices
-	Transform& transform = ECS.getComponentFromEntity<Transform>(comp.owner);
-	lm::mat4 model_matrix = transform.getGlobalMatrix(ECS.getAllComponents<Transform>());
-	lm::mat4 mvp_matrix = light.view_projection * model_matrix;
+void GraphicsSystem::renderDepth_(const DrawItem& draw, const lm::mat4& light_view_projection) {
+	lm::mat4 mvp_matrix = light_view_projection * draw.world;
 	//set sole uniform
 	depth_shader_->setUniform(U_MVP, mvp_matrix);
 	//render
-	geometries_[comp.geometry].render();
+	geometries_[draw.geometry].render();
 
 }
 
-//renders a given mesh component
-void GraphicsSystem::renderMeshComponent_(Mesh& comp) {
+//transforms the box of every mesh to world space and tests it against the
+//frustum, eight meshes at a time (see lm::batch). Only the box around the
+//transformed box is tested, so a few meshes just outside the frustum pass
+void GraphicsSystem::cullMeshes_(const lm::mat4& view_projection) {
+	auto meshes = ECS.view<Mesh, Transform>();
+	const size_t num = meshes.size();
+	mesh_visible_.assign(num, 1);
+	const TransformSystem& transform_system = Game::instance->transform_system_;
+	if (num == 0 || transform_system.numRendered() == 0)
+		return;
 
-	//get components and geom
-	Transform& transform = ECS.getComponentFromEntity<Transform>(comp.owner);
-	Camera& cam = ECS.getComponentInArray<Camera>(Game::instance->camera_system_.GetOutputCamera());
-	Geometry& geom = geometries_[comp.geometry];
+	//a transform created since the last update has no world matrix yet, so its
+	//mesh is drawn. Its box uses any valid matrix, and its result is ignored.
+	//Every row is gathered, active or not, so no stale matrix index remains
+	JobSystem* jobs = ECS.getJobSystem();
+	PerThread<std::vector<size_t>> uncached(jobs);
+	cull_transform_indices_.resize(num);
+	cull_centers_.resize(num);
+	cull_half_widths_.resize(num);
+	auto gather = [&](size_t begin, size_t end) {
+		std::vector<size_t>& local_uncached = uncached.local();
+		for (size_t i = begin; i < end; i++) {
+			const AABB& aabb = geometries_[meshes.get<Mesh>(i).geometry].aabb;
+			cull_centers_.set(i, aabb.center);
+			cull_half_widths_.set(i, aabb.half_width);
+			const int index = transform_system.cachedIndex(meshes.get<Transform>(i));
+			if (index == -1) local_uncached.push_back(i);
+			cull_transform_indices_[i] = index == -1 ? 0 : index;
+		}
+	};
+	if (jobs) jobs->parallelForArray(cull_centers_.x(), sizeof(float), num, CULL_GRAIN, gather);
+	else gather(0, num);
+
+	lm::batch::transformAABBs(transform_system.renderWorldMatrices(), cull_transform_indices_.data(),
+		cull_centers_, cull_half_widths_, cull_world_centers_, cull_world_half_widths_);
+	lm::batch::cullAABBs(view_projection, cull_world_centers_, cull_world_half_widths_, mesh_visible_.data());
+	uncached.forEach([&](const std::vector<size_t>& rows) {
+		for (size_t i : rows) mesh_visible_[i] = 1;
+	});
+}
 
-	//create mvp
-	lm::mat4 model_matrix = transform.getGlobalMatrix(ECS.getAllComponents<Transform>());
-	lm::mat4 mvp_matrix = cam.view_projection * model_matrix;
+//renders a given mesh component
+void GraphicsSystem::renderMeshComponent_(const DrawItem& draw) {
 
-	//view frustum culling
-	if (!BBInFrustum_(geom.aabb, mvp_matrix)) {
-		return;
-	}
+	Geometry& geom = geometries_[draw.geometry];
 
-	//normal matrix
-	lm::mat4 normal_matrix = model_matrix;
-	normal_matrix.inverse();
-	normal_matrix.transpose();
+	//create mvp, matrices were copied from the transform system by extract
+	lm::mat4 mvp_matrix = packet_->view_projection * draw.world;
 
 	//transform uniforms
 	shader_->setUniform(U_MVP, mvp_matrix);
-	shader_->setUniform(U_MODEL, model_matrix);
-	shader_->setUniform(U_NORMAL_MATRIX, normal_matrix);
-	shader_->setUniform(U_CAM_POS, cam.position);
+	shader_->setUniform(U_MODEL, draw.world);
+	shader_->setUniform(U_NORMAL_MATRIX, draw.normal);
+	shader_->setUniform(U_CAM_POS, packet_->camera_position);
 
     //draw raw geom if no material sets
     if (geom.material_sets.size() == 0)
@@ -340,13 +469,10 @@ void GraphicsSystem::renderEnvironment_() {
     //set shader
     useShader(environment_program_);
     
-    //get camera
-    Camera& cam = ECS.getComponentInArray<Camera>(Game::instance->camera_system_.GetOutputCamera());
-        
     //view projection matrix, zeroing out
-    lm::mat4 view_matrix = cam.view_matrix;
+    lm::mat4 view_matrix = packet_->view_matrix;
     view_matrix.m[12] = view_matrix.m[13] = view_matrix.m[14] = 0; view_matrix.m[15] = 1;
-    lm::mat4 vp_matrix = cam.projection_matrix * view_matrix;
+    lm::mat4 vp_matrix = packet_->projection_matrix * view_matrix;
 
     //set vp uniform and texture
     shader_->setUniform(U_VP, vp_matrix);
@@ -372,22 +498,22 @@ void GraphicsSystem::renderEnvironment_() {
 //checks to see if current shader and material are
 //the ones need for mesh passed as parameter
 //if not, change them
-void GraphicsSystem::checkShaderAndMaterial_(Mesh& mesh) {
+void GraphicsSystem::checkShaderAndMaterial_(int material) {
     //get shader id from material. if same, don't change
-    if (!shader_ || shader_->program != materials_[mesh.material].shader_id) {
-		useShader(materials_[mesh.material].shader_id);
+    if (!shader_ || shader_->program != materials_[material].shader_id) {
+		useShader(materials_[material].shader_id);
     }
     //set material uniforms if required
-    if (current_material_ != mesh.material) {
-        current_material_ = mesh.material;
+    if (current_material_ != material) {
+        current_material_ = material;
         setMaterialUniforms();
     }
 }
 
-void GraphicsSystem::checkMaterial_(Mesh& mesh) {
+void GraphicsSystem::checkMaterial_(int material) {
     //set material uniforms if required
-    if (current_material_ != mesh.material) {
-        current_material_ = mesh.material;
+    if (current_material_ != material) {
+        current_material_ = material;
         setMaterialUniforms();
     }
 }
@@ -444,8 +570,8 @@ void GraphicsSystem::setMaterialUniforms() {
     }
     else shader_->setUniform(U_USE_NOISE_MAP, 0);
 
-	auto lights = ECS.getAllComponents<Light>();
-	for (size_t i = 0; i < lights.size(); i++) {
+	const size_t num_lights = packet_->lights.size();
+	for (size_t i = 0; i < num_lights; i++) {
 
 		glActiveTexture(GL_TEXTURE0 + (GLenum)i);
 		glBindTexture(GL_TEXTURE_2D, shadow_frame_[i].color_textures[0]);
@@ -458,50 +584,71 @@ void GraphicsSystem::setMaterialUniforms() {
     
 	//light uniforms
     shader_->setUniformBlock(U_LIGHTS_UBO, LIGHTS_BINDING_POINT);
-	shader_->setUniform(U_NUM_LIGHTS, (int)lights.size());
+	shader_->setUniform(U_NUM_LIGHTS, (int)num_lights);
 }
 
-//updates light ubo
-void GraphicsSystem::updateLights_() {
-	const std::vector<Light>& lights = ECS.getAllComponents<Light>();
-
-	// 3 * vec4, 4 * float, 1 x matrix, 1 * int, which is blocked out to 16 bytes
-	GLsizeiptr size_lights_ubo = (16 + 16 + 16 + 16 + 16 + 64) * lights.size();
+//packs the lights uniform buffer, in parallel for many lights. See LightUniform
+void GraphicsSystem::packLights_(std::vector<LightUniform>& packed) {
+	auto lights = ECS.view<Light, Transform>();
+	packed.resize(lights.size());
+	const lm::mat4 no_shadow; //identity, for lights without a LightShadow
+
+	//every light is uploaded so ubo index matches light and shadow map index.
+	//Inactive lights are black and cast no shadow, so they add nothing
+	auto pack = [&](size_t begin, size_t end) {
+		for (size_t i = begin; i < end; i++) {
+			Light& l = lights.get<Light>(i);
+			Transform& lt = lights.get<Transform>(i);
+			const bool enabled = lights.enabled(i);
+			const int shadow_id = ECS.getComponentID<LightShadow>(l.owner);
+			const lm::mat4& light_matrix = shadow_id != -1 ? ECS.getComponentInArray<LightShadow>(shadow_id).view_projection : no_shadow;
+			const lm::vec3 color = enabled ? l.color : lm::vec3(0, 0, 0);
+			float spot_inner_cosine = cos((l.spot_inner*DEG2RAD) / 2.0f);
+			float spot_outer_cosine = cos((l.spot_outer*DEG2RAD) / 2.0f);
+
+			const lm::vec3 light_pos = lt.position();
+			LightUniform& u = packed[i];
+			const GLfloat light_data[16] = {
+				light_pos.x, light_pos.y, light_pos.z, 0.0,
+				l.direction.x, l.direction.y, l.direction.z, 0.0,
+				color.x, color.y, color.z, 0.0,
+				l.linear_att,l.quadratic_att,spot_inner_cosine,spot_outer_cosine
+			};
+			memcpy(u.data, light_data, sizeof(u.data));
+			memcpy(u.matrix, light_matrix.m, sizeof(u.matrix));
+			u.type = l.type;
+			u.cast_shadow = shadow_id != -1 && enabled ? l.cast_shadow : 0;
+			u.padding[0] = u.padding[1] = 0;
+		}
+	};
+	JobSystem* jobs = ECS.getJobSystem();
+	if (jobs) jobs->parallelForArray(packed.data(), sizeof(LightUniform), packed.size(), LIGHT_PACK_GRAIN, pack);
+	else pack(0, packed.size());
+}
 
+//uploads every light at once
+void GraphicsSystem::uploadLights_(const std::vector<LightUniform>& packed) {
+	GLsizeiptr size_lights_ubo = sizeof(LightUniform) * packed.size();
 	glBindBuffer(GL_UNIFORM_BUFFER, light_ubo_);
-	glBufferData(GL_UNIFORM_BUFFER, size_lights_ubo, NULL, GL_STATIC_DRAW);
-
-	GLsizeiptr offset = 0; //pointer to top of buffer
-
-	for (auto& l : lights) {
-		Transform& lt = ECS.getComponentFromEntity<Transform>(l.owner);
-
-		float spot_inner_cosine = cos((l.spot_inner*DEG2RAD) / 2.0f);
-		float spot_outer_cosine = cos((l.spot_outer*DEG2RAD) / 2.0f);
-
-		GLfloat light_data[16] = {
-			lt.m[12], lt.m[13], lt.m[14], 0.0,
-			l.direction.x, l.direction.y, l.direction.z, 0.0,
-			l.color.x, l.color.y, l.color.z, 0.0,
-			l.linear_att,l.quadratic_att,spot_inner_cosine,spot_outer_cosine
-		};
-		//vec4s and floats data
-		glBufferSubData(GL_UNIFORM_BUFFER, offset, 64, light_data);
-		offset += 64;
-        //light matrix
-        glBufferSubData(GL_UNIFORM_BUFFER, offset, 64, l.view_projection.m);
-        offset += 64;
-		//type
-		glBufferSubData(GL_UNIFORM_BUFFER, offset, 4, &(l.type));
-		offset += 4;
-        //type
-        glBufferSubData(GL_UNIFORM_BUFFER, offset, 4, &(l.cast_shadow));
-        offset += 12;
-	}
-
+	glBufferData(GL_UNIFORM_BUFFER, size_lights_ubo, packed.data(), GL_STATIC_DRAW);
 	glBindBufferRange(GL_UNIFORM_BUFFER, LIGHTS_BINDING_POINT, light_ubo_, 0, size_lights_ubo);
+}
+
+//true if render matrix of transform at index changed after tick, i.e. it or
+//any of its parents moved, or it is still being interpolated
+bool GraphicsSystem::transformChangedSince_(int transform_index, uint32_t tick) {
+	return Game::instance->transform_system_.renderChangedSince(transform_index, tick);
+}
 
-	needUpdateLights = false;
+//shadow maps must be redrawn if lights changed, meshes were added or removed,
+//or any mesh moved
+bool GraphicsSystem::shadowsChanged_(bool lights_changed) {
+	if (lights_changed || ECS.changedSince<Mesh>(last_tick_))
+		return true;
+	auto meshes = ECS.view<Mesh, Transform>();
+	for (size_t i = 0; i < meshes.size(); i++)
+		if (transformChangedSince_(meshes.index<Transform>(i), last_tick_)) return true;
+	return false;
 }
 
 //This function executes two sorts:
@@ -509,7 +656,10 @@ void GraphicsSystem::updateLights_() {
 // ii) sorts Mesh components by material id
 //the result is that the mesh component array is
 //ordered by both shader and material
-void GraphicsSystem::sortMeshes_() {
+void GraphicsSystem::sortMeshes() {
+
+	//material indices of an extracted packet are out of date
+	packet_stale_ = true;
 
 	//sort materials by shader id
 	//first we store the old index of each material in materials_ array
@@ -535,28 +685,10 @@ void GraphicsSystem::sortMeshes_() {
 		mesh.material = new_index;
 	}
 
-	//store old mesh indices
-	for (size_t i = 0; i < meshes.size(); i++)
-		meshes[i].index = (int)i;
-
-	//short meshes by material id
-	std::sort(meshes.begin(), meshes.end(), [](const Mesh& a, const Mesh& b) {
+	//sort meshes by material id
+	ECS.sortComponents<Mesh>([](const Mesh& a, const Mesh& b) {
 		return a.material < b.material;
 	});
-
-	//clear map and refill with mesh index map
-	old_new.clear();
-	for (size_t i = 0; i < meshes.size(); i++) {
-		old_new[meshes[i].index] = (int)i;
-	}
-
-	//update all entities with new mesh id
-	auto& all_entities = ECS.entities;
-	for (auto& ent : ECS.entities) {
-		int old_index = ent.components[type2int<Mesh>::result];
-		int new_index = old_new[old_index];
-		ent.components[type2int<Mesh>::result] = new_index;
-	}
 }
 
 //reset shader and material
@@ -567,14 +699,13 @@ void GraphicsSystem::resetShaderAndMaterial_() {
 }
 
 //update cameras
-void GraphicsSystem::updateAllCameras_(float dt) {
+//view tracks move cameras in the fixed step, see CameraSystem::updateTracks
+void GraphicsSystem::updateAllCameras_() {
 
+	//only cameras changed since last frame need new matrices
 	auto& cameras = ECS.getAllComponents<Camera>();
-	for (auto &cam : cameras) cam.update();
-
-    // Update all the viewtrack paths
-    auto& tracks = ECS.getAllComponents<ViewTrack>();
-    for (auto &track : tracks) track.update(dt);
+	for (size_t i = 0; i < cameras.size(); i++)
+		if (ECS.getComponentVersion<Camera>((int)i) > last_tick_) cameras[i].update();
 }
 
 void GraphicsSystem::bindAndClearScreen_() {
@@ -652,6 +783,71 @@ int GraphicsSystem::createMaterial() {
 }
 
 
+//create geometry from vertex data already in memory (e.g. parsed on a loader thread)
+//returns index in geometry array with stored geometry data
+int GraphicsSystem::createGeometry(std::vector<float>& vertices, std::vector<float>& uvs, std::vector<float>& normals, std::vector<unsigned int>& indices) {
+    //generate the OpenGL buffers and create geometry
+	Geometry new_geom(vertices, uvs, normals, indices);
+    if (!free_geometries_.empty()) {
+        const int id = free_geometries_.back();
+        free_geometries_.pop_back();
+        geometries_[id] = new_geom;
+        return id;
+    }
+    geometries_.emplace_back(new_geom);
+    return (int)geometries_.size() - 1;
+}
+
+GraphicsSystem::ResourceUse GraphicsSystem::getResourcesInUse(EntityComponentStore& world) {
+    ResourceUse use;
+    for (const Mesh& mesh : world.getAllComponents<Mesh>()) {
+        if (mesh.geometry >= 0 && mesh.geometry < (int)geometries_.size()) use.geometries.insert(mesh.geometry);
+        if (mesh.material >= 0 && mesh.material < (int)materials_.size()) use.materials.insert(mesh.material);
+    }
+    for (int mat_id : use.materials) {
+        const Material& mat = materials_[mat_id];
+        for (int tex : { mat.diffuse_map, mat.diffuse_map_2, mat.diffuse_map_3, mat.cube_map, mat.normal_map, mat.specular_map, mat.noise_map })
+            if (tex > 0) use.textures.insert((GLuint)tex);
+    }
+    if (cube_map_geom_ >= 0) use.geometries.insert(cube_map_geom_);
+    if (environment_tex_ != 0) use.textures.insert(environment_tex_);
+    return use;
+}
+
+//geometry slots are kept for reuse, materials are removed and the meshes of
+//the live ECS renumbered
+void GraphicsSystem::releaseResources(const ResourceUse& previous) {
+    const ResourceUse live = getResourcesInUse(ECS);
+
+    for (int geom_id : previous.geometries) {
+        if (live.geometries.count(geom_id)) continue;
+        geometries_[geom_id].release();
+        free_geometries_.push_back(geom_id);
+    }
+
+    std::vector<GLuint> textures;
+    for (GLuint tex : previous.textures)
+        if (!live.textures.count(tex)) textures.push_back(tex);
+    if (!textures.empty()) glDeleteTextures((GLsizei)textures.size(), textures.data());
+
+    std::vector<int> old_new(materials_.size(), -1);
+    int kept = 0;
+    for (int i = 0; i < (int)materials_.size(); i++) {
+        if (previous.materials.count(i) && !live.materials.count(i)) continue;
+        old_new[i] = kept;
+        if (kept != i) materials_[kept] = std::move(materials_[i]);
+        kept++;
+    }
+    if (kept == (int)materials_.size()) return;
+    materials_.resize(kept);
+    auto remap = [&](int& mat_id) { if (mat_id >= 0 && mat_id < (int)old_new.size()) mat_id = old_new[mat_id]; };
+    for (Mesh& mesh : ECS.getAllComponents<Mesh>()) remap(mesh.material);
+    for (Geometry& geom : geometries_)
+        for (int& mat_id : geom.material_set_ids) remap(mat_id);
+    current_material_ = -1;
+    packet_stale_ = true;
+}
+
 //create geometry from
 //returns index in geometry array with stored geometry data
 int GraphicsSystem::createGeometryFromFile(std::string filename) {
@@ -664,12 +860,7 @@ int GraphicsSystem::createGeometryFromFile(std::string filename) {
     {
         //fill it with data from object
         if (Parsers::parseOBJ(filename, vertices, uvs, normals, indices)) {
-        
-            //generate the OpenGL buffers and create geometry
-			Geometry new_geom(vertices, uvs, normals, indices);
-            geometries_.emplace_back(new_geom);
-
-            return (int)geometries_.size() - 1;
+            return createGeometry(vertices, uvs, normals, indices);
         }
         else {
             std::cerr << "ERROR: Could not parse mesh file" << std::endl;
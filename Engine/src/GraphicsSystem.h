@@ -6,16 +6,31 @@
 #include "Shader.h"
 #include "Components.h"
 #include "GraphicsUtilities.h"
+#include "linmath_batch.h"
+#include "FramePacket.h"
 #include <unordered_map>
+#include <set>
 
 #define MAX_LIGHTS 8
 
+struct EntityComponentStore;
+
 class GraphicsSystem {
 public:
 	~GraphicsSystem();
     void init(int window_width, int window_height, std::string assets);
     void lateInit();
-    void update(float dt);
+
+    //copies what the next frame draws from the ECS into packet. Uses no
+    //OpenGL, so it can run on any thread while render draws another packet
+    void extract(FramePacket& packet);
+    //draws a packet made by extract. OpenGL thread only; reads no component
+    void render(const FramePacket& packet);
+    //true if a packet extracted since the last extract has out of date
+    //material indices (see sortMeshes) and must be extracted again
+    bool isPacketStale() const { return packet_stale_; }
+    //call after the ECS world is swapped (see LevelLoader.h)
+    void onWorldSwapped();
     
 	//viewport
 	void updateMainViewport(int window_width, int window_height);
@@ -33,20 +48,36 @@ public:
 	Material& getMaterial(int mat_id) { return materials_.at(mat_id); }
     std::vector<Material>& getMaterials() { return materials_;}
     
+    //geometries, materials and textures the meshes of a world use, and the
+    //environment
+    struct ResourceUse {
+        std::set<int> geometries, materials;
+        std::set<GLuint> textures;
+    };
+    ResourceUse getResourcesInUse(EntityComponentStore& world);
+    //deletes what previous used and neither the live ECS nor the environment
+    //does. Material indices change, so call sortMeshes after
+    void releaseResources(const ResourceUse& previous);
+
     //geometry
+    int createGeometry(std::vector<float>& vertices, std::vector<float>& uvs, std::vector<float>& normals, std::vector<unsigned int>& indices);
     int createGeometryFromFile(std::string filename);
     int createMultiGeometryFromFile(std::string filename);
     int createTerrainGeometry(int resolution, float step, float max_height, ImageData& height_map);
 
-	//lights update
-	bool needUpdateLights = true;
-    
+	//sorts materials by shader and meshes by material. Call again after
+	//anything else reorders the mesh array (e.g. ECS.defragment). Marks
+	//extracted packets stale
+	void sortMeshes();
+
 private:
     //resources
     std::string assets_folder_;
 	std::unordered_map<GLint, Shader*> shaders_; //compiled id, pointer
     std::vector<Geometry> geometries_;
     std::vector<Material> materials_;
+    //released geometry slots, reused by createGeometry so ids held elsewhere stay valid
+    std::vector<int> free_geometries_;
 
     //viewport
     int viewport_width_, viewport_height_;
@@ -63,11 +94,23 @@ private:
     void setMaterialUniforms();
 
 	//sorting and checking and abstracting
-	void sortMeshes_();
 	void resetShaderAndMaterial_();
-	void updateAllCameras_(float dt);
-	void checkShaderAndMaterial_(Mesh& mesh);
-    void checkMaterial_(Mesh& mesh);
+	void updateAllCameras_();
+
+	//change tracking - see ECS. Tick of last update, and transform check which
+	//includes parents, as moving a parent moves all its children
+	uint32_t last_tick_ = 0;
+	bool transformChangedSince_(int transform_index, uint32_t tick);
+	void checkShaderAndMaterial_(int material);
+    void checkMaterial_(int material);
+
+	//extraction, see extract
+	bool packet_stale_ = true;
+	void extractDraws_(std::vector<DrawItem>& draws);
+	void extractLightVolumes_(std::vector<LightVolume>& volumes);
+	static const size_t DRAW_EXTRACT_GRAIN = 512;
+	//packet being drawn, only set during render
+	const FramePacket* packet_ = nullptr;
 	
 	//binding and clearing
 	void bindAndClearScreen_();
@@ -75,7 +118,8 @@ private:
 	//light uniform buffer object
 	GLuint LIGHTS_BINDING_POINT = 1;
 	GLuint light_ubo_;
-	void updateLights_();
+	void packLights_(std::vector<LightUniform>& packed);
+	void uploadLights_(const std::vector<LightUniform>& packed);
     void setLightUniforms_();
 
 	//framebuffers
@@ -87,7 +131,9 @@ private:
 	Shader* depth_shader_ = nullptr;
 	Shader* screen_depth_shader_ = nullptr;
 	Framebuffer shadow_frame_[MAX_LIGHTS];
-	void renderDepth_(Mesh& comp, const Light& light);
+	void createShadowMaps_();
+	bool shadowsChanged_(bool lights_changed);
+	void renderDepth_(const DrawItem& draw, const lm::mat4& light_view_projection);
     
     //gbuffer
     Shader* gbuffer_shader_ = nullptr;
@@ -105,10 +151,21 @@ private:
     GLuint environment_tex_ = 0;
     
     //rendering
-    void renderMeshComponent_(Mesh& comp);
+    void renderMeshComponent_(const DrawItem& draw);
     void renderEnvironment_();
     void previewTextureViewport(GLuint texture_id);
     
+	//view frustum culling of every mesh at once, before the passes which use
+	//it. mesh_visible_ has one entry per match of ECS.view<Mesh, Transform>()
+	std::vector<uint8_t> mesh_visible_;
+	std::vector<int> cull_transform_indices_;
+	lm::vec3Array cull_centers_, cull_half_widths_;
+	lm::vec3Array cull_world_centers_, cull_world_half_widths_;
+	void cullMeshes_(const lm::mat4& view_projection);
+	//meshes gathered per job when culling, and lights packed per job
+	static const size_t CULL_GRAIN = 1024;
+	static const size_t LIGHT_PACK_GRAIN = 256;
+
 	//AABB
 	void setGeometryAABB_(Geometry& geom, std::vector<GLfloat>& vertices);
 	AABB transformAABB_(const AABB& aabb, const lm::mat4& transform);
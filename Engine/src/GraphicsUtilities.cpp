@@ -1,4 +1,5 @@
 #include "GraphicsUtilities.h"
+#include <algorithm>
 
 // ****** GEOMETRY ***** //
 
@@ -91,6 +92,27 @@ void Geometry::createVertexArrays(std::vector<float>& vertices, std::vector<floa
 	setAABB(vertices);
 }
 
+void Geometry::release() {
+	if (vao == 0) return;
+	//buffer ids are not kept, so ask the vao for them
+	std::vector<GLuint> buffers;
+	glBindVertexArray(vao);
+	for (GLuint attrib = 0; attrib < 4; attrib++) {
+		GLint buffer = 0;
+		glGetVertexAttribiv(attrib, GL_VERTEX_ATTRIB_ARRAY_BUFFER_BINDING, &buffer);
+		if (buffer != 0 && std::find(buffers.begin(), buffers.end(), (GLuint)buffer) == buffers.end())
+			buffers.push_back((GLuint)buffer);
+	}
+	GLint ibo = 0;
+	glGetIntegerv(GL_ELEMENT_ARRAY_BUFFER_BINDING, &ibo);
+	if (ibo != 0) buffers.push_back((GLuint)ibo);
+	glBindVertexArray(0);
+
+	glDeleteBuffers((GLsizei)buffers.size(), buffers.data());
+	glDeleteVertexArrays(1, &vao);
+	*this = Geometry();
+}
+
 int Geometry::createTerrain(int resolution, float step, float the_max_height, ImageData& height_map){
     //set max_height of geometry
     max_terrain_height = the_max_height;
@@ -45,6 +45,8 @@ struct Geometry {
 	
 	//creation functions
 	void createVertexArrays(std::vector<float>& vertices, std::vector<float>& uvs, std::vector<float>& normals, std::vector<unsigned int>& indices);
+	//deletes vao and the buffers bound to it, leaving an empty geometry
+	void release();
 	void setAABB(std::vector<GLfloat>& vertices);
 
 	int createPlaneGeometry();
@@ -0,0 +1,256 @@
+//
+//  JobSystem.cpp
+//
+
+#include "JobSystem.h"
+#include <algorithm>
+
+struct Job {
+    std::function<void()> fn;
+    JobCounter* counter = nullptr;
+};
+
+//job system the calling thread belongs to, and its index there
+static thread_local const JobSystem* thread_system = nullptr;
+static thread_local int thread_index = -1;
+
+//failed searches for a job before an idle thread sleeps
+static const int SPINS_BEFORE_SLEEP = 64;
+
+/**** DEQUE ****/
+
+//memory orders from Le et al., "Correct and efficient work-stealing for weak
+//memory models"
+JobDeque::JobDeque() : jobs_(new std::atomic<Job*>[CAPACITY]) {}
+
+bool JobDeque::push(Job* job) {
+    const int64_t bottom = bottom_.load(std::memory_order_relaxed);
+    const int64_t top = top_.load(std::memory_order_acquire);
+    if (bottom - top >= CAPACITY) return false;
+    jobs_[bottom & (CAPACITY - 1)].store(job, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_release);
+    bottom_.store(bottom + 1, std::memory_order_relaxed);
+    return true;
+}
+
+Job* JobDeque::pop() {
+    const int64_t bottom = bottom_.load(std::memory_order_relaxed) - 1;
+    bottom_.store(bottom, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+    int64_t top = top_.load(std::memory_order_relaxed);
+    if (top > bottom) {
+        //was empty
+        bottom_.store(bottom + 1, std::memory_order_relaxed);
+        return nullptr;
+    }
+    Job* job = jobs_[bottom & (CAPACITY - 1)].load(std::memory_order_relaxed);
+    if (top == bottom) {
+        //last job, race thieves for it
+        if (!top_.compare_exchange_strong(top, top + 1, std::memory_order_seq_cst, std::memory_order_relaxed))
+            job = nullptr;
+        bottom_.store(bottom + 1, std::memory_order_relaxed);
+    }
+    return job;
+}
+
+Job* JobDeque::steal() {
+    int64_t top = top_.load(std::memory_order_acquire);
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+    const int64_t bottom = bottom_.load(std::memory_order_acquire);
+    if (top >= bottom) return nullptr;
+    Job* job = jobs_[top & (CAPACITY - 1)].load(std::memory_order_relaxed);
+    if (!top_.compare_exchange_strong(top, top + 1, std::memory_order_seq_cst, std::memory_order_relaxed))
+        return nullptr;
+    return job;
+}
+
+/**** JOB SYSTEM ****/
+
+JobSystem::JobSystem(int num_threads) {
+    if (num_threads < 1)
+        num_threads = std::max((int)std::thread::hardware_concurrency(), 1);
+    for (int i = 0; i < num_threads; i++)
+        deques_.emplace_back(new JobDeque());
+    thread_system = this;
+    thread_index = 0;
+    for (int i = 1; i < num_threads; i++)
+        threads_.emplace_back(&JobSystem::threadLoop_, this, i);
+}
+
+JobSystem::~JobSystem() {
+    {
+        std::lock_guard<std::mutex> lock(sleep_mutex_);
+        quit_ = true;
+    }
+    wake_.notify_all();
+    for (auto& thread : threads_) thread.join();
+    if (thread_system == this) thread_system = nullptr;
+}
+
+int JobSystem::threadIndex_() const {
+    return thread_system == this ? thread_index : -1;
+}
+
+void JobSystem::run(std::function<void()> fn, JobCounter* counter, JobCounter* after) {
+    Job* job = new Job();
+    job->fn = std::move(fn);
+    job->counter = counter;
+    if (counter) counter->pending_++;
+    if (after) {
+        std::lock_guard<std::mutex> lock(after->mutex_);
+        if (after->pending_ > 0) {
+            after->waiting_.push_back(job);
+            return;
+        }
+    }
+    push_(job);
+}
+
+void JobSystem::push_(Job* job) {
+    const int index = threadIndex_();
+    if (index >= 0) {
+        if (!deques_[index]->push(job)) {
+            //deque full, run it here
+            execute_(job);
+            return;
+        }
+    }
+    else {
+        std::lock_guard<std::mutex> lock(injected_mutex_);
+        injected_.push_back(job);
+        num_injected_++;
+    }
+    queued_++;
+    //a thread going to sleep counts itself before checking queued_, so either
+    //it sees this job or this sees it sleeping
+    if (sleeping_ > 0) {
+        { std::lock_guard<std::mutex> lock(sleep_mutex_); }
+        wake_.notify_one();
+    }
+}
+
+//own deque first, then jobs from outside threads, then steal, starting from
+//the next thread so thieves spread over the deques
+Job* JobSystem::findJob_(int index) {
+    Job* job = nullptr;
+    if (index >= 0) job = deques_[index]->pop();
+    if (!job && num_injected_ > 0) {
+        std::lock_guard<std::mutex> lock(injected_mutex_);
+        if (!injected_.empty()) {
+            job = injected_.front();
+            injected_.pop_front();
+            num_injected_--;
+        }
+    }
+    const int num = (int)deques_.size();
+    for (int i = 1; i <= num && !job; i++) {
+        const int victim = (index + i) % num;
+        if (victim != index) job = deques_[victim]->steal();
+    }
+    if (job) queued_--;
+    return job;
+}
+
+void JobSystem::execute_(Job* job) {
+    job->fn();
+    finish_(job->counter);
+    delete job;
+}
+
+void JobSystem::finish_(JobCounter* counter) {
+    if (!counter) return;
+    std::vector<Job*> released;
+    {
+        std::lock_guard<std::mutex> lock(counter->mutex_);
+        if (--counter->pending_ == 0) released.swap(counter->waiting_);
+    }
+    for (Job* job : released) push_(job);
+}
+
+void JobSystem::wait(JobCounter& counter) {
+    const int index = threadIndex_();
+    while (counter.pending_ > 0) {
+        if (Job* job = findJob_(index)) execute_(job);
+        else std::this_thread::yield();
+    }
+    //the last job may still hold the mutex after setting pending_ to zero
+    std::lock_guard<std::mutex> lock(counter.mutex_);
+}
+
+bool JobSystem::tryRunJob() {
+    Job* job = findJob_(threadIndex_());
+    if (!job) return false;
+    execute_(job);
+    return true;
+}
+
+void JobSystem::threadLoop_(int index) {
+    thread_system = this;
+    thread_index = index;
+    int spins = 0;
+    while (!quit_) {
+        if (Job* job = findJob_(index)) {
+            execute_(job);
+            spins = 0;
+            continue;
+        }
+        if (++spins < SPINS_BEFORE_SLEEP) {
+            std::this_thread::yield();
+            continue;
+        }
+        std::unique_lock<std::mutex> lock(sleep_mutex_);
+        sleeping_++;
+        wake_.wait(lock, [this]() { return quit_ || queued_ > 0; });
+        sleeping_--;
+        spins = 0;
+    }
+}
+
+void JobSystem::parallelFor(size_t count, size_t grain, const std::function<void(size_t, size_t)>& fn) {
+    if (count == 0) return;
+    grain = std::max(grain, (size_t)1);
+    const size_t num_chunks = (count + grain - 1) / grain;
+    if (deques_.size() == 1 || num_chunks == 1) {
+        fn(0, count);
+        return;
+    }
+
+    //first chunk runs here, while the others are stolen
+    JobCounter counter;
+    for (size_t chunk = 1; chunk < num_chunks; chunk++) {
+        const size_t begin = chunk * grain;
+        const size_t end = std::min(begin + grain, count);
+        run([&fn, begin, end]() { fn(begin, end); }, &counter);
+    }
+    fn(0, std::min(grain, count));
+    wait(counter);
+}
+
+void JobSystem::parallelForArray(const void* data, size_t element_size, size_t count, size_t grain,
+                                 const std::function<void(size_t, size_t)>& fn) {
+    if (count == 0) return;
+    const size_t chunk_size = (std::max(grain, (size_t)1) + 63) / 64 * 64;
+
+    //first element which starts a cache line, if any of the first 64 does
+    size_t first = 0;
+    if (data) {
+        const uintptr_t address = (uintptr_t)data;
+        for (size_t i = 0; i < 64 && i < count; i++) {
+            if ((address + i * element_size) % 64 == 0) { first = i; break; }
+        }
+    }
+
+    //chunk c is [first + c * chunk_size, first + (c + 1) * chunk_size), with
+    //the first chunk also taking the elements before first
+    const size_t num_chunks = count <= first + chunk_size ? 1 : 1 + (count - first - 1) / chunk_size;
+    if (num_chunks == 1) {
+        fn(0, count);
+        return;
+    }
+    parallelFor(num_chunks, 1, [&](size_t chunk_begin, size_t chunk_end) {
+        for (size_t c = chunk_begin; c < chunk_end; c++) {
+            const size_t begin = c == 0 ? 0 : first + c * chunk_size;
+            fn(begin, std::min(first + (c + 1) * chunk_size, count));
+        }
+    });
+}
@@ -0,0 +1,164 @@
+//
+//  JobSystem.h
+//
+//  Runs small jobs on one thread per core. Each thread keeps its own deque of
+//  jobs (Chase and Lev, "Dynamic circular work-stealing deque"): it pushes and
+//  pops at the bottom without locking, and threads with nothing to do steal
+//  from the top of another thread's deque. The thread which creates the job
+//  system is thread 0 and runs jobs whenever it waits.
+//  A JobCounter counts unfinished jobs. Waiting on a counter runs other jobs
+//  until it reaches zero, so a job may wait on jobs it started without tying
+//  up its thread, and a job can be held back until another counter is done.
+//  Usage:
+//      JobCounter loaded;
+//      jobs.run([&]() { decode(a); }, &loaded);
+//      jobs.run([&]() { decode(b); }, &loaded);
+//      jobs.run([&]() { upload(a, b); }, nullptr, &loaded); //after both
+//      jobs.parallelFor(count, 256, [&](size_t begin, size_t end) {
+//          for (size_t i = begin; i < end; i++) ...
+//      });
+//      jobs.wait(loaded);
+//
+#pragma once
+#include <vector>
+#include <deque>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <atomic>
+#include <functional>
+#include <memory>
+#include <cstdint>
+
+struct Job;
+
+//number of unfinished jobs started with it. Must outlive those jobs, and any
+//jobs held back until it is done
+class JobCounter {
+public:
+    JobCounter() {}
+    JobCounter(const JobCounter&) = delete;
+    JobCounter& operator=(const JobCounter&) = delete;
+
+    int pending() const { return pending_.load(); }
+
+private:
+    friend class JobSystem;
+    std::atomic<int> pending_{ 0 };
+    //a job decrements pending_ under mutex_, so a waiter which then takes
+    //mutex_ knows the job no longer touches the counter
+    std::mutex mutex_;
+    //jobs held back until pending_ reaches zero
+    std::vector<Job*> waiting_;
+};
+
+//deque of one thread's jobs. Only the owner pushes and pops, any thread
+//steals. Fixed capacity: push fails when full, and the caller runs the job
+class JobDeque {
+public:
+    static const int64_t CAPACITY = 4096;
+    JobDeque();
+
+    bool push(Job* job);
+    Job* pop();
+    Job* steal();
+
+private:
+    std::unique_ptr<std::atomic<Job*>[]> jobs_;
+    std::atomic<int64_t> top_{ 0 };
+    //so thieves (top_) and owner (bottom_) do not share a cache line
+    char padding_[64];
+    std::atomic<int64_t> bottom_{ 0 };
+};
+
+class JobSystem {
+public:
+    //num_threads < 1 uses one thread per core, including the calling thread
+    explicit JobSystem(int num_threads = 0);
+    ~JobSystem();
+
+    //threads which run jobs, including the thread which created the system
+    int getNumThreads() const { return (int)deques_.size(); }
+
+    //runs fn on any thread. counter, if given, counts the job until it
+    //finishes. If after is given, the job starts once after reaches zero
+    void run(std::function<void()> fn, JobCounter* counter = nullptr, JobCounter* after = nullptr);
+
+    //runs jobs (from any deque) until counter reaches zero
+    void wait(JobCounter& counter);
+
+    //runs one job if any is queued, for threads which poll for other work
+    //between jobs. Returns false if there was none
+    bool tryRunJob();
+
+    //index of calling thread, 0 to getNumThreads() - 1, or -1 if it is not
+    //one of the job system's threads
+    int getThreadIndex() const { return threadIndex_(); }
+
+    //calls fn(begin, end) for chunks of grain indices covering [0, count), one
+    //job per chunk, and returns once all are done. Chunks run concurrently, so
+    //fn must only write data owned by its range
+    void parallelFor(size_t count, size_t grain, const std::function<void(size_t, size_t)>& fn);
+
+    //parallelFor over the elements of an array, in chunks of a multiple of
+    //64 elements. Chunks after the first start on a cache line where the
+    //array's alignment allows it, so two threads never write the same line.
+    //data may be null, for index ranges (e.g. view rows) which only need the
+    //multiple of 64
+    void parallelForArray(const void* data, size_t element_size, size_t count, size_t grain,
+                          const std::function<void(size_t, size_t)>& fn);
+
+private:
+    std::vector<std::unique_ptr<JobDeque>> deques_;
+    std::vector<std::thread> threads_;
+
+    //jobs pushed by threads which are not part of the job system
+    std::mutex injected_mutex_;
+    std::deque<Job*> injected_;
+    std::atomic<int> num_injected_{ 0 };
+
+    //idle threads sleep until a job is pushed. queued_ counts jobs pushed and
+    //not yet taken by a thread
+    std::atomic<int> queued_{ 0 };
+    std::atomic<int> sleeping_{ 0 };
+    std::mutex sleep_mutex_;
+    std::condition_variable wake_;
+    std::atomic<bool> quit_{ false };
+
+    //index of calling thread in deques_, or -1 if it is not one of ours
+    int threadIndex_() const;
+    void threadLoop_(int index);
+    void push_(Job* job);
+    Job* findJob_(int index);
+    void execute_(Job* job);
+    void finish_(JobCounter* counter);
+};
+
+//one value per thread of a job system, padded apart so jobs can accumulate
+//(counts, sums, lists) without atomics or sharing cache lines. Threads outside
+//the job system (or every thread, if jobs is null) share one value
+//  Usage:
+//      PerThread<int> visible(jobs, 0);
+//      jobs->parallelFor(n, 256, [&](size_t begin, size_t end) { visible.local() += ...; });
+//      int total = 0; visible.forEach([&](int v) { total += v; });
+template<typename T>
+class PerThread {
+public:
+    explicit PerThread(const JobSystem* jobs, const T& value = T()) :
+        jobs_(jobs), slots_(jobs ? jobs->getNumThreads() + 1 : 1) {
+        for (Slot& slot : slots_) slot.value = value;
+    }
+
+    T& local() { return slots_[jobs_ ? jobs_->getThreadIndex() + 1 : 0].value; }
+
+    template<typename F>
+    void forEach(F fn) { for (Slot& slot : slots_) fn(slot.value); }
+
+private:
+    struct Slot {
+        T value;
+        char padding[64];
+    };
+    const JobSystem* jobs_;
+    std::vector<Slot> slots_;
+};
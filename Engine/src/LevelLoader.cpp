@@ -0,0 +1,54 @@
+//
+//  LevelLoader.cpp
+//
+
+#include "LevelLoader.h"
+#include "extern.h"
+
+LevelLoader::~LevelLoader() {
+    if (thread_.joinable()) thread_.join();
+}
+
+bool LevelLoader::start(const std::string& filename) {
+    if (thread_.joinable()) return false;
+
+    filename_ = filename;
+    world_.reset(new EntityComponentStore());
+    resources_ = LevelResources();
+    success_ = false;
+    done_ = false;
+
+    thread_ = std::thread([this]() {
+        success_ = Parsers::parseJSONLevel(filename_, *world_, resources_);
+        done_ = true;
+    });
+    return true;
+}
+
+size_t LevelLoader::uploadGeometries(GraphicsSystem& graphics_system, const TimeSlice& slice) {
+    if (!parsed_() || !success_) return 0;
+    size_t left;
+    do left = Parsers::createLevelGeometry(resources_, graphics_system);
+    while (left > 0 && !slice.expired());
+    return left;
+}
+
+bool LevelLoader::finish(GraphicsSystem& graphics_system, ControlSystem& control_system) {
+    if (!ready()) return false;
+    thread_.join();
+
+    const bool success = success_;
+    if (success) {
+        const GraphicsSystem::ResourceUse previous = graphics_system.getResourcesInUse(ECS);
+        Parsers::createLevelResources(resources_, *world_, graphics_system, control_system);
+        ECS.swap(*world_);
+        graphics_system.releaseResources(previous);
+    }
+    else
+        std::cerr << "ERROR: Could not load level " << filename_ << std::endl;
+
+    //world_ now holds the previous level
+    world_.reset();
+    resources_ = LevelResources();
+    return success;
+}
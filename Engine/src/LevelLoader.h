@@ -0,0 +1,62 @@
+//
+//  LevelLoader.h
+//
+//  Loads a level file into a second EntityComponentStore on a background thread,
+//  so the game keeps running while the file and its meshes are parsed. Once
+//  ready(), the main thread calls finish() between frames, which creates the
+//  OpenGL resources (only the main thread has the context) and swaps the new
+//  world with the live ECS, so the level changes from one frame to the next.
+//  Geometries, the bulk of the uploads, can be created ahead a few per frame by
+//  uploadGeometries, as a TimeSlicedScheduler workload; ready() waits for them.
+//  Usage:
+//      level_loader.start("data/assets/level2.json");
+//      //every frame, under a time budget, on the main thread:
+//      level_loader.uploadGeometries(graphics_system, slice);
+//      //every frame, at a sync point:
+//      if (level_loader.ready()) level_loader.finish(graphics_system, control_system);
+//
+#pragma once
+#include "Parsers.h"
+#include "EntityComponentStore.h"
+#include "TimeSlicedScheduler.h"
+#include <thread>
+#include <atomic>
+#include <memory>
+#include <string>
+
+class LevelLoader {
+public:
+    //waits for a running load to finish, discarding its world
+    ~LevelLoader();
+
+    //starts loading filename on a loader thread. Returns false if a load is
+    //already running or waiting for finish()
+    bool start(const std::string& filename);
+    //true if the loader thread is done, every geometry is uploaded (or the
+    //level failed to parse) and finish() can be called
+    bool ready() const { return parsed_() && (!success_ || resources_.geometry_ids.size() == resources_.geometries.size()); }
+    bool loading() const { return thread_.joinable(); }
+
+    //creates geometries of the parsed level until slice expires. Returns how
+    //many are left, 0 if no level is waiting. Main thread only
+    size_t uploadGeometries(GraphicsSystem& graphics_system, const TimeSlice& slice);
+
+    //creates resources of the loaded level and swaps its world into ECS. The
+    //previous world is destroyed, with the geometries, materials and textures
+    //only it used. Returns false, leaving ECS untouched, if the
+    //level could not be parsed. Main thread only
+    bool finish(GraphicsSystem& graphics_system, ControlSystem& control_system);
+
+private:
+    std::thread thread_;
+    //loader thread is done, so success_, world_ and resources_ belong to the
+    //main thread again
+    bool parsed_() const { return thread_.joinable() && done_; }
+    std::atomic<bool> done_{ false };
+    bool success_ = false;
+    std::string filename_;
+
+    //written only by the loader thread until done_ is set
+    std::unique_ptr<EntityComponentStore> world_;
+    LevelResources resources_;
+};
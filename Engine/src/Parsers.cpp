@@ -570,6 +570,13 @@ GLuint Parsers::parseCubemap(std::vector<std::string>& faces) {
 
 bool Parsers::parseJSONLevel(std::string filename,
                              GraphicsSystem& graphics_system, ControlSystem& control_system) {
+    LevelResources resources;
+    if (!parseJSONLevel(filename, ECS, resources)) return false;
+    createLevelResources(resources, ECS, graphics_system, control_system);
+    return true;
+}
+
+bool Parsers::parseJSONLevel(std::string filename, EntityComponentStore& world, LevelResources& resources) {
     //read json file and stream it into a rapidjson document
     //see http://rapidjson.org/md_doc_stream.html
     std::ifstream json_file(filename);
@@ -592,35 +599,33 @@ bool Parsers::parseJSONLevel(std::string filename,
     
     std::string data_dir = json["directory"].GetString();
     
-    //dictionaries
+    //dictionaries: name -> index in resources
     std::unordered_map<std::string, int> geometries;
-    std::unordered_map<std::string, GLuint> textures;
     std::unordered_map<std::string, int> materials;
-    std::unordered_map<std::string, int> shaders;
     std::unordered_map<std::string, std::string> child_parent;
     
-    //geometries
+    //geometries - parsed here, OpenGL buffers are created by createLevelResources
     for (rapidjson::SizeType i = 0; i < json["geometries"].Size(); i++) {
         //get values from json
         std::string name = json["geometries"][i]["name"].GetString();
         std::string file = json["geometries"][i]["file"].GetString();
         //load geometry
-        int geom_id = graphics_system.createGeometryFromFile(data_dir + file);
+        LevelResources::GeometryData geom;
+        if (!parseOBJ(data_dir + file, geom.vertices, geom.uvs, geom.normals, geom.indices))
+            std::cerr << "ERROR: Could not parse mesh file" << std::endl;
+        resources.geometries.push_back(std::move(geom));
         //add to dictionary
-        geometries[name] = geom_id;
+        geometries[name] = (int)resources.geometries.size() - 1;
     }
     
     //shaders
     for (rapidjson::SizeType i = 0; i < json["shaders"].Size(); i++) {
         //get values from json
-        std::string name = json["shaders"][i]["name"].GetString();
-        std::string vertex = json["shaders"][i]["vertex"].GetString();
-        std::string fragment = json["shaders"][i]["fragment"].GetString();
-        //load shader
-        Shader* new_shader = graphics_system.loadShader(vertex, fragment);
-        new_shader->name = name;
-        shaders[name] = new_shader->program;
-        
+        LevelResources::ShaderData shader;
+        shader.name = json["shaders"][i]["name"].GetString();
+        shader.vertex = json["shaders"][i]["vertex"].GetString();
+        shader.fragment = json["shaders"][i]["fragment"].GetString();
+        resources.shaders.push_back(shader);
     }
     
     //cameras
@@ -631,25 +636,25 @@ bool Parsers::parseJSONLevel(std::string filename,
 			const std::string movement = json["cameras"][i]["movement"].GetString();
 			auto& jp = json["cameras"][i]["position"];
 			auto& jd = json["cameras"][i]["direction"];
-			const float fov = json["cameras"][i]["fov"].GetFloat();
-			const float near = json["cameras"][i]["near"].GetFloat();
-			const float far = json["cameras"][i]["far"].GetFloat();
 
-			int vp_w, vp_h; //get viewport dims from graphics system
-			graphics_system.getMainViewport(vp_w, vp_h);
+			//projection is set by createLevelResources, which knows the viewport
+			LevelResources::CameraData cam_data;
+			cam_data.fov = json["cameras"][i]["fov"].GetFloat();
+			cam_data.z_near = json["cameras"][i]["near"].GetFloat();
+			cam_data.z_far = json["cameras"][i]["far"].GetFloat();
 
 			//if (movement == "free") {
-			int ent_player = ECS.createEntity(name);
-			Camera& player_cam = ECS.createComponentForEntity<Camera>(ent_player);
+			int ent_player = world.createEntity(name);
+			Camera& player_cam = world.createComponentForEntity<Camera>(ent_player);
 			lm::vec3 the_position(jp[0].GetFloat(), jp[1].GetFloat(), jp[2].GetFloat());
-			ECS.getComponentFromEntity<Transform>(ent_player).translate(the_position);
+			world.getComponentFromEntity<Transform>(ent_player).translate(the_position);
 			player_cam.position = the_position;
 			player_cam.forward = lm::vec3(jd[0].GetFloat(), jd[1].GetFloat(), jd[2].GetFloat());
 
 			if (json["cameras"][i].HasMember("objective")) {
 				std::string objective = json["cameras"][i]["objective"].GetString();
-				int entityID = ECS.getEntity(objective);
-				lm::vec3 target = ECS.getComponentFromEntity<Transform>(entityID).position();
+				int entityID = world.getEntity(objective);
+				lm::vec3 target = world.getComponentFromEntity<Transform>(entityID).position();
 				player_cam.forward = (target - the_position).normalize();
 				player_cam.target = target;
 			}
@@ -663,14 +668,14 @@ bool Parsers::parseJSONLevel(std::string filename,
 				}
 			}
 
-			player_cam.setPerspective(fov*DEG2RAD, (float)vp_w / (float)vp_h, near, far);
-			ECS.main_camera = ECS.getComponentID<Camera>(ent_player);
-			control_system.control_type = ControlTypeFree;
+			world.main_camera = world.getComponentID<Camera>(ent_player);
+			cam_data.entity = ent_player;
+			resources.cameras.push_back(cam_data);
 			
             if (json["cameras"][i].HasMember("track"))
             {
                 auto& tspeed = json["cameras"][i]["track"]["speed"];
-                ViewTrack& cam_track = ECS.createComponentForEntity<ViewTrack>(ent_player);
+                ViewTrack& cam_track = world.createComponentForEntity<ViewTrack>(ent_player);
 
                 for (rapidjson::SizeType j = 0; j < json["cameras"][i]["track"]["knots"].Size(); j++) {
                     auto& jknots = json["cameras"][i]["track"]["knots"][j];
@@ -687,40 +692,28 @@ bool Parsers::parseJSONLevel(std::string filename,
     //textures
     for (rapidjson::SizeType i = 0; i < json["textures"].Size(); i++) {
         //get values from json
-        std::string name = json["textures"][i]["name"].GetString();
-        
-        //predeclare id
-        GLuint tex_id = 0;
+        LevelResources::TextureData texture;
+        texture.name = json["textures"][i]["name"].GetString();
         
         //check if its an environment
         if (json["textures"][i].HasMember("files")) {
-            std::vector<std::string> cube_faces{
-                data_dir + json["textures"][i]["files"][0].GetString(),
-                data_dir + json["textures"][i]["files"][1].GetString(),
-                data_dir + json["textures"][i]["files"][2].GetString(),
-                data_dir + json["textures"][i]["files"][3].GetString(),
-                data_dir + json["textures"][i]["files"][4].GetString(),
-                data_dir + json["textures"][i]["files"][5].GetString()
-            };
-            tex_id = parseCubemap(cube_faces);
+            for (rapidjson::SizeType f = 0; f < 6; f++)
+                texture.files.push_back(data_dir + json["textures"][i]["files"][f].GetString());
         }
         else {
             //else it's a regular texture
-            std::string file = json["textures"][i]["file"].GetString();
-            //load texture
-            tex_id = parseTexture(data_dir + file);
+            texture.files.push_back(data_dir + json["textures"][i]["file"].GetString());
         }
-        //add to dictionary
-        textures[name] = tex_id;
+        resources.textures.push_back(texture);
     }
     
     //environment
     if (json.HasMember("environment")) {
         //get values from json
-        std::string texture = json["environment"]["texture"].GetString();
-        std::string geometry = json["environment"]["geometry"].GetString();
-        std::string shader = json["environment"]["shader"].GetString();
-        graphics_system.setEnvironment(textures[texture], geometries[geometry], shaders[shader]);
+        resources.has_environment = true;
+        resources.environment_texture = json["environment"]["texture"].GetString();
+        resources.environment_geometry = geometries[json["environment"]["geometry"].GetString()];
+        resources.environment_shader = json["environment"]["shader"].GetString();
     }
     
     //materials
@@ -728,53 +721,49 @@ bool Parsers::parseJSONLevel(std::string filename,
         //get values from json
         std::string name = json["materials"][i]["name"].GetString();
         
-        //create material
-        int mat_id = graphics_system.createMaterial();
+        LevelResources::MaterialData mat;
         
-        //shader_id is mandatory
-        graphics_system.getMaterial(mat_id).shader_id = shaders[json["materials"][i]["shader"].GetString()];
+        //shader is mandatory
+        mat.shader = json["materials"][i]["shader"].GetString();
         
         //optional properties
         
         //diffuse texture
-        if (json["materials"][i].HasMember("diffuse_map")) {
-            std::string diffuse = json["materials"][i]["diffuse_map"].GetString();
-            graphics_system.getMaterial(mat_id).diffuse_map = textures[diffuse]; //assign texture id from material
-        }
+        if (json["materials"][i].HasMember("diffuse_map"))
+            mat.diffuse_map = json["materials"][i]["diffuse_map"].GetString();
         
         //diffuse
         if (json["materials"][i].HasMember("diffuse")) {
             auto& json_spec = json["materials"][i]["diffuse"];
-            graphics_system.getMaterial(mat_id).diffuse = lm::vec3(json_spec[0].GetFloat(), json_spec[1].GetFloat(), json_spec[2].GetFloat());
+            mat.diffuse = lm::vec3(json_spec[0].GetFloat(), json_spec[1].GetFloat(), json_spec[2].GetFloat());
         }
         else
-            graphics_system.getMaterial(mat_id).diffuse = lm::vec3(1, 1, 1); //white diffuse
+            mat.diffuse = lm::vec3(1, 1, 1); //white diffuse
         
         
         //specular
         if (json["materials"][i].HasMember("specular")) {
             auto& json_spec = json["materials"][i]["specular"];
-            graphics_system.getMaterial(mat_id).specular = lm::vec3(json_spec[0].GetFloat(), json_spec[1].GetFloat(), json_spec[2].GetFloat());
+            mat.specular = lm::vec3(json_spec[0].GetFloat(), json_spec[1].GetFloat(), json_spec[2].GetFloat());
         }
         else
-            graphics_system.getMaterial(mat_id).specular = lm::vec3(0, 0, 0); //no specular
+            mat.specular = lm::vec3(0, 0, 0); //no specular
         
         //ambient
         if (json["materials"][i].HasMember("ambient")) {
             auto& json_ambient = json["materials"][i]["ambient"];
-            graphics_system.getMaterial(mat_id).ambient = lm::vec3(json_ambient[0].GetFloat(), json_ambient[1].GetFloat(), json_ambient[2].GetFloat());
+            mat.ambient = lm::vec3(json_ambient[0].GetFloat(), json_ambient[1].GetFloat(), json_ambient[2].GetFloat());
         }
         else
-            graphics_system.getMaterial(mat_id).ambient = lm::vec3(0.1f, 0.1f, 0.1f); //no specular
+            mat.ambient = lm::vec3(0.1f, 0.1f, 0.1f); //no specular
         
         //reflection
-        if (json["materials"][i].HasMember("cube_map")) {
-            std::string cube_map = json["materials"][i]["cube_map"].GetString();
-            graphics_system.getMaterial(mat_id).cube_map = textures[cube_map];
-        }
+        if (json["materials"][i].HasMember("cube_map"))
+            mat.cube_map = json["materials"][i]["cube_map"].GetString();
         
         //add to dictionary
-        materials[name] = mat_id;
+        resources.materials.push_back(mat);
+        materials[name] = (int)resources.materials.size() - 1;
     }
     
 	//lights
@@ -782,10 +771,10 @@ bool Parsers::parseJSONLevel(std::string filename,
 		std::string light_name = json["lights"][i]["name"].GetString();
 		std::string light_type = json["lights"][i]["type"].GetString();
 
-		int ent_light = ECS.createEntity(light_name);
-		ECS.createComponentForEntity<Light>(ent_light);
+		int ent_light = world.createEntity(light_name);
+		world.createComponentForEntity<Light>(ent_light);
 
-		auto& l = ECS.getComponentFromEntity<Light>(ent_light);
+		auto& l = world.getComponentFromEntity<Light>(ent_light);
 
 		//set type
 		if (light_type == "directional") l.type = 0;
@@ -800,7 +789,7 @@ bool Parsers::parseJSONLevel(std::string filename,
 		//transform
 		if (json["lights"][i].HasMember("position")) {
 			auto json_lp = json["lights"][i]["position"].GetArray();
-			ECS.getComponentFromEntity<Transform>(ent_light).translate(json_lp[0].GetFloat(), json_lp[1].GetFloat(), json_lp[2].GetFloat());
+			world.getComponentFromEntity<Transform>(ent_light).translate(json_lp[0].GetFloat(), json_lp[1].GetFloat(), json_lp[2].GetFloat());
 		}
 		//direction
 		if (json["lights"][i].HasMember("direction")) {
@@ -840,22 +829,22 @@ bool Parsers::parseJSONLevel(std::string filename,
         auto js = json_ent["transform"]["scale"].GetArray();
         
         //create entity
-        int ent_id = ECS.createEntity(json_name);
-        Mesh& ent_mesh = ECS.createComponentForEntity<Mesh>(ent_id);
+        int ent_id = world.createEntity(json_name);
+        Mesh& ent_mesh = world.createComponentForEntity<Mesh>(ent_id);
+        //indices in resources, linked to graphics system ids by createLevelResources
         ent_mesh.geometry = geometries[json_geometry];
         ent_mesh.material = materials[json_material];
+        resources.mesh_entities.push_back(ent_id);
         
         //transform
-        auto& ent_transform = ECS.getComponentFromEntity<Transform>(ent_id);
+        auto& ent_transform = world.getComponentFromEntity<Transform>(ent_id);
         //rotate
         //get rotation euler angles
         lm::vec3 rotate; rotate.x = jr[0].GetFloat(); rotate.y = jr[1].GetFloat(); rotate.z = jr[2].GetFloat();
         //create quaternion from euler angles
         lm::quat qR(rotate.x*DEG2RAD, rotate.y*DEG2RAD, rotate.z*DEG2RAD);
-        //create matrix which represents these rotations
-        lm::mat4 R; R.makeRotationMatrix(qR);
-        //multiply transform by this matrix
-        ent_transform.set(ent_transform * R);
+        //set it as the transform's rotation
+        ent_transform.rotation(qR);
         
         //scale
         ent_transform.scaleLocal(js[0].GetFloat(), js[1].GetFloat(), js[2].GetFloat());
@@ -873,7 +862,7 @@ bool Parsers::parseJSONLevel(std::string filename,
         if (json_ent.HasMember("collider")) {
             std::string coll_type = json_ent["collider"]["type"].GetString();
             if (coll_type == "Box") {
-                Collider& box_collider = ECS.createComponentForEntity<Collider>(ent_id);
+                Collider& box_collider = world.createComponentForEntity<Collider>(ent_id);
                 box_collider.collider_type = ColliderTypeBox;
                 
                 auto json_col_center = json_ent["collider"]["center"].GetArray();
@@ -890,25 +879,85 @@ bool Parsers::parseJSONLevel(std::string filename,
         }
     }
     
-    //now link hierarchy need to get transform id from parent entity,
-    //and link to transform object from child entity
+    //now link hierarchy. Parents may be stored after their children, the
+    //transform order is restored when the level is defragmented
     for (std::pair<std::string, std::string> relationship : child_parent)
     {
-        //get parent entity
-        int parent_entity_id = ECS.getEntity(relationship.second);
-        Entity& parent = ECS.entities[parent_entity_id];
-        int parent_transform_id = parent.components[0]; //transform component is always in slot 0
-        
-        //get child transform
-        Transform& transform_child = ECS.getComponentFromEntity<Transform>(relationship.first);
-        
-        //link child transform with parent id
-        transform_child.parent = parent_transform_id;
+        int parent_entity_id = world.getEntity(relationship.second);
+        int child_entity_id = world.getEntity(relationship.first);
+        if (parent_entity_id == -1 || child_entity_id == -1) continue;
+        world.setParent(child_entity_id, parent_entity_id);
     }
     
     return true;
 }
 
+void Parsers::createLevelResources(LevelResources& resources, EntityComponentStore& world,
+                                   GraphicsSystem& graphics_system, ControlSystem& control_system) {
+    //geometries, except any created ahead by createLevelGeometry
+    while (createLevelGeometry(resources, graphics_system) > 0) {}
+    const std::vector<int>& geometry_ids = resources.geometry_ids;
+    //resource index -> graphics system id, -1 if the level file named something missing
+    auto idOf = [](const std::vector<int>& ids, int index) { return index >= 0 && index < (int)ids.size() ? ids[index] : -1; };
+    
+    //shaders
+    std::unordered_map<std::string, GLuint> shaders;
+    for (auto& shader : resources.shaders) {
+        Shader* new_shader = graphics_system.loadShader(shader.vertex, shader.fragment);
+        new_shader->name = shader.name;
+        shaders[shader.name] = new_shader->program;
+    }
+    
+    //textures
+    std::unordered_map<std::string, GLuint> textures;
+    for (auto& texture : resources.textures)
+        textures[texture.name] = texture.files.size() == 6 ? parseCubemap(texture.files) : parseTexture(texture.files[0]);
+    
+    //environment
+    if (resources.has_environment)
+        graphics_system.setEnvironment(textures[resources.environment_texture],
+                                       idOf(geometry_ids, resources.environment_geometry),
+                                       shaders[resources.environment_shader]);
+    
+    //materials
+    std::vector<int> material_ids;
+    for (auto& mat : resources.materials) {
+        int mat_id = graphics_system.createMaterial();
+        Material& material = graphics_system.getMaterial(mat_id);
+        material.shader_id = shaders[mat.shader];
+        if (!mat.diffuse_map.empty()) material.diffuse_map = textures[mat.diffuse_map];
+        if (!mat.cube_map.empty()) material.cube_map = textures[mat.cube_map];
+        material.diffuse = mat.diffuse;
+        material.specular = mat.specular;
+        material.ambient = mat.ambient;
+        material_ids.push_back(mat_id);
+    }
+    
+    //link meshes of level to graphics system ids
+    for (int ent_id : resources.mesh_entities) {
+        Mesh& mesh = world.getComponentFromEntity<Mesh>(ent_id);
+        mesh.geometry = idOf(geometry_ids, mesh.geometry);
+        mesh.material = idOf(material_ids, mesh.material);
+    }
+    
+    //cameras
+    int vp_w, vp_h; //get viewport dims from graphics system
+    graphics_system.getMainViewport(vp_w, vp_h);
+    for (auto& cam_data : resources.cameras)
+        world.getComponentFromEntity<Camera>(cam_data.entity).setPerspective(cam_data.fov*DEG2RAD, (float)vp_w / (float)vp_h, cam_data.z_near, cam_data.z_far);
+    if (!resources.cameras.empty())
+        control_system.control_type = ControlTypeFree;
+}
+
+size_t Parsers::createLevelGeometry(LevelResources& resources, GraphicsSystem& graphics_system) {
+    const size_t next = resources.geometry_ids.size();
+    if (next == resources.geometries.size()) return 0;
+    LevelResources::GeometryData& geom = resources.geometries[next];
+    resources.geometry_ids.push_back(geom.vertices.empty() ? -1 : graphics_system.createGeometry(geom.vertices, geom.uvs, geom.normals, geom.indices));
+    geom = LevelResources::GeometryData();
+    return resources.geometries.size() - resources.geometry_ids.size();
+}
+
 bool Parsers::parseAnimation(std::string filename) {
     
     std::string line;
@@ -947,24 +996,17 @@ bool Parsers::parseAnimation(std::string filename) {
                 std::vector<std::string> w;
                 split(line, " ", w);
                 
-                //empty model matrix for frame
-                lm::mat4 new_frame;
-                
-                //make translation matrix
-                lm::mat4 translation;
-                translation.makeTranslationMatrix((float)atof(w[1].c_str()), (float)atof(w[2].c_str()), (float)atof(w[3].c_str()));
+                //pose for frame, kept in parts so frames can be blended
+                AnimationKey new_frame;
                 
-                //make rotation matrix
-                lm::quat qrot((float)atof(w[4].c_str()), (float)atof(w[5].c_str()), (float)atof(w[6].c_str()));
-                lm::mat4 rotation;
-                rotation.makeRotationMatrix(qrot);
+                //translation
+                new_frame.position = lm::vec3((float)atof(w[1].c_str()), (float)atof(w[2].c_str()), (float)atof(w[3].c_str()));
                 
-                //make scale matrix
-                lm::mat4 scale;
-                scale.makeScaleMatrix((float)atof(w[7].c_str()), (float)atof(w[8].c_str()), (float)atof(w[9].c_str()));
+                //rotation from euler angles
+                new_frame.rotation = lm::quat((float)atof(w[4].c_str()), (float)atof(w[5].c_str()), (float)atof(w[6].c_str()));
                 
-                //multiply the lot
-                new_frame = translation * rotation * scale * new_frame;
+                //scale
+                new_frame.scale = lm::vec3((float)atof(w[7].c_str()), (float)atof(w[8].c_str()), (float)atof(w[9].c_str()));
                 
                 //add the keyframe
                 anim.keyframes.push_back(new_frame);
@@ -4,6 +4,49 @@
 #include "GraphicsSystem.h"
 #include "ControlSystem.h"
 
+struct EntityComponentStore;
+
+//everything in a level file which needs the OpenGL context. parseJSONLevel only
+//reads it, so it can run on a loader thread, and createLevelResources creates
+//it later on the main thread. Level meshes store indices into geometries and
+//materials until then
+struct LevelResources {
+    struct GeometryData {
+        std::vector<float> vertices, uvs, normals;
+        std::vector<unsigned int> indices;
+    };
+    struct ShaderData {
+        std::string name, vertex, fragment;
+    };
+    struct TextureData {
+        std::string name;
+        std::vector<std::string> files; //one file, or six cubemap faces
+    };
+    struct MaterialData {
+        std::string shader, diffuse_map, cube_map; //names in level file
+        lm::vec3 diffuse, specular, ambient;
+    };
+    struct CameraData {
+        int entity;
+        float fov, z_near, z_far;
+    };
+
+    std::vector<GeometryData> geometries;
+    std::vector<ShaderData> shaders;
+    std::vector<TextureData> textures;
+    std::vector<MaterialData> materials;
+    std::vector<CameraData> cameras;
+    std::vector<int> mesh_entities;
+
+    bool has_environment = false;
+    std::string environment_texture, environment_shader;
+    int environment_geometry = 0;
+
+    //graphics system ids of the geometries created so far, in order (see
+    //Parsers::createLevelGeometry)
+    std::vector<int> geometry_ids;
+};
+
 struct TGAInfo //stores info about TGA file
 {
 	GLuint width;
@@ -32,8 +75,25 @@ public:
                                ImageData* image_data = nullptr,
                                bool keep_data = false);
     static GLuint parseCubemap(std::vector<std::string>& faces);
+    //loads level file into the live ECS
     static bool parseJSONLevel(std::string filename,
                                GraphicsSystem& graphics_system,
                                ControlSystem& control_system);
+    //loads entities of level file into world, and reads its resources without
+    //touching OpenGL. Safe to call on a loader thread (see LevelLoader.h)
+    static bool parseJSONLevel(std::string filename,
+                               EntityComponentStore& world,
+                               LevelResources& resources);
+    //creates resources read by parseJSONLevel and links the meshes and cameras
+    //of world to them. Main thread only
+    static void createLevelResources(LevelResources& resources,
+                                     EntityComponentStore& world,
+                                     GraphicsSystem& graphics_system,
+                                     ControlSystem& control_system);
+    //creates the next geometry of resources not created yet and frees its
+    //vertex data, so a level can be uploaded over several frames. Returns how
+    //many are left. Main thread only
+    static size_t createLevelGeometry(LevelResources& resources,
+                                      GraphicsSystem& graphics_system);
     static bool parseAnimation(std::string filename);
 };
@@ -0,0 +1,64 @@
+//
+//  Prefab.h
+//
+//  Template for spawning many copies of an entity (and its children) at once
+//  with ECS.instantiate(). Each node of the prefab becomes one entity, with a
+//  copy of the node's components and a Transform relative to its parent node.
+//  Usage:
+//      Prefab bullet;
+//      int root = bullet.addNode("bullet");
+//      bullet.add<Mesh>(root) = bullet_mesh;
+//      int trail = bullet.addNode("bullet_trail", root, trail_offset);
+//      bullet.add<Mesh>(trail) = trail_mesh;
+//      std::vector<int> roots = ECS.instantiate(bullet, 1000, spawn_matrices.data());
+//  A prefab can also be copied from an entity in the scene with ECS.createPrefab()
+//
+#pragma once
+#include "Components.h"
+#include <vector>
+#include <string>
+#include <tuple>
+
+struct Prefab {
+    struct Node {
+        //name of entities spawned from node, interned once for all copies
+        StringID name;
+        //index of parent node, or -1 for the root. Parents are always added before children
+        int parent = -1;
+        //transform relative to parent node (root: relative to instance transform)
+        lm::mat4 local;
+        //which components the node has (Transform always), and their values
+        ComponentSignature signature;
+        ComponentTypes::Values components;
+    };
+
+    std::vector<Node> nodes;
+
+    //adds node and returns its index. Node 0 is the root
+    int addNode(std::string name, int parent = -1, const lm::mat4& local = lm::mat4()) {
+        Node node;
+        node.name = StringID(name);
+        node.parent = parent;
+        node.local = local;
+        node.signature.set(componentIndex<Transform>());
+        nodes.push_back(node);
+        return (int)nodes.size() - 1;
+    }
+
+    //adds component T to node, returns it so it can be set up.
+    //Transform is set from the node's local matrix, not from this value
+    template<typename T>
+    T& add(int node) {
+        nodes[node].signature.set(componentIndex<T>());
+        return std::get<T>(nodes[node].components);
+    }
+
+    //number of nodes which have component T
+    template<typename T>
+    int count() const {
+        int num = 0;
+        for (auto& node : nodes)
+            if (node.signature.test(componentIndex<T>())) num++;
+        return num;
+    }
+};
@@ -1,4 +1,6 @@
 #include "ScriptSystem.h"
+#include "extern.h"
+#include "Game.h"
 
 //call init function of all registered scripts
 void ScriptSystem::lateInit() {
@@ -7,15 +9,48 @@ void ScriptSystem::lateInit() {
 		scr->init();
 }
 
-//update all scripts
+//near scripts every step, with any time they spent far away
 void ScriptSystem::update(float dt) {
-	for (auto scr : scripts_)
-		scr->update(dt);
+	const bool has_camera = ECS.main_camera >= 0;
+	const lm::vec3 camera_position = has_camera ? ECS.getComponentInArray<Camera>(ECS.main_camera).position : lm::vec3();
+	for (size_t i = 0; i < scripts_.size(); i++) {
+		if (far_distance_ > 0.0f && has_camera && isFar_(scripts_[i], camera_position)) {
+			far_dt_[i] += dt;
+			continue;
+		}
+		scripts_[i]->update(dt + far_dt_[i]);
+		far_dt_[i] = 0.0f;
+	}
+}
+
+size_t ScriptSystem::updateFarScripts(const TimeSlice& slice) {
+	const size_t num = scripts_.size();
+	//one lap at most, starting where the last call stopped
+	for (size_t visited = 0; visited < num; visited++) {
+		const size_t i = far_cursor_++ % num;
+		if (far_dt_[i] <= 0.0f) continue;
+		scripts_[i]->update(far_dt_[i]);
+		far_dt_[i] = 0.0f;
+		if (slice.expired()) break;
+	}
+
+	size_t waiting = 0;
+	for (float dt : far_dt_)
+		if (dt > 0.0f) waiting++;
+	return waiting;
+}
+
+bool ScriptSystem::isFar_(const Script* script, const lm::vec3& camera_position) const {
+	if (ECS.getComponentID<Transform>(script->getOwner()) == -1) return false;
+	const Transform& transform = ECS.getComponentFromEntity<Transform>(script->getOwner());
+	const lm::vec3 position = Game::instance->transform_system_.world(transform).position();
+	return (position - camera_position).length() > far_distance_;
 }
 
 //register new script and pass script a pointer to control system
 void ScriptSystem::registerScript(Script* new_script) {
 	scripts_.push_back(new_script); //add to list
+	far_dt_.push_back(0.0f);
 	new_script->setInput(input_); //tell script where control system is
 
 }
@@ -3,6 +3,7 @@
 #include "Components.h"
 #include <vector>
 #include "ControlSystem.h"
+#include "TimeSlicedScheduler.h"
 
 
 //Forward declare ControlSystem to get input
@@ -22,6 +23,8 @@ public:
 	//sets pointer to control system
 	void setInput(ControlSystem* cont_sys) { input_ = cont_sys; };
 
+	int getOwner() const { return owner_; }
+
 protected:
 	int owner_; //id of entity which owns this script
 	ControlSystem* input_ = nullptr; //pointer to control system
@@ -36,14 +39,30 @@ public:
 	//lateInit calls init of all registered scripts
 	void lateInit();
 
-	//update all scripts 
+	//update scripts near the main camera. Scripts further than far distance
+	//add up dt until updateFarScripts gets to them
 	void update(float dt);
+
+	//updates far scripts, in turn, with the time since their last update,
+	//until slice expires. Returns how many still wait. A TimeSlicedScheduler
+	//workload
+	size_t updateFarScripts(const TimeSlice& slice);
+
+	//0 updates every script every step
+	void setFarDistance(float distance) { far_distance_ = distance; }
+	float getFarDistance() const { return far_distance_; }
 	
 	//register new script
 	void registerScript(Script* new_script);
 
 private:
 	std::vector<Script*> scripts_;
+	//time since the last update of each far script, 0 if it is up to date
+	std::vector<float> far_dt_;
+	size_t far_cursor_ = 0;
+	float far_distance_ = 50.0f;
+
+	bool isFar_(const Script* script, const lm::vec3& camera_position) const;
 
 	//pointer to the control system
 	ControlSystem* input_;
@@ -0,0 +1,79 @@
+//
+//  StringTable.h
+//
+//  Global table of interned strings. Each distinct string is stored once and
+//  identified by a 32-bit id, so objects which only need to compare or look up
+//  names (e.g. entities) can store 4 bytes instead of a heap allocated std::string
+//  The table is shared by all threads (e.g. a level loader creating entities),
+//  so every access is locked
+//
+#pragma once
+#include <string>
+#include <deque>
+#include <unordered_map>
+#include <cstdint>
+#include <mutex>
+
+class StringTable {
+public:
+    //id 0 is always the empty string
+    static const uint32_t EMPTY_ID = 0;
+
+    //returns id of string, adding it to the table if it is not there yet
+    static uint32_t intern(const std::string& str) {
+        StringTable& table = instance_();
+        std::lock_guard<std::mutex> lock(table.mutex_);
+        auto it = table.ids_.find(str);
+        if (it != table.ids_.end()) return it->second;
+        uint32_t new_id = (uint32_t)table.strings_.size();
+        table.strings_.push_back(str);
+        table.ids_[str] = new_id;
+        return new_id;
+    }
+
+    //returns id of string if already interned, EMPTY_ID otherwise
+    //(does not add the string, so lookups of unknown names don't grow the table)
+    static uint32_t find(const std::string& str) {
+        StringTable& table = instance_();
+        std::lock_guard<std::mutex> lock(table.mutex_);
+        auto it = table.ids_.find(str);
+        return it != table.ids_.end() ? it->second : EMPTY_ID;
+    }
+
+    //returns string for id. Reference is stable as strings are stored in a deque
+    static const std::string& get(uint32_t id) {
+        StringTable& table = instance_();
+        std::lock_guard<std::mutex> lock(table.mutex_);
+        return table.strings_[id];
+    }
+
+private:
+    StringTable() {
+        strings_.push_back("");
+        ids_[""] = EMPTY_ID;
+    }
+
+    static StringTable& instance_() {
+        static StringTable table;
+        return table;
+    }
+
+    std::deque<std::string> strings_;
+    std::unordered_map<std::string, uint32_t> ids_;
+    std::mutex mutex_;
+};
+
+//Lightweight handle to an interned string - 4 bytes, compared by id
+struct StringID {
+    uint32_t id = StringTable::EMPTY_ID;
+
+    StringID() {}
+    explicit StringID(const std::string& str) : id(StringTable::intern(str)) {}
+
+    const std::string& str() const { return StringTable::get(id); }
+    const char* c_str() const { return str().c_str(); }
+    bool empty() const { return id == StringTable::EMPTY_ID; }
+
+    bool operator == (const StringID& other) const { return id == other.id; }
+    bool operator != (const StringID& other) const { return id != other.id; }
+};
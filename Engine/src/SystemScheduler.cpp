@@ -0,0 +1,106 @@
+//
+//  SystemScheduler.cpp
+//
+
+#include "SystemScheduler.h"
+#include <chrono>
+#include <thread>
+#include <algorithm>
+
+bool SystemAccess::conflicts(const SystemAccess& other) const {
+    if (exclusive || other.exclusive) return true;
+    if ((writes & (other.reads | other.writes)).any() || (other.writes & reads).any()) return true;
+    return (resource_writes & (other.resource_reads | other.resource_writes)) != 0 ||
+        (other.resource_writes & resource_reads) != 0;
+}
+
+//an edge to every earlier conflicting system. Edges implied by a longer path
+//are skipped, so the graph only shows dependencies which order anything
+void SystemScheduler::add(const char* name, const SystemAccess& access, std::function<void(float)> update) {
+    Node node;
+    node.name = name;
+    node.access = access;
+    node.update = std::move(update);
+    const int index = (int)nodes_.size();
+
+    //earlier systems reachable from a dependency already added
+    std::vector<bool> reached(index, false);
+    for (int i = index - 1; i >= 0; i--) {
+        if (reached[i] || !access.conflicts(nodes_[i].access)) continue;
+        node.dependencies.push_back(i);
+        //everything before i that i depends on, directly or not
+        std::vector<int> stack(1, i);
+        while (!stack.empty()) {
+            const int n = stack.back();
+            stack.pop_back();
+            for (int d : nodes_[n].dependencies)
+                if (!reached[d]) { reached[d] = true; stack.push_back(d); }
+        }
+    }
+    std::reverse(node.dependencies.begin(), node.dependencies.end());
+    for (int d : node.dependencies) nodes_[d].dependents.push_back(index);
+    nodes_.push_back(std::move(node));
+}
+
+double SystemScheduler::now_() {
+    return std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now().time_since_epoch()).count();
+}
+
+void SystemScheduler::run(float dt, JobSystem& jobs) {
+    const int num = (int)nodes_.size();
+    dt_ = dt;
+    jobs_ = &jobs;
+    pending_.reset(new std::atomic<int>[num]);
+    main_ready_.reset(new std::atomic<bool>[num]);
+    for (int i = 0; i < num; i++) {
+        pending_[i] = (int)nodes_[i].dependencies.size();
+        main_ready_[i] = false;
+    }
+    num_done_ = 0;
+    frame_timeline_.entries.assign(num, SystemTimeline::Entry());
+    frame_start_ = now_();
+
+    for (int i = 0; i < num; i++)
+        if (pending_[i] == 0) start_(i);
+
+    //run systems which must stay on this thread as they become ready, and
+    //help with the others in between
+    while (num_done_ < num) {
+        bool ran = false;
+        for (int i = 0; i < num; i++) {
+            if (!main_ready_[i]) continue;
+            main_ready_[i] = false;
+            execute_(i);
+            ran = true;
+        }
+        if (!ran && !jobs.tryRunJob())
+            std::this_thread::yield();
+    }
+    jobs.wait(frame_jobs_);
+
+    frame_timeline_.frame_ms = now_() - frame_start_;
+    double busy_ms = 0;
+    for (const auto& entry : frame_timeline_.entries) busy_ms += entry.end_ms - entry.start_ms;
+    frame_timeline_.parallelism = frame_timeline_.frame_ms > 0 ? busy_ms / frame_timeline_.frame_ms : 0;
+    timeline_ = frame_timeline_;
+}
+
+void SystemScheduler::start_(int i) {
+    if (nodes_[i].access.mainThread())
+        main_ready_[i] = true;
+    else
+        jobs_->run([this, i]() { execute_(i); }, &frame_jobs_);
+}
+
+void SystemScheduler::execute_(int i) {
+    SystemTimeline::Entry& entry = frame_timeline_.entries[i];
+    entry.name = nodes_[i].name;
+    entry.thread = std::max(jobs_->getThreadIndex(), 0);
+    entry.start_ms = now_() - frame_start_;
+    nodes_[i].update(dt_);
+    entry.end_ms = now_() - frame_start_;
+
+    for (int d : nodes_[i].dependents)
+        if (--pending_[d] == 0) start_(d);
+    num_done_++;
+}
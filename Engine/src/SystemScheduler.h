@@ -0,0 +1,107 @@
+//
+//  SystemScheduler.h
+//
+//  Runs the systems of one frame as a graph instead of a fixed list. Each
+//  system declares the component types it reads and writes, and the data
+//  outside the ECS it uses (SystemResource). Two systems conflict if one
+//  writes anything the other reads or writes; of two conflicting systems, the
+//  one added first runs first. Systems which do not conflict run at the same
+//  time as jobs on the JobSystem.
+//  Systems which use OpenGL, or are exclusive (they may touch anything, like
+//  scripts or the ECS sync point), run on the thread which calls run().
+//  Usage:
+//      scheduler.add("collision", SystemAccess().read<Collider>().write<Collision>()
+//          .read(ResourceTransformCache), [&](float dt) { collision.update(dt); });
+//      scheduler.run(dt, jobs);
+//
+#pragma once
+#include "Components.h"
+#include "JobSystem.h"
+#include <vector>
+#include <string>
+#include <functional>
+#include <atomic>
+#include <memory>
+#include <cstdint>
+
+//data outside the ECS which systems share
+enum SystemResource {
+    ResourceGL = 1 << 0,             //OpenGL context, only usable on the main thread
+    ResourceInput = 1 << 1,          //keys and mouse state of the control system
+    ResourceCameras = 1 << 2,        //ECS.main_camera and camera system blending
+    ResourceTransformCache = 1 << 3, //world matrices of the transform system
+    ResourceChangeTick = 1 << 4      //ECS change tick; markChanged reads it
+};
+
+//what a system reads and writes
+struct SystemAccess {
+    ComponentSignature reads, writes;
+    uint32_t resource_reads = 0, resource_writes = 0;
+    //conflicts with every other system
+    bool exclusive = false;
+
+    template<typename... Ts>
+    SystemAccess& read() { int expand[] = { 0, (reads.set(componentIndex<Ts>()), 0)... }; (void)expand; return *this; }
+    template<typename... Ts>
+    SystemAccess& write() { int expand[] = { 0, (writes.set(componentIndex<Ts>()), 0)... }; (void)expand; return *this; }
+    SystemAccess& read(uint32_t resources) { resource_reads |= resources; return *this; }
+    SystemAccess& write(uint32_t resources) { resource_writes |= resources; return *this; }
+    SystemAccess& setExclusive() { exclusive = true; return *this; }
+
+    bool conflicts(const SystemAccess& other) const;
+    bool mainThread() const { return exclusive || ((resource_reads | resource_writes) & ResourceGL) != 0; }
+};
+
+//when and where each system ran in the last frame
+struct SystemTimeline {
+    struct Entry {
+        const char* name;
+        int thread;
+        double start_ms, end_ms;
+    };
+    std::vector<Entry> entries;
+    double frame_ms = 0;
+    //time spent in systems over frame time: 1 if nothing overlapped
+    double parallelism = 0;
+};
+
+class SystemScheduler {
+public:
+    //systems run in the order added wherever they conflict
+    void add(const char* name, const SystemAccess& access, std::function<void(float)> update);
+
+    //runs every system once, and returns when all are done
+    void run(float dt, JobSystem& jobs);
+
+    //systems which must finish before system i starts (direct edges only)
+    const std::vector<int>& getDependencies(int i) const { return nodes_[i].dependencies; }
+    const char* getName(int i) const { return nodes_[i].name; }
+    int getNumSystems() const { return (int)nodes_.size(); }
+    const SystemTimeline& getTimeline() const { return timeline_; }
+
+private:
+    struct Node {
+        const char* name;
+        SystemAccess access;
+        std::function<void(float)> update;
+        std::vector<int> dependencies;
+        std::vector<int> dependents;
+    };
+    std::vector<Node> nodes_;
+    //timeline of the last finished frame, and of the one running
+    SystemTimeline timeline_;
+    SystemTimeline frame_timeline_;
+
+    //state of the frame being run
+    float dt_ = 0;
+    JobSystem* jobs_ = nullptr;
+    std::unique_ptr<std::atomic<int>[]> pending_;
+    std::unique_ptr<std::atomic<bool>[]> main_ready_;
+    std::atomic<int> num_done_{ 0 };
+    JobCounter frame_jobs_;
+    double frame_start_ = 0;
+
+    void start_(int i);
+    void execute_(int i);
+    static double now_();
+};
@@ -0,0 +1,72 @@
+//
+//  TimeSlicedScheduler.cpp
+//
+
+#include "TimeSlicedScheduler.h"
+#include <chrono>
+#include <algorithm>
+
+static double nowMs() {
+    return std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now().time_since_epoch()).count();
+}
+
+double TimeSlice::remainingMs() const {
+    return end_ms_ - nowMs();
+}
+
+int TimeSlicedScheduler::add(const char* name, int priority, Work work) {
+    Workload workload;
+    workload.name = name;
+    workload.priority = priority;
+    workload.work = std::move(work);
+    workloads_.push_back(std::move(workload));
+    return (int)workloads_.size() - 1;
+}
+
+//workloads not reached last frame move up, then the order is fixed for the
+//frame. Ties keep the order added
+void TimeSlicedScheduler::beginFrame(double budget_ms) {
+    for (Workload& workload : workloads_) {
+        if (frame_started_ && !workload.ran_this_frame)
+            workload.frames_waiting++;
+        workload.ran_this_frame = false;
+        workload.ms = 0;
+    }
+
+    order_.resize(workloads_.size());
+    for (size_t i = 0; i < order_.size(); i++) order_[i] = (int)i;
+    std::stable_sort(order_.begin(), order_.end(), [this](int a, int b) {
+        return workloads_[a].priority + workloads_[a].frames_waiting > workloads_[b].priority + workloads_[b].frames_waiting;
+    });
+
+    budget_ms_ = budget_ms;
+    spent_ms_ = 0;
+    frame_end_ms_ = nowMs() + budget_ms;
+    frame_started_ = true;
+}
+
+//the first workload runs once a frame even with the budget spent, so the
+//highest priority (or longest waiting) work always advances. The budget is
+//checked between workloads
+void TimeSlicedScheduler::run() {
+    if (!frame_started_) return;
+    const TimeSlice slice(frame_end_ms_);
+    for (size_t n = 0; n < order_.size(); n++) {
+        Workload& workload = workloads_[order_[n]];
+        const bool guaranteed = n == 0 && !workload.ran_this_frame;
+        if (!guaranteed && slice.expired()) return;
+        const double start = nowMs();
+        workload.backlog = workload.work(slice);
+        const double ms = nowMs() - start;
+        workload.ms += ms;
+        spent_ms_ += ms;
+        workload.ran_this_frame = true;
+        workload.frames_waiting = 0;
+    }
+}
+
+size_t TimeSlicedScheduler::getBacklog() const {
+    size_t backlog = 0;
+    for (const Workload& workload : workloads_) backlog += workload.backlog;
+    return backlog;
+}
@@ -0,0 +1,86 @@
+//
+//  TimeSlicedScheduler.h
+//
+//  Spreads work which may lag a few frames behind (scripts far from the
+//  camera, uploading a level loaded in the background) over several frames,
+//  under a budget of milliseconds per frame, so a burst of it shows up as a
+//  backlog instead of a frame time spike.
+//  Each workload is resumable: a function which does items until its
+//  TimeSlice expires, then returns how many items it has left (its backlog).
+//  It is called again next frame and carries on where it stopped. Workloads
+//  run by priority, highest first. A workload which was not reached (its last
+//  backlog may be out of date, as work keeps coming) gains one priority point
+//  per frame until it runs, so low priority work is late but never starved.
+//  Usage:
+//      sliced.add("far scripts", 0, [&](const TimeSlice& slice) {
+//          do update(next_++); while (next_ < n && !slice.expired());
+//          return n - next_;
+//      });
+//      sliced.beginFrame(2.0); //budget of this frame
+//      sliced.run();           //once or more per frame, spends what is left
+//
+#pragma once
+#include <vector>
+#include <functional>
+#include <cstddef>
+
+//time left to a workload in the current frame
+class TimeSlice {
+public:
+    explicit TimeSlice(double end_ms) : end_ms_(end_ms) {}
+    //true once the frame budget is spent. Reads the clock, so check it every
+    //item or every few items, not every instruction
+    bool expired() const { return remainingMs() <= 0.0; }
+    double remainingMs() const;
+
+private:
+    double end_ms_;
+};
+
+class TimeSlicedScheduler {
+public:
+    //does items until slice expires (at least one, if any, so work advances
+    //with any budget), returns the number left
+    typedef std::function<size_t(const TimeSlice&)> Work;
+
+    struct Workload {
+        const char* name;
+        int priority;
+        Work work;
+        //items left after the last call
+        size_t backlog = 0;
+        //time spent in this workload this frame
+        double ms = 0;
+        //frames since it last ran
+        int frames_waiting = 0;
+        bool ran_this_frame = false;
+    };
+
+    //workloads with higher priority run first. Returns its index
+    int add(const char* name, int priority, Work work);
+
+    //starts a frame with budget_ms to spend in run()
+    void beginFrame(double budget_ms);
+    //runs workloads by priority until the budget of the frame is spent, and
+    //the first one at least once a frame whatever the budget. May be called
+    //several times a frame (e.g. once per simulation step)
+    void run();
+
+    //items left in all workloads
+    size_t getBacklog() const;
+    double getBudgetMs() const { return budget_ms_; }
+    //time spent in workloads this frame, more than the budget if the last one
+    //overran it
+    double getSpentMs() const { return spent_ms_; }
+    int getNumWorkloads() const { return (int)workloads_.size(); }
+    const Workload& getWorkload(int i) const { return workloads_[i]; }
+
+private:
+    std::vector<Workload> workloads_;
+    //workload indices, highest priority first, sorted at beginFrame
+    std::vector<int> order_;
+    double budget_ms_ = 0;
+    double spent_ms_ = 0;
+    double frame_end_ms_ = 0;
+    bool frame_started_ = false;
+};
@@ -0,0 +1,271 @@
+//
+//  TransformSystem.cpp
+//
+
+#include "TransformSystem.h"
+#include "extern.h"
+#include <atomic>
+#include <chrono>
+#include <algorithm>
+
+void TransformSystem::init(JobSystem* jobs) {
+    jobs_ = jobs;
+}
+
+//called after loading everything
+void TransformSystem::lateInit() {
+    //first update computes everything
+    cache_.owners.clear();
+    levels_built_ = false;
+    update(0.0f);
+    snapInterpolation();
+    interpolate(1.0f);
+}
+
+void TransformSystem::update(float) {
+    //one pass relies on parents being stored before their children. A reparent
+    //since the last sync point may have broken the order
+    ECS.sortHierarchy();
+
+    //anything written after this tick is picked up next update
+    const uint32_t tick = ECS.takeChangeTick();
+
+    auto& transforms = ECS.getAllComponents<Transform>();
+    if (parallel_ && (!levels_built_ || levels_version_ != ECS.getStructureVersion())) {
+        buildLevels_(cache_, transforms.data(), transforms.size());
+        levels_version_ = ECS.getStructureVersion();
+        levels_built_ = true;
+    }
+    num_updated_ = propagate_(cache_, transforms.data(), ECS.getComponentVersions<Transform>().data(),
+                              transforms.size(), tick, parallel_);
+}
+
+//sorts transform indices by depth (counting sort, so stable)
+void TransformSystem::buildLevels_(Cache& cache, const Transform* transforms, size_t num) {
+    cache.depths.resize(num);
+    int max_depth = -1;
+    for (size_t i = 0; i < num; i++) {
+        const int parent = transforms[i].parent;
+        cache.depths[i] = parent == -1 ? 0 : cache.depths[parent] + 1;
+        max_depth = std::max(max_depth, cache.depths[i]);
+    }
+
+    cache.level_starts.assign(max_depth + 2, 0);
+    for (size_t i = 0; i < num; i++) cache.level_starts[cache.depths[i] + 1]++;
+    for (size_t l = 1; l < cache.level_starts.size(); l++) cache.level_starts[l] += cache.level_starts[l - 1];
+
+    std::vector<int> fill(cache.level_starts.begin(), cache.level_starts.end() - 1);
+    cache.level_order.resize(num);
+    for (size_t i = 0; i < num; i++) cache.level_order[fill[cache.depths[i]]++] = (int)i;
+}
+
+int TransformSystem::propagate_(Cache& cache, const Transform* transforms, const uint32_t* versions, size_t num, uint32_t tick, bool parallel) {
+    cache.world.resize(num);
+    cache.normal.resize(num);
+    cache.previous_world.resize(num);
+    cache.owners.resize(num, -1);
+    cache.world_versions.resize(num, 0);
+    cache.uniform_scale.resize(num, 0);
+    cache.dirty.assign(num, 0);
+
+    int updated = 0;
+    if (!parallel || getNumThreads() == 1 || num < PARALLEL_MIN_LEVEL) {
+        for (size_t i = 0; i < num; i++)
+            updated += updateTransform_(cache, transforms, versions, (int)i, tick);
+    }
+    else {
+        //levels in order, each one split into jobs
+        std::atomic<int> parallel_updated{ 0 };
+        for (size_t l = 0; l + 1 < cache.level_starts.size(); l++) {
+            const int* level = cache.level_order.data() + cache.level_starts[l];
+            const size_t level_size = cache.level_starts[l + 1] - cache.level_starts[l];
+            if (level_size < PARALLEL_MIN_LEVEL) {
+                for (size_t k = 0; k < level_size; k++)
+                    updated += updateTransform_(cache, transforms, versions, level[k], tick);
+                continue;
+            }
+            jobs_->parallelFor(level_size, PARALLEL_GRAIN, [&](size_t begin, size_t end) {
+                int chunk_updated = 0;
+                for (size_t k = begin; k < end; k++)
+                    chunk_updated += updateTransform_(cache, transforms, versions, level[k], tick);
+                parallel_updated += chunk_updated;
+            });
+        }
+        updated += parallel_updated;
+    }
+    cache.last_tick = tick;
+    return updated;
+}
+
+int TransformSystem::updateTransform_(Cache& cache, const Transform* transforms, const uint32_t* versions, int i, uint32_t tick) {
+    const Transform& transform = transforms[i];
+    const int parent = transform.parent;
+    const bool dirty = cache.owners[i] != transform.owner || versions[i] > cache.last_tick ||
+        (parent != -1 && cache.dirty[parent]);
+    if (!dirty) return 0;
+
+    //first recompute in this step: keep the state of the last step
+    const bool moved = cache.owners[i] != transform.owner;
+    if (!moved && cache.world_versions[i] <= cache.step_tick)
+        cache.previous_world[i] = cache.world[i];
+
+    cache.dirty[i] = 1;
+    cache.owners[i] = transform.owner;
+    cache.world_versions[i] = tick;
+    lm::mat4& world = cache.world[i];
+    world = parent == -1 ? transform.matrix() : cache.world[parent] * transform.matrix();
+    //a transform new to this slot has nothing to blend from
+    if (moved) cache.previous_world[i] = world;
+
+    //with the same scale s on every axis all the way up the chain, the upper
+    //3x3 is s times a rotation, and its inverse transpose is itself over s^2
+    const bool uniform = transform.hasUniformScale() && (parent == -1 || cache.uniform_scale[parent]);
+    cache.uniform_scale[i] = uniform;
+    lm::mat4& normal = cache.normal[i];
+    if (!uniform || !uniformNormal_(world, normal)) {
+        normal = world;
+        normal.inverseAffine();
+        normal.transpose();
+    }
+    return 1;
+}
+
+bool TransformSystem::uniformNormal_(const lm::mat4& world, lm::mat4& normal) {
+    const float scale_sq = world.m[0] * world.m[0] + world.m[1] * world.m[1] + world.m[2] * world.m[2];
+    if (scale_sq <= 0.0f) return false;
+    const float inv_scale_sq = 1.0f / scale_sq;
+    normal.setIdentity();
+    for (int c = 0; c < 3; c++)
+        for (int r = 0; r < 3; r++)
+            normal.M[c][r] = world.M[c][r] * inv_scale_sq;
+    return true;
+}
+
+/**** INTERPOLATION ****/
+
+void TransformSystem::interpolate(float alpha) {
+    const size_t num = cache_.world.size();
+    //new slots are copied on first use
+    render_world_.resize(num);
+    render_normal_.resize(num);
+    render_versions_.resize(num, 0);
+    render_blended_.resize(num, 1);
+
+    auto interpolate_range = [&](size_t begin, size_t end) {
+        for (size_t i = begin; i < end; i++) interpolateTransform_(i, alpha);
+    };
+    if (parallel_ && jobs_) jobs_->parallelForArray(render_world_.data(), sizeof(lm::mat4), num, INTERPOLATE_GRAIN, interpolate_range);
+    else interpolate_range(0, num);
+}
+
+//uniformly scaled matrices have no shear, so they are split into translation,
+//rotation and scale, which are blended separately and put back together.
+//Others are blended element by element, close enough over one step
+void TransformSystem::interpolateTransform_(size_t i, float alpha) {
+    const Cache& cache = cache_;
+    const bool blend = !snap_ && cache.world_versions[i] > cache.step_tick;
+    if (!blend) {
+        if (!render_blended_[i] && render_versions_[i] == cache.world_versions[i]) return;
+        render_world_[i] = cache.world[i];
+        render_normal_[i] = cache.normal[i];
+        render_versions_[i] = cache.world_versions[i];
+        render_blended_[i] = 0;
+        return;
+    }
+
+    const lm::mat4& from = cache.previous_world[i];
+    const lm::mat4& to = cache.world[i];
+    lm::mat4& world = render_world_[i];
+    lm::mat4& normal = render_normal_[i];
+    if (cache.uniform_scale[i]) {
+        lm::vec3 from_t, from_s, to_t, to_s;
+        lm::quat from_r, to_r;
+        from.decompose(from_t, from_r, from_s);
+        to.decompose(to_t, to_r, to_s);
+        world.makeTransformMatrix(from_t.lerp(to_t, alpha), from_r.slerp(to_r, alpha), from_s.lerp(to_s, alpha));
+        if (!uniformNormal_(world, normal)) normal = cache.normal[i];
+    }
+    else {
+        for (int k = 0; k < 16; k++) world.m[k] = from.m[k] + (to.m[k] - from.m[k]) * alpha;
+        normal = world;
+        normal.inverseAffine();
+        normal.transpose();
+    }
+    render_versions_[i] = cache.world_versions[i];
+    render_blended_[i] = 1;
+}
+
+int TransformSystem::cachedIndex(const Transform& transform) const {
+    const int index = ECS.getComponentID<Transform>(transform.owner);
+    return index >= 0 && index < (int)cache_.owners.size() && cache_.owners[index] == transform.owner ? index : -1;
+}
+
+const lm::mat4& TransformSystem::world(const Transform& transform) const {
+    const int index = cachedIndex(transform);
+    return index != -1 ? cache_.world[index] : transform.matrix();
+}
+
+const lm::mat4& TransformSystem::normalMatrix(const Transform& transform) const {
+    const int index = cachedIndex(transform);
+    return index != -1 ? cache_.normal[index] : transform.matrix();
+}
+
+const lm::mat4& TransformSystem::renderWorld(const Transform& transform) const {
+    const int index = cachedIndex(transform);
+    return index != -1 && index < (int)render_world_.size() ? render_world_[index] : world(transform);
+}
+
+const lm::mat4& TransformSystem::renderNormalMatrix(const Transform& transform) const {
+    const int index = cachedIndex(transform);
+    return index != -1 && index < (int)render_normal_.size() ? render_normal_[index] : normalMatrix(transform);
+}
+
+/**** BENCHMARK ****/
+
+TransformSystem::Benchmark TransformSystem::benchmark(int num_transforms, int repeats) {
+    Benchmark result;
+    result.num_transforms = num_transforms;
+    result.num_threads = getNumThreads();
+    repeats = std::max(repeats, 1);
+
+    //every transform counts as changed, as if all were animated
+    const std::vector<uint32_t> versions(num_transforms, 1);
+
+    for (int deep = 0; deep < 2; deep++) {
+        std::vector<Transform> transforms(num_transforms);
+        for (int i = 0; i < num_transforms; i++) {
+            transforms[i].owner = i;
+            transforms[i].translate(0.01f * i, 1.0f, 0.0f);
+            if (deep && i % BENCHMARK_DEPTH != 0) transforms[i].parent = i - 1;
+        }
+
+        //own cache, so the live matrices are untouched
+        Cache bench;
+        buildLevels_(bench, transforms.data(), transforms.size());
+        double ms[2] = { 0, 0 };
+        std::vector<lm::mat4> serial_world;
+        for (int parallel = 0; parallel < 2; parallel++) {
+            for (int r = 0; r < repeats; r++) {
+                bench.owners.clear();
+                bench.last_tick = 0;
+                auto t0 = std::chrono::high_resolution_clock::now();
+                propagate_(bench, transforms.data(), versions.data(), transforms.size(), 2, parallel != 0);
+                auto t1 = std::chrono::high_resolution_clock::now();
+                ms[parallel] += std::chrono::duration<double, std::milli>(t1 - t0).count() / repeats;
+            }
+            if (!parallel) serial_world = bench.world;
+        }
+        for (size_t i = 0; i < serial_world.size(); i++)
+            for (int k = 0; k < 16; k++)
+                if (serial_world[i].m[k] != bench.world[i].m[k]) result.results_match = false;
+
+        if (deep) { result.deep_serial_ms = ms[0]; result.deep_parallel_ms = ms[1]; }
+        else { result.flat_serial_ms = ms[0]; result.flat_parallel_ms = ms[1]; }
+    }
+
+    std::cout << "transform benchmark: " << num_transforms << " transforms, " << result.num_threads << " threads\n"
+        << "  flat: serial " << result.flat_serial_ms << " ms, parallel " << result.flat_parallel_ms << " ms\n"
+        << "  deep (" << BENCHMARK_DEPTH << " levels): serial " << result.deep_serial_ms << " ms, parallel "
+        << result.deep_parallel_ms << " ms" << (result.results_match ? "" : " (RESULTS DIFFER)") << "\n";
+    return result;
+}
@@ -0,0 +1,158 @@
+#pragma once
+#include "includes.h"
+#include "Components.h"
+#include "JobSystem.h"
+#include <vector>
+#include <cstdint>
+
+//Computes the world matrix (and normal matrix) of every transform once per
+//update, so renderers and collision read a cached matrix instead of walking the
+//parent chain with Transform::getGlobalMatrix for every use.
+//The transform array is in depth order (see HIERARCHY in the ECS), so one pass
+//visits parents before children. A transform is recomputed only if it changed
+//since the last update, it was moved in the array, or its parent was recomputed;
+//clean subtrees cost one comparison per transform.
+//Where the scale is uniform along the whole parent chain the normal matrix is
+//the world rotation over the squared scale; only other transforms need an inverse.
+//In parallel mode transforms are grouped by hierarchy depth, and each level is
+//split into jobs, as every parent is finished a level earlier.
+//Cached matrices are parallel to the transform array, indexed like it.
+//The simulation runs in fixed steps (see Game::update), so rendering keeps its
+//own render matrices: world matrices interpolated between the last two steps.
+//The first recompute of a transform in a step saves its old world matrix, and
+//interpolate() blends the transforms recomputed in the last step; the others
+//are copied once when they change
+class TransformSystem {
+public:
+    //jobs runs the hierarchy levels in parallel; without it updates are serial
+    void init(JobSystem* jobs = nullptr);
+    void lateInit();
+    void update(float dt);
+
+    //called before each fixed simulation step, so the world matrices the step
+    //recomputes keep their state from the step before
+    void beginStep() { cache_.step_tick = cache_.last_tick; snap_ = false; }
+    //render matrices at alpha (0 to 1) of the way from the state before the
+    //last step to the state after it
+    void interpolate(float alpha);
+    //render the current state until the next step, e.g. after a teleport or
+    //restoring a snapshot, where blending from the old state would be wrong
+    void snapInterpolation() { snap_ = true; }
+
+    //world matrix of transform at index in the transform array
+    const lm::mat4& world(int transform_index) const { return cache_.world[transform_index]; }
+    //world matrix of transform. A transform created since the last update is
+    //not cached yet, so its local matrix is returned
+    const lm::mat4& world(const Transform& transform) const;
+
+    //inverse transpose of the world matrix, for transforming normals
+    const lm::mat4& normalMatrix(int transform_index) const { return cache_.normal[transform_index]; }
+    const lm::mat4& normalMatrix(const Transform& transform) const;
+
+    //index of transform in the cached arrays, or -1 if it was created since
+    //the last update
+    int cachedIndex(const Transform& transform) const;
+    //all cached world matrices, indexed like the transform array, for kernels
+    //which work on many matrices at once (see lm::batch)
+    const lm::mat4* worldMatrices() const { return cache_.world.data(); }
+    size_t numCached() const { return cache_.world.size(); }
+
+    //matrices to draw with, interpolated by the last call to interpolate().
+    //A transform created since then gets its world matrix
+    const lm::mat4& renderWorld(const Transform& transform) const;
+    const lm::mat4& renderNormalMatrix(const Transform& transform) const;
+    const lm::mat4* renderWorldMatrices() const { return render_world_.data(); }
+    size_t numRendered() const { return render_world_.size(); }
+
+    //true if world matrix of transform at index was recomputed after tick
+    bool worldChangedSince(int transform_index, uint32_t tick) const {
+        return transform_index >= (int)cache_.world_versions.size() || cache_.world_versions[transform_index] > tick;
+    }
+
+    //true if render matrix of transform at index changed since the render
+    //which took tick: its world matrix did, or it is being interpolated
+    bool renderChangedSince(int transform_index, uint32_t tick) const {
+        return worldChangedSince(transform_index, tick) ||
+            transform_index >= (int)render_blended_.size() || render_blended_[transform_index];
+    }
+
+    //number of world matrices recomputed by the last update
+    int getNumUpdated() const { return num_updated_; }
+
+    //process hierarchy levels as parallel jobs (levels smaller than
+    //PARALLEL_MIN_LEVEL always run on the calling thread)
+    void setParallel(bool parallel) { parallel_ = parallel; }
+    bool isParallel() const { return parallel_; }
+    int getNumThreads() const { return jobs_ ? jobs_->getNumThreads() : 1; }
+    static const size_t PARALLEL_MIN_LEVEL = 1024;
+    static const size_t PARALLEL_GRAIN = 256;
+    static const size_t INTERPOLATE_GRAIN = 1024;
+
+    //times full propagation of num_transforms synthetic transforms, serial and
+    //parallel, on a flat hierarchy (all roots) and a deep one (chains of
+    //BENCHMARK_DEPTH). Does not touch the ECS or the cached matrices
+    struct Benchmark {
+        int num_transforms = 0;
+        int num_threads = 0;
+        double flat_serial_ms = 0, flat_parallel_ms = 0;
+        double deep_serial_ms = 0, deep_parallel_ms = 0;
+        bool results_match = true;
+    };
+    static const int BENCHMARK_DEPTH = 32;
+    Benchmark benchmark(int num_transforms, int repeats = 10);
+
+private:
+    //cached matrices and the data to update them. The benchmark uses its own
+    struct Cache {
+        std::vector<lm::mat4> world;
+        std::vector<lm::mat4> normal;
+        //world matrix before the last step which recomputed it
+        std::vector<lm::mat4> previous_world;
+        //owner of transform each slot was computed for, to detect moved transforms
+        std::vector<int> owners;
+        //change tick at which each world matrix was last recomputed
+        std::vector<uint32_t> world_versions;
+        std::vector<uint8_t> dirty;
+        //world scale is the same on every axis
+        std::vector<uint8_t> uniform_scale;
+        uint32_t last_tick = 0;
+        //last_tick when the current step began: world matrices with a later
+        //version were recomputed by it
+        uint32_t step_tick = 0;
+
+        //transform indices grouped by depth: level l is
+        //level_order[level_starts[l]] to level_order[level_starts[l + 1] - 1]
+        std::vector<int> level_order;
+        std::vector<int> level_starts;
+        std::vector<int> depths;
+    };
+    Cache cache_;
+    int num_updated_ = 0;
+
+    //interpolated matrices for rendering, indexed like the cache. A slot is
+    //copied again only if its world version differs from render_versions_,
+    //or it was blended (render_blended_) by the last interpolate
+    std::vector<lm::mat4> render_world_;
+    std::vector<lm::mat4> render_normal_;
+    std::vector<uint32_t> render_versions_;
+    std::vector<uint8_t> render_blended_;
+    bool snap_ = false;
+
+    //levels are rebuilt when the ECS structure version changes
+    unsigned int levels_version_ = 0;
+    bool levels_built_ = false;
+
+    bool parallel_ = true;
+    JobSystem* jobs_ = nullptr;
+
+    static void buildLevels_(Cache& cache, const Transform* transforms, size_t num);
+    //recomputes every transform which needs it, returns how many did
+    int propagate_(Cache& cache, const Transform* transforms, const uint32_t* versions, size_t num, uint32_t tick, bool parallel);
+    //recomputes transform i if it needs it, returns 1 if it did
+    static int updateTransform_(Cache& cache, const Transform* transforms, const uint32_t* versions, int i, uint32_t tick);
+    //inverse transpose of a world matrix whose scale is uniform: its upper
+    //3x3 over the squared scale. False, and normal untouched, if scale is zero
+    static bool uniformNormal_(const lm::mat4& world, lm::mat4& normal);
+    //render matrices of slot i, blended or copied
+    void interpolateTransform_(size_t i, float alpha);
+};
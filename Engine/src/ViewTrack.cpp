@@ -42,12 +42,14 @@ void ViewTrack::update(float dt) {
     if (active)
     {
         // Update ratio and get interpolated position along the spline.
+        // Marked changed so snapshots don't share a stale copy of the track
+        ECS.markChanged<ViewTrack>(ECS.getComponentID<ViewTrack>(owner));
         ratio += dt * speed;
         lm::vec3 new_pos = curve.evaluateAsCatmull(ratio);
 
         // Update camera position here
-        Camera& cam = ECS.getComponentFromEntity<Camera>(owner);
-        Transform& trans = ECS.getComponentFromEntity<Transform>(owner);
+        Camera& cam = ECS.getComponentFromEntityForWrite<Camera>(owner);
+        Transform& trans = ECS.getComponentFromEntityForWrite<Transform>(owner);
 
         // Apply transforms and reset ratio
         {
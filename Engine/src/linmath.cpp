@@ -8,9 +8,21 @@
 #include <math.h> //atan2
 #include <utility> //for std::swap
 #include <algorithm>
+#include <limits>
+#include <vector>
+#include <random>
+#include <chrono>
+#include <iostream>
+#include "linmath_simd.h"
 
 namespace lm {
 
+#if LM_SSE
+#define LM_BACKEND simd
+#else
+#define LM_BACKEND scalar
+#endif
+
 	//**************************************
 	// vec2
 	//**************************************
@@ -115,18 +127,31 @@ namespace lm {
 		return (*this).conjugate() * (1/norm);
 	}
 
-	quat operator + (const quat& a, const quat& b) { return quat(a.x + b.x, a.y + b.y, a.z + b.z, a.w + b.w); }
-	quat operator - (const quat& a, const quat& b) { return quat(a.x - b.x, a.y - b.y, a.z - b.z, a.w - b.w); }
-	quat operator * (const quat& a, float v) { return quat(a.x * v, a.y * v, a.z * v, a.w * v); }
-	quat operator * (const quat& a, const quat& b) {
-		return quat(
-			a.w * b.w - a.x * b.x - a.y * b.y - a.z * b.z,
-			a.w * b.x + a.x * b.w + a.y * b.z - a.z * b.y,
-			a.w * b.y - a.x * b.z + a.y * b.w + a.z * b.x,
-			a.w * b.z + a.x  *b.y - a.y * b.x + a.z * b.w
-		);
+	quat quat::slerp(const quat& end, float percent) const {
+		//q and -q are the same rotation, flip end if that makes the arc shorter
+		float cos_angle = w*end.w + x*end.x + y*end.y + z*end.z;
+		float sign = cos_angle < 0.0f ? -1.0f : 1.0f;
+		cos_angle *= sign;
+
+		float a = 1.0f - percent, b = percent;
+		//for nearly equal quaternions sin(angle) is too small to divide by, but
+		//a straight line is then close enough
+		if (cos_angle < 0.9995f) {
+			float angle = acosf(cos_angle);
+			float inv_sin = 1.0f / sinf(angle);
+			a = sinf(a * angle) * inv_sin;
+			b = sinf(b * angle) * inv_sin;
+		}
+		b *= sign;
+		quat result(w*a + end.w*b, x*a + end.x*b, y*a + end.y*b, z*a + end.z*b);
+		return result.normalize();
 	}
 
+	quat operator + (const quat& a, const quat& b) { return quat(a.w + b.w, a.x + b.x, a.y + b.y, a.z + b.z); }
+	quat operator - (const quat& a, const quat& b) { return quat(a.w - b.w, a.x - b.x, a.y - b.y, a.z - b.z); }
+	quat operator * (const quat& a, float v) { return quat(a.w * v, a.x * v, a.y * v, a.z * v); }
+	quat operator * (const quat& a, const quat& b) { return LM_BACKEND::multiply(a, b); }
+
 	//**************************************
 	// mat4
 	//**************************************
@@ -159,73 +184,19 @@ namespace lm {
 
 	mat4& mat4::transpose()
 	{
-		std::swap(m[1], m[4]); std::swap(m[2], m[8]); std::swap(m[3], m[12]);
-		std::swap(m[6], m[9]); std::swap(m[7], m[13]); std::swap(m[11], m[14]);
+		LM_BACKEND::transpose(*this);
 		return *this;
 	}
 
 	bool mat4::inverse()
 	{
-		unsigned int i, j, k, swap;
-		float t;
-		mat4 temp, final;
-		final.setIdentity();
-
-		temp = (*this);
-
-		unsigned int m, n;
-		m = n = 4;
-
-		for (i = 0; i < m; i++)
-		{
-			// Look for largest element in column
-			swap = i;
-			for (j = i + 1; j < m; j++)// m or n
-			{
-				if (fabs(temp.M[j][i]) > fabs(temp.M[swap][i]))
-					swap = j;
-			}
-
-			if (swap != i)
-			{
-				// Swap rows.
-				for (k = 0; k < n; k++)
-				{
-					std::swap(temp.M[i][k], temp.M[swap][k]);
-					std::swap(final.M[i][k], final.M[swap][k]);
-				}
-			}
-			// No non-zero pivot.  The CMatrix is singular, which shouldn't
-			// happen.  This means the user gave us a bad CMatrix.
-#define MATRIX_SINGULAR_THRESHOLD 0.00001 //change this if you experience problems with matrices
-			if (fabsf(temp.M[i][i]) <= MATRIX_SINGULAR_THRESHOLD)
-			{
-				final.setIdentity();
-				return false;
-			}
-#undef MATRIX_SINGULAR_THRESHOLD
-			t = 1.0f / temp.M[i][i];
-			for (k = 0; k < n; k++)//m or n
-			{
-				temp.M[i][k] *= t;
-				final.M[i][k] *= t;
-			}
-			for (j = 0; j < m; j++) // m or n
-			{
-				if (j != i)
-				{
-					t = temp.M[j][i];
-					for (k = 0; k < n; k++)//m or n
-					{
-						temp.M[j][k] -= (temp.M[i][k] * t);
-						final.M[j][k] -= (final.M[i][k] * t);
-					}
-				}
-			}
-		}
-		*this = final;
+		return LM_BACKEND::inverse(*this);
+	}
 
-		return true;
+	bool mat4::inverseAffine()
+	{
+		if (!isAffine()) return inverse();
+		return LM_BACKEND::inverseAffine(*this);
 	}
 
 	// orthogonalizes right and top vector from the front vector
@@ -363,6 +334,53 @@ namespace lm {
 		m[12] = m[13] = m[14] = 0; m[15] = 1;
 	}
 
+	// sets the values of this matrix to scale, then rotate, then translate
+	void mat4::makeTransformMatrix(const vec3& translation, const quat& normalized_quat, const vec3& scale) {
+		makeRotationMatrix(normalized_quat);
+		m[0] *= scale.x; m[1] *= scale.x; m[2] *= scale.x;
+		m[4] *= scale.y; m[5] *= scale.y; m[6] *= scale.y;
+		m[8] *= scale.z; m[9] *= scale.z; m[10] *= scale.z;
+		m[12] = translation.x; m[13] = translation.y; m[14] = translation.z;
+	}
+
+	// scale is the length of each base vector, rotation what is left once the
+	// scale is divided out (converted as in Shoemake, "Animating rotation with
+	// quaternion curves", picking the largest component to divide by)
+	void mat4::decompose(vec3& translation, quat& rotation, vec3& scale) const {
+		translation = position();
+		vec3 r = right(), t = top(), f = front();
+		scale = vec3(r.length(), t.length(), f.length());
+		if (r.cross(t).dot(f) < 0.0f) scale.x = -scale.x;
+		if (scale.x == 0.0f || scale.y == 0.0f || scale.z == 0.0f) {
+			rotation = quat();
+			return;
+		}
+		r *= 1.0f / scale.x; t *= 1.0f / scale.y; f *= 1.0f / scale.z;
+
+		//R[row][col] is column col, element row
+		float r00 = r.x, r10 = r.y, r20 = r.z;
+		float r01 = t.x, r11 = t.y, r21 = t.z;
+		float r02 = f.x, r12 = f.y, r22 = f.z;
+		float trace = r00 + r11 + r22;
+		if (trace > 0.0f) {
+			float s = 0.5f / sqrtf(trace + 1.0f);
+			rotation = quat(0.25f / s, (r21 - r12) * s, (r02 - r20) * s, (r10 - r01) * s);
+		}
+		else if (r00 > r11 && r00 > r22) {
+			float s = 2.0f * sqrtf(1.0f + r00 - r11 - r22);
+			rotation = quat((r21 - r12) / s, 0.25f * s, (r01 + r10) / s, (r02 + r20) / s);
+		}
+		else if (r11 > r22) {
+			float s = 2.0f * sqrtf(1.0f + r11 - r00 - r22);
+			rotation = quat((r02 - r20) / s, (r01 + r10) / s, 0.25f * s, (r12 + r21) / s);
+		}
+		else {
+			float s = 2.0f * sqrtf(1.0f + r22 - r00 - r11);
+			rotation = quat((r10 - r01) / s, (r02 + r20) / s, (r12 + r21) / s, 0.25f * s);
+		}
+		rotation.normalize();
+	}
+
 	// sets the values of this matrix to a scale matrix
 	// representing the 3 components of the parameters
 	void mat4::makeScaleMatrix(float x, float y, float z) {
@@ -460,37 +478,13 @@ namespace lm {
 	// multiplies a vec4 with a mat4
 	vec4 mat4::operator*(const vec4& v) const
 	{
-		vec4 ret;
-
-		ret.x = v.x*m[0] + v.y*m[4] + v.z*m[8] + v.w*m[12];
-		ret.y = v.x*m[1] + v.y*m[5] + v.z*m[9] + v.w*m[13];
-		ret.z = v.x*m[2] + v.y*m[6] + v.z*m[10] + v.w*m[14];
-		ret.w = v.x*m[3] + v.y*m[7] + v.z*m[11] + v.w*m[15];
-
-		return ret;
+		return LM_BACKEND::multiply(*this, v);
 	}
 
 	// multiplies column major matrices such that result = this * N
 	mat4 mat4::operator*(const mat4& N) const
 	{
-		mat4 result;
-
-		unsigned int i, j, k;
-		for (i = 0; i < 4; i++) //column
-		{
-			for (j = 0; j < 4; j++) //row
-			{
-				result.M[i][j] = 0.0; //reset
-				for (k = 0; k < 4; k++) {
-					//k-j iterates row
-					//i-k iterates column
-					//this.row * N.column
-					result.M[i][j] += N.M[i][k] * M[k][j];
-				}
-			}
-		}
-
-		return result;
+		return LM_BACKEND::multiply(*this, N);
 	}
 
 	// turns this matrix into a view matrix
@@ -546,4 +540,272 @@ namespace lm {
 		M[3][3] = 1.0f;
 	}
 
+
+	//**************************************
+	// scalar kernels
+	//**************************************
+
+	namespace scalar {
+
+	// multiplies column major matrices such that result = a * b
+	mat4 multiply(const mat4& a, const mat4& b)
+	{
+		mat4 result;
+
+		unsigned int i, j, k;
+		for (i = 0; i < 4; i++) //column
+		{
+			for (j = 0; j < 4; j++) //row
+			{
+				result.M[i][j] = 0.0; //reset
+				for (k = 0; k < 4; k++) {
+					//k-j iterates row
+					//i-k iterates column
+					//a.row * b.column
+					result.M[i][j] += b.M[i][k] * a.M[k][j];
+				}
+			}
+		}
+
+		return result;
+	}
+
+	vec4 multiply(const mat4& a, const vec4& v)
+	{
+		const float* m = a.m;
+		vec4 ret;
+
+		ret.x = v.x*m[0] + v.y*m[4] + v.z*m[8] + v.w*m[12];
+		ret.y = v.x*m[1] + v.y*m[5] + v.z*m[9] + v.w*m[13];
+		ret.z = v.x*m[2] + v.y*m[6] + v.z*m[10] + v.w*m[14];
+		ret.w = v.x*m[3] + v.y*m[7] + v.z*m[11] + v.w*m[15];
+
+		return ret;
+	}
+
+	quat multiply(const quat& a, const quat& b)
+	{
+		return quat(
+			a.w * b.w - a.x * b.x - a.y * b.y - a.z * b.z,
+			a.w * b.x + a.x * b.w + a.y * b.z - a.z * b.y,
+			a.w * b.y - a.x * b.z + a.y * b.w + a.z * b.x,
+			a.w * b.z + a.x  *b.y - a.y * b.x + a.z * b.w
+		);
+	}
+
+	void transpose(mat4& a)
+	{
+		float* m = a.m;
+		std::swap(m[1], m[4]); std::swap(m[2], m[8]); std::swap(m[3], m[12]);
+		std::swap(m[6], m[9]); std::swap(m[7], m[13]); std::swap(m[11], m[14]);
+	}
+
+	bool inverse(mat4& a)
+	{
+		unsigned int i, j, k, swap;
+		float t;
+		mat4 temp, final;
+		final.setIdentity();
+
+		temp = a;
+
+		unsigned int m, n;
+		m = n = 4;
+
+		for (i = 0; i < m; i++)
+		{
+			// Look for largest element in column
+			swap = i;
+			for (j = i + 1; j < m; j++)// m or n
+			{
+				if (fabs(temp.M[j][i]) > fabs(temp.M[swap][i]))
+					swap = j;
+			}
+
+			if (swap != i)
+			{
+				// Swap rows.
+				for (k = 0; k < n; k++)
+				{
+					std::swap(temp.M[i][k], temp.M[swap][k]);
+					std::swap(final.M[i][k], final.M[swap][k]);
+				}
+			}
+			// No non-zero pivot.  The CMatrix is singular, which shouldn't
+			// happen.  This means the user gave us a bad CMatrix.
+#define MATRIX_SINGULAR_THRESHOLD 0.00001 //change this if you experience problems with matrices
+			if (fabsf(temp.M[i][i]) <= MATRIX_SINGULAR_THRESHOLD)
+			{
+				final.setIdentity();
+				return false;
+			}
+#undef MATRIX_SINGULAR_THRESHOLD
+			t = 1.0f / temp.M[i][i];
+			for (k = 0; k < n; k++)//m or n
+			{
+				temp.M[i][k] *= t;
+				final.M[i][k] *= t;
+			}
+			for (j = 0; j < m; j++) // m or n
+			{
+				if (j != i)
+				{
+					t = temp.M[j][i];
+					for (k = 0; k < n; k++)//m or n
+					{
+						temp.M[j][k] -= (temp.M[i][k] * t);
+						final.M[j][k] -= (final.M[i][k] * t);
+					}
+				}
+			}
+		}
+		a = final;
+
+		return true;
+	}
+
+	// the rows of the inverse of the upper 3x3 are the cross products of its
+	// columns divided by the determinant. The inverse translation is the
+	// translation moved back through that inverse
+	bool inverseAffine(mat4& a)
+	{
+		vec3 c0 = a.right(), c1 = a.top(), c2 = a.front(), t = a.position();
+		vec3 r0 = c1.cross(c2), r1 = c2.cross(c0), r2 = c0.cross(c1);
+		float det = c0.dot(r0);
+		if (fabsf(det) < std::numeric_limits<float>::min())
+			return false;
+		float inv_det = 1.0f / det;
+		r0 *= inv_det; r1 *= inv_det; r2 *= inv_det;
+
+		a.M[0][0] = r0.x; a.M[1][0] = r0.y; a.M[2][0] = r0.z;
+		a.M[0][1] = r1.x; a.M[1][1] = r1.y; a.M[2][1] = r1.z;
+		a.M[0][2] = r2.x; a.M[1][2] = r2.y; a.M[2][2] = r2.z;
+		a.M[3][0] = -r0.dot(t);
+		a.M[3][1] = -r1.dot(t);
+		a.M[3][2] = -r2.dot(t);
+		return true;
+	}
+
+	}
+
+	//**************************************
+	// SIMD check
+	//**************************************
+
+	const char* simdBackend() {
+#if LM_AVX2
+		return "AVX2";
+#elif LM_SSE
+		return "SSE";
+#else
+		return "scalar";
+#endif
+	}
+
+	// largest difference between the elements of a and b, relative to b
+	static float relativeError(const float* a, const float* b, int n) {
+		float error = 0.0f;
+		for (int i = 0; i < n; i++)
+			error = std::max(error, fabsf(a[i] - b[i]) / std::max(1.0f, fabsf(b[i])));
+		return error;
+	}
+
+	// times fn(i) over every input, repeats times, and returns ms per repeat.
+	// One untimed pass first, so both versions start with warm caches
+	template<typename F>
+	static double timeInputs(int num_inputs, int repeats, F fn) {
+		for (int i = 0; i < num_inputs; i++)
+			fn(i);
+		auto t0 = std::chrono::high_resolution_clock::now();
+		for (int r = 0; r < repeats; r++)
+			for (int i = 0; i < num_inputs; i++)
+				fn(i);
+		auto t1 = std::chrono::high_resolution_clock::now();
+		return std::chrono::duration<double, std::milli>(t1 - t0).count() / repeats;
+	}
+
+	// times scalar_fn and simd_fn over every input, then takes the largest error
+	template<typename ScalarFn, typename SimdFn, typename ErrorFn>
+	static void checkOp_(SimdCheck& check, const char* name, int num_inputs, int repeats,
+		ScalarFn scalar_fn, SimdFn simd_fn, ErrorFn error) {
+		const double scalar_ms = timeInputs(num_inputs, repeats, scalar_fn);
+		const double simd_ms = timeInputs(num_inputs, repeats, simd_fn);
+		float max_error = 0.0f;
+		for (int i = 0; i < num_inputs; i++)
+			max_error = std::max(max_error, error(i));
+		check.add(name, scalar_ms, simd_ms, max_error);
+	}
+
+	void SimdCheck::add(const char* name, double scalar_ms, double simd_ms, float max_error) {
+		Op op;
+		op.name = name;
+		op.scalar_ms = scalar_ms;
+		op.simd_ms = simd_ms;
+		op.max_error = max_error;
+		ops.push_back(op);
+		if (!(max_error <= tolerance)) passed = false;
+	}
+
+	void SimdCheck::print(const char* title) const {
+		std::cout << title << ": " << backend << ", " << num_inputs << " inputs, tolerance " << tolerance << "\n";
+		for (const Op& op : ops)
+			std::cout << "  " << op.name << ": scalar " << op.scalar_ms << " ms, " << backend << " " << op.simd_ms
+				<< " ms, max error " << op.max_error << (op.max_error <= tolerance ? "" : " (FAILED)") << "\n";
+	}
+
+	SimdCheck checkSimd(int num_inputs, int repeats) {
+		SimdCheck check;
+		check.backend = simdBackend();
+		check.num_inputs = num_inputs = std::max(num_inputs, 1);
+		check.tolerance = 1e-4f;
+		repeats = std::max(repeats, 1);
+
+		//fixed seed, so every run checks the same inputs
+		std::mt19937 rng(1234);
+		std::uniform_real_distribution<float> unit(-1.0f, 1.0f);
+		std::vector<mat4> mats(num_inputs);
+		std::vector<quat> quats(num_inputs);
+		for (int i = 0; i < num_inputs; i++) {
+			vec3 axis(unit(rng), unit(rng), unit(rng) + 2.0f);
+			quats[i] = quat(unit(rng) * 3.0f, axis);
+			mats[i].makeRotationMatrix(quats[i]);
+			mats[i].scaleLocal(1.5f + unit(rng), 1.5f + unit(rng), 1.5f + unit(rng));
+			mats[i].position(10.0f * unit(rng), 10.0f * unit(rng), 10.0f * unit(rng));
+		}
+
+		const int n = num_inputs;
+		std::vector<mat4> mat_scalar(n), mat_simd(n);
+		std::vector<vec4> vec_scalar(n), vec_simd(n);
+		std::vector<quat> quat_scalar(n), quat_simd(n);
+		auto mat_error = [&](int i) { return relativeError(mat_simd[i].m, mat_scalar[i].m, 16); };
+
+		checkOp_(check, "mat4 * mat4", n, repeats,
+			[&](int i) { mat_scalar[i] = scalar::multiply(mats[i], mats[(i + 1) % n]); },
+			[&](int i) { mat_simd[i] = mats[i] * mats[(i + 1) % n]; },
+			mat_error);
+		checkOp_(check, "mat4 * vec4", n, repeats,
+			[&](int i) { vec_scalar[i] = scalar::multiply(mats[i], vec4(mats[(i + 1) % n].position().x, 1.0f, 2.0f, 1.0f)); },
+			[&](int i) { vec_simd[i] = mats[i] * vec4(mats[(i + 1) % n].position().x, 1.0f, 2.0f, 1.0f); },
+			[&](int i) { return relativeError(vec_simd[i].value_, vec_scalar[i].value_, 4); });
+		checkOp_(check, "quat * quat", n, repeats,
+			[&](int i) { quat_scalar[i] = scalar::multiply(quats[i], quats[(i + 1) % n]); },
+			[&](int i) { quat_simd[i] = quats[i] * quats[(i + 1) % n]; },
+			[&](int i) { return relativeError(quat_simd[i].value_, quat_scalar[i].value_, 4); });
+		checkOp_(check, "transpose", n, repeats,
+			[&](int i) { mat_scalar[i] = mats[i]; scalar::transpose(mat_scalar[i]); },
+			[&](int i) { mat_simd[i] = mats[i]; mat_simd[i].transpose(); },
+			mat_error);
+		checkOp_(check, "inverse", n, repeats,
+			[&](int i) { mat_scalar[i] = mats[i]; scalar::inverse(mat_scalar[i]); },
+			[&](int i) { mat_simd[i] = mats[i]; mat_simd[i].inverse(); },
+			mat_error);
+		//scalar column times scalar::inverseAffine, error is against scalar::inverse
+		checkOp_(check, "inverseAffine", n, repeats,
+			[&](int i) { mat_scalar[i] = mats[i]; scalar::inverseAffine(mat_scalar[i]); },
+			[&](int i) { mat_simd[i] = mats[i]; mat_simd[i].inverseAffine(); },
+			[&](int i) { mat_scalar[i] = mats[i]; scalar::inverse(mat_scalar[i]); return mat_error(i); });
+
+		check.print("simd check");
+		return check;
+	}
 }
\ No newline at end of file
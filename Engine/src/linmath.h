@@ -7,6 +7,18 @@
 #include <cmath> //for sqrt (square root) function
 #define DEG2RAD 0.0174532925f
 #include <algorithm>
+#include <vector>
+
+//SIMD backend, chosen at compile time: SSE whenever the target has it (every
+//x64 build), plus AVX2 where the compiler targets it (/arch:AVX2 or -mavx2;
+//the Visual Studio Release|x64 build does). Define LM_NO_SIMD to build the
+//scalar code only
+#if !defined(LM_NO_SIMD) && (defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2))
+#define LM_SSE 1
+#if defined(__AVX2__)
+#define LM_AVX2 1
+#endif
+#endif
 
 namespace lm {
 
@@ -72,7 +84,7 @@ namespace lm {
 
 		vec4& normalize(); //divides 3 component vector by w and returns reference
 
-		void operator *= (float v) { x *= v; y *= v; y *= v; w *= v; }
+		void operator *= (float v) { x *= v; y *= v; z *= v; w *= v; }
 	};
 
 	class quat
@@ -93,8 +105,10 @@ namespace lm {
 		quat inverse() const;
 
 		quat &normalize() { *this *= (1.0f / length()); return *this; }; //both normalizes object and return reference to it
+		//spherical interpolation between unit quaternions, along the shorter arc
+		quat slerp(const quat& end, float percent) const;
 
-		void operator *= (float v) { w *= v; x *= v; y *= v; y *= v;  }
+		void operator *= (float v) { w *= v; x *= v; y *= v; z *= v;  }
 	};
 
 	class mat4 {
@@ -125,7 +139,12 @@ namespace lm {
 		mat4& clear();
 		mat4& setIdentity();
 		mat4& transpose();
-		bool inverse();
+		bool inverse(); //returns false and leaves matrix unchanged if singular
+		//inverse of a matrix whose bottom row is 0 0 0 1 (translation, rotation
+		//and scale, as every Transform), using only the upper 3x3 and the
+		//translation. Much cheaper than inverse(), which it calls for other matrices
+		bool inverseAffine();
+		bool isAffine() const { return m[3] == 0.0f && m[7] == 0.0f && m[11] == 0.0f && m[15] == 1.0f; }
 
 		//get base vectors
 		vec3 right() const { return vec3(m[0], m[1], m[2]); }
@@ -146,6 +165,12 @@ namespace lm {
 		void makeRotationMatrix(const quat& normalized_quat);
 		void makeScaleMatrix(float x, float y, float z);
 		void makeScaleMatrix(const vec3& t);
+		//scale, then rotate, then translate (T * R * S)
+		void makeTransformMatrix(const vec3& translation, const quat& normalized_quat, const vec3& scale);
+
+		//splits a matrix made by makeTransformMatrix back into its parts. Any
+		//shear is lost. A mirrored matrix gets a negative x scale
+		void decompose(vec3& translation, quat& rotation, vec3& scale) const;
 
 		//transform this matrix using world coordinates
 		void translate(float x, float y, float z);
@@ -190,6 +215,45 @@ namespace lm {
 	quat operator * (const quat& a, float v);
 	quat operator * (const quat& a, const quat& b);
 
+	//portable versions of the functions with a SIMD path. The operators and
+	//members above call these when built without SIMD
+	namespace scalar {
+		mat4 multiply(const mat4& a, const mat4& b);
+		vec4 multiply(const mat4& a, const vec4& v);
+		quat multiply(const quat& a, const quat& b);
+		void transpose(mat4& a);
+		bool inverse(mat4& a);
+		bool inverseAffine(mat4& a);
+	}
+
+	//name of backend compiled in: "AVX2", "SSE" or "scalar"
+	const char* simdBackend();
+
+	//runs every SIMD function and its scalar version on the same num_inputs
+	//random matrices (translation, rotation and scale) and quaternions, timing
+	//both and measuring the largest difference relative to the scalar result.
+	//Multiplies and transpose match the scalar code exactly unless the compiler
+	//fuses multiply-adds; the inverses use a different method, so differ by
+	//rounding. inverseAffine is measured against the general scalar inverse
+	struct SimdCheck {
+		struct Op {
+			const char* name = "";
+			double scalar_ms = 0, simd_ms = 0;
+			float max_error = 0;
+		};
+		std::vector<Op> ops;
+		const char* backend = "";
+		int num_inputs = 0;
+		float tolerance = 0;
+		bool passed = true;
+
+		//adds result of op, failing the check if error is above tolerance
+		void add(const char* name, double scalar_ms, double simd_ms, float max_error);
+		//writes results to cout
+		void print(const char* title) const;
+	};
+	SimdCheck checkSimd(int num_inputs, int repeats = 10);
+
     class Utils {
     public:
         template <typename T>
@@ -0,0 +1,414 @@
+//
+//  linmath_batch.cpp
+//
+
+#include "linmath_batch.h"
+#include "linmath_simd.h"
+#include <algorithm>
+#include <random>
+#include <chrono>
+
+namespace lm {
+
+	//**************************************
+	// arrays
+	//**************************************
+
+	static size_t padToLanes(size_t n, size_t lanes) { return (n + lanes - 1) / lanes * lanes; }
+
+	// resizes array to padded size, zeroing the padding
+	static void resizePadded(std::vector<float>& array, size_t n, size_t padded) {
+		array.resize(padded);
+		std::fill(array.begin() + n, array.end(), 0.0f);
+	}
+
+	void vec3Array::resize(size_t n) {
+		const size_t padded = padToLanes(n, LANES);
+		resizePadded(x_, n, padded);
+		resizePadded(y_, n, padded);
+		resizePadded(z_, n, padded);
+		size_ = n;
+	}
+
+	void quatArray::resize(size_t n) {
+		const size_t padded = padToLanes(n, LANES);
+		resizePadded(w_, n, padded);
+		resizePadded(x_, n, padded);
+		resizePadded(y_, n, padded);
+		resizePadded(z_, n, padded);
+		size_ = n;
+	}
+
+	//**************************************
+	// kernels
+	//**************************************
+
+	namespace batch {
+
+	void transformPoints(const mat4& m, const vec3Array& points, vec3Array& out) {
+		out.resize(points.size());
+		const float* px = points.x(); const float* py = points.y(); const float* pz = points.z();
+		float* ox = out.x(); float* oy = out.y(); float* oz = out.z();
+#if LM_AVX2
+		const __m256 m0 = _mm256_set1_ps(m.m[0]), m1 = _mm256_set1_ps(m.m[1]), m2 = _mm256_set1_ps(m.m[2]);
+		const __m256 m4 = _mm256_set1_ps(m.m[4]), m5 = _mm256_set1_ps(m.m[5]), m6 = _mm256_set1_ps(m.m[6]);
+		const __m256 m8 = _mm256_set1_ps(m.m[8]), m9 = _mm256_set1_ps(m.m[9]), m10 = _mm256_set1_ps(m.m[10]);
+		const __m256 m12 = _mm256_set1_ps(m.m[12]), m13 = _mm256_set1_ps(m.m[13]), m14 = _mm256_set1_ps(m.m[14]);
+		for (size_t i = 0; i < points.paddedSize(); i += 8) {
+			const __m256 x = _mm256_loadu_ps(px + i), y = _mm256_loadu_ps(py + i), z = _mm256_loadu_ps(pz + i);
+			_mm256_storeu_ps(ox + i, _mm256_add_ps(_mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(x, m0), _mm256_mul_ps(y, m4)), _mm256_mul_ps(z, m8)), m12));
+			_mm256_storeu_ps(oy + i, _mm256_add_ps(_mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(x, m1), _mm256_mul_ps(y, m5)), _mm256_mul_ps(z, m9)), m13));
+			_mm256_storeu_ps(oz + i, _mm256_add_ps(_mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(x, m2), _mm256_mul_ps(y, m6)), _mm256_mul_ps(z, m10)), m14));
+		}
+#else
+		for (size_t i = 0; i < points.paddedSize(); i++) {
+			ox[i] = px[i] * m.m[0] + py[i] * m.m[4] + pz[i] * m.m[8] + m.m[12];
+			oy[i] = px[i] * m.m[1] + py[i] * m.m[5] + pz[i] * m.m[9] + m.m[13];
+			oz[i] = px[i] * m.m[2] + py[i] * m.m[6] + pz[i] * m.m[10] + m.m[14];
+		}
+#endif
+	}
+
+	void multiply(const mat4* a, const mat4* b, mat4* out, size_t n) {
+		for (size_t i = 0; i < n; i++) {
+#if LM_SSE
+			out[i] = simd::multiply(a[i], b[i]);
+#else
+			out[i] = scalar::multiply(a[i], b[i]);
+#endif
+		}
+	}
+
+	// the center moves as a point. Each half width of the new box is the sum of
+	// the old half widths scaled by the absolute matrix elements (Arvo,
+	// "Transforming axis-aligned bounding boxes")
+	void transformAABBs(const mat4* matrices, const int* indices,
+		const vec3Array& centers, const vec3Array& half_widths,
+		vec3Array& out_centers, vec3Array& out_half_widths) {
+		const size_t n = centers.size();
+		out_centers.resize(n);
+		out_half_widths.resize(n);
+		if (n == 0) return;
+		const float* cx = centers.x(); const float* cy = centers.y(); const float* cz = centers.z();
+		const float* hx = half_widths.x(); const float* hy = half_widths.y(); const float* hz = half_widths.z();
+		float* ocx = out_centers.x(); float* ocy = out_centers.y(); float* ocz = out_centers.z();
+		float* ohx = out_half_widths.x(); float* ohy = out_half_widths.y(); float* ohz = out_half_widths.z();
+#if LM_AVX2
+		const __m256 abs_mask = _mm256_castsi256_ps(_mm256_set1_epi32(0x7fffffff));
+		const float* base = matrices[0].m;
+		for (size_t i = 0; i < centers.paddedSize(); i += 8) {
+			//offset in floats of each box's matrix. Padding uses the first matrix
+			alignas(32) int offsets[8];
+			for (size_t l = 0; l < 8; l++) {
+				const size_t box = i + l;
+				offsets[l] = box < n ? (indices ? indices[box] : (int)box) * 16 : 0;
+			}
+			const __m256i offset = _mm256_load_si256((const __m256i*)offsets);
+			const __m256 m0 = _mm256_i32gather_ps(base + 0, offset, 4), m1 = _mm256_i32gather_ps(base + 1, offset, 4);
+			const __m256 m2 = _mm256_i32gather_ps(base + 2, offset, 4), m4 = _mm256_i32gather_ps(base + 4, offset, 4);
+			const __m256 m5 = _mm256_i32gather_ps(base + 5, offset, 4), m6 = _mm256_i32gather_ps(base + 6, offset, 4);
+			const __m256 m8 = _mm256_i32gather_ps(base + 8, offset, 4), m9 = _mm256_i32gather_ps(base + 9, offset, 4);
+			const __m256 m10 = _mm256_i32gather_ps(base + 10, offset, 4), m12 = _mm256_i32gather_ps(base + 12, offset, 4);
+			const __m256 m13 = _mm256_i32gather_ps(base + 13, offset, 4), m14 = _mm256_i32gather_ps(base + 14, offset, 4);
+
+			const __m256 x = _mm256_loadu_ps(cx + i), y = _mm256_loadu_ps(cy + i), z = _mm256_loadu_ps(cz + i);
+			_mm256_storeu_ps(ocx + i, _mm256_add_ps(_mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(x, m0), _mm256_mul_ps(y, m4)), _mm256_mul_ps(z, m8)), m12));
+			_mm256_storeu_ps(ocy + i, _mm256_add_ps(_mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(x, m1), _mm256_mul_ps(y, m5)), _mm256_mul_ps(z, m9)), m13));
+			_mm256_storeu_ps(ocz + i, _mm256_add_ps(_mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(x, m2), _mm256_mul_ps(y, m6)), _mm256_mul_ps(z, m10)), m14));
+
+			const __m256 w = _mm256_loadu_ps(hx + i), h = _mm256_loadu_ps(hy + i), d = _mm256_loadu_ps(hz + i);
+			_mm256_storeu_ps(ohx + i, _mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(w, _mm256_and_ps(m0, abs_mask)),
+				_mm256_mul_ps(h, _mm256_and_ps(m4, abs_mask))), _mm256_mul_ps(d, _mm256_and_ps(m8, abs_mask))));
+			_mm256_storeu_ps(ohy + i, _mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(w, _mm256_and_ps(m1, abs_mask)),
+				_mm256_mul_ps(h, _mm256_and_ps(m5, abs_mask))), _mm256_mul_ps(d, _mm256_and_ps(m9, abs_mask))));
+			_mm256_storeu_ps(ohz + i, _mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(w, _mm256_and_ps(m2, abs_mask)),
+				_mm256_mul_ps(h, _mm256_and_ps(m6, abs_mask))), _mm256_mul_ps(d, _mm256_and_ps(m10, abs_mask))));
+		}
+#else
+		for (size_t i = 0; i < n; i++) {
+			const float* m = matrices[indices ? indices[i] : i].m;
+			ocx[i] = cx[i] * m[0] + cy[i] * m[4] + cz[i] * m[8] + m[12];
+			ocy[i] = cx[i] * m[1] + cy[i] * m[5] + cz[i] * m[9] + m[13];
+			ocz[i] = cx[i] * m[2] + cy[i] * m[6] + cz[i] * m[10] + m[14];
+			ohx[i] = hx[i] * fabsf(m[0]) + hy[i] * fabsf(m[4]) + hz[i] * fabsf(m[8]);
+			ohy[i] = hx[i] * fabsf(m[1]) + hy[i] * fabsf(m[5]) + hz[i] * fabsf(m[9]);
+			ohz[i] = hx[i] * fabsf(m[2]) + hy[i] * fabsf(m[6]) + hz[i] * fabsf(m[10]);
+		}
+#endif
+	}
+
+	// planes from the rows of view_projection (Gribb and Hartmann): a point is
+	// inside when -w < x < w, and so on for y and z, so each plane is row 3 plus
+	// or minus row 0, 1 or 2. A box is outside a plane if its corner furthest
+	// along the plane normal is behind it
+	void cullAABBs(const mat4& view_projection, const vec3Array& centers,
+		const vec3Array& half_widths, uint8_t* visible) {
+		float planes[6][4];
+		for (int p = 0; p < 6; p++) {
+			const int row = p / 2;
+			const float sign = p % 2 ? -1.0f : 1.0f;
+			for (int c = 0; c < 4; c++)
+				planes[p][c] = view_projection.M[c][3] + sign * view_projection.M[c][row];
+		}
+
+		const size_t n = centers.size();
+		const float* cx = centers.x(); const float* cy = centers.y(); const float* cz = centers.z();
+		const float* hx = half_widths.x(); const float* hy = half_widths.y(); const float* hz = half_widths.z();
+#if LM_AVX2
+		const __m256 zero = _mm256_setzero_ps();
+		for (size_t i = 0; i < n; i += 8) {
+			const __m256 x = _mm256_loadu_ps(cx + i), y = _mm256_loadu_ps(cy + i), z = _mm256_loadu_ps(cz + i);
+			const __m256 w = _mm256_loadu_ps(hx + i), h = _mm256_loadu_ps(hy + i), d = _mm256_loadu_ps(hz + i);
+			__m256 outside = zero;
+			for (int p = 0; p < 6; p++) {
+				const float* plane = planes[p];
+				__m256 dist = _mm256_add_ps(_mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(x, _mm256_set1_ps(plane[0])),
+					_mm256_mul_ps(y, _mm256_set1_ps(plane[1]))), _mm256_mul_ps(z, _mm256_set1_ps(plane[2]))), _mm256_set1_ps(plane[3]));
+				dist = _mm256_add_ps(dist, _mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(w, _mm256_set1_ps(fabsf(plane[0]))),
+					_mm256_mul_ps(h, _mm256_set1_ps(fabsf(plane[1])))), _mm256_mul_ps(d, _mm256_set1_ps(fabsf(plane[2])))));
+				outside = _mm256_or_ps(outside, _mm256_cmp_ps(dist, zero, _CMP_LT_OQ));
+			}
+			const int outside_bits = _mm256_movemask_ps(outside);
+			for (size_t l = 0; l < 8 && i + l < n; l++)
+				visible[i + l] = (outside_bits >> l) & 1 ? 0 : 1;
+		}
+#else
+		for (size_t i = 0; i < n; i++) {
+			bool outside = false;
+			for (int p = 0; p < 6; p++) {
+				const float* plane = planes[p];
+				const float dist = cx[i] * plane[0] + cy[i] * plane[1] + cz[i] * plane[2] + plane[3] +
+					(hx[i] * fabsf(plane[0]) + hy[i] * fabsf(plane[1]) + hz[i] * fabsf(plane[2]));
+				outside = outside || dist < 0.0f;
+			}
+			visible[i] = outside ? 0 : 1;
+		}
+#endif
+	}
+
+	// lerp by a corrected t, then normalize. The correction is a cubic in t
+	// whose coefficients are polynomials fitted to the angle between a and b
+	void slerp(const quatArray& a, const quatArray& b, const float* t, quatArray& out) {
+		out.resize(a.size());
+		const float* aw = a.w(); const float* ax = a.x(); const float* ay = a.y(); const float* az = a.z();
+		const float* bw = b.w(); const float* bx = b.x(); const float* by = b.y(); const float* bz = b.z();
+		float* ow = out.w(); float* ox = out.x(); float* oy = out.y(); float* oz = out.z();
+#if LM_AVX2
+		const __m256 sign_mask = _mm256_set1_ps(-0.0f);
+		const __m256 one = _mm256_set1_ps(1.0f), half = _mm256_set1_ps(0.5f);
+		for (size_t i = 0; i < a.paddedSize(); i += 8) {
+			const __m256 qaw = _mm256_loadu_ps(aw + i), qax = _mm256_loadu_ps(ax + i), qay = _mm256_loadu_ps(ay + i), qaz = _mm256_loadu_ps(az + i);
+			const __m256 qbw = _mm256_loadu_ps(bw + i), qbx = _mm256_loadu_ps(bx + i), qby = _mm256_loadu_ps(by + i), qbz = _mm256_loadu_ps(bz + i);
+			const __m256 ca = _mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(qaw, qbw), _mm256_mul_ps(qax, qbx)),
+				_mm256_add_ps(_mm256_mul_ps(qay, qby), _mm256_mul_ps(qaz, qbz)));
+			const __m256 d = _mm256_andnot_ps(sign_mask, ca);
+			//A = 1.0904 + d * (-3.2452 + d * (3.55645 - d * 1.43519))
+			__m256 A = _mm256_sub_ps(_mm256_set1_ps(3.55645f), _mm256_mul_ps(d, _mm256_set1_ps(1.43519f)));
+			A = _mm256_add_ps(_mm256_set1_ps(-3.2452f), _mm256_mul_ps(d, A));
+			A = _mm256_add_ps(_mm256_set1_ps(1.0904f), _mm256_mul_ps(d, A));
+			//B = 0.848013 + d * (-1.06021 + d * 0.215638)
+			__m256 B = _mm256_add_ps(_mm256_set1_ps(-1.06021f), _mm256_mul_ps(d, _mm256_set1_ps(0.215638f)));
+			B = _mm256_add_ps(_mm256_set1_ps(0.848013f), _mm256_mul_ps(d, B));
+
+			const __m256 tt = _mm256_loadu_ps(t + i);
+			const __m256 th = _mm256_sub_ps(tt, half);
+			const __m256 k = _mm256_add_ps(_mm256_mul_ps(A, _mm256_mul_ps(th, th)), B);
+			const __m256 ot = _mm256_add_ps(tt, _mm256_mul_ps(_mm256_mul_ps(_mm256_mul_ps(tt, th), _mm256_sub_ps(tt, one)), k));
+			const __m256 la = _mm256_sub_ps(one, ot);
+			//negate b's weight if the quaternions are more than 90 degrees apart
+			const __m256 lb = _mm256_xor_ps(ot, _mm256_and_ps(ca, sign_mask));
+
+			const __m256 rw = _mm256_add_ps(_mm256_mul_ps(qaw, la), _mm256_mul_ps(qbw, lb));
+			const __m256 rx = _mm256_add_ps(_mm256_mul_ps(qax, la), _mm256_mul_ps(qbx, lb));
+			const __m256 ry = _mm256_add_ps(_mm256_mul_ps(qay, la), _mm256_mul_ps(qby, lb));
+			const __m256 rz = _mm256_add_ps(_mm256_mul_ps(qaz, la), _mm256_mul_ps(qbz, lb));
+			__m256 length = _mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(rw, rw), _mm256_mul_ps(rx, rx)),
+				_mm256_add_ps(_mm256_mul_ps(ry, ry), _mm256_mul_ps(rz, rz)));
+			//padding lanes are all zero, keep them finite
+			length = _mm256_sqrt_ps(_mm256_max_ps(length, _mm256_set1_ps(std::numeric_limits<float>::min())));
+			const __m256 inv_length = _mm256_div_ps(one, length);
+			_mm256_storeu_ps(ow + i, _mm256_mul_ps(rw, inv_length));
+			_mm256_storeu_ps(ox + i, _mm256_mul_ps(rx, inv_length));
+			_mm256_storeu_ps(oy + i, _mm256_mul_ps(ry, inv_length));
+			_mm256_storeu_ps(oz + i, _mm256_mul_ps(rz, inv_length));
+		}
+#else
+		for (size_t i = 0; i < a.size(); i++) {
+			const float ca = aw[i] * bw[i] + ax[i] * bx[i] + (ay[i] * by[i] + az[i] * bz[i]);
+			const float d = fabsf(ca);
+			const float A = 1.0904f + d * (-3.2452f + d * (3.55645f - d * 1.43519f));
+			const float B = 0.848013f + d * (-1.06021f + d * 0.215638f);
+			const float th = t[i] - 0.5f;
+			const float k = A * th * th + B;
+			const float ot = t[i] + t[i] * th * (t[i] - 1.0f) * k;
+			const float la = 1.0f - ot;
+			const float lb = ca < 0.0f ? -ot : ot;
+			quat r(aw[i] * la + bw[i] * lb, ax[i] * la + bx[i] * lb, ay[i] * la + by[i] * lb, az[i] * la + bz[i] * lb);
+			r.normalize();
+			ow[i] = r.w; ox[i] = r.x; oy[i] = r.y; oz[i] = r.z;
+		}
+#endif
+	}
+
+	}
+
+	//**************************************
+	// batch check
+	//**************************************
+
+	// runs fn once untimed, so caches are warm, then repeats times, and returns
+	// ms per run
+	template<typename F>
+	static double timeRuns(int repeats, F fn) {
+		fn();
+		auto t0 = std::chrono::high_resolution_clock::now();
+		for (int r = 0; r < repeats; r++)
+			fn();
+		auto t1 = std::chrono::high_resolution_clock::now();
+		return std::chrono::duration<double, std::milli>(t1 - t0).count() / repeats;
+	}
+
+	static float relativeError(float a, float b) {
+		return fabsf(a - b) / std::max(1.0f, fabsf(b));
+	}
+
+	SimdCheck checkBatch(int num_inputs, int repeats) {
+		SimdCheck check;
+		check.backend = simdBackend();
+		const int n = check.num_inputs = std::max(num_inputs, 1);
+		//slerp is approximated, everything else differs by rounding at most
+		check.tolerance = 2e-3f;
+		repeats = std::max(repeats, 1);
+
+		//fixed seed, so every run checks the same inputs
+		std::mt19937 rng(4321);
+		std::uniform_real_distribution<float> unit(-1.0f, 1.0f);
+		mat4 m;
+		m.makeTransformMatrix(vec3(1, 2, 3), quat(0.5f, vec3(1, 1, 0).normalize()), vec3(2, 2, 2));
+		mat4 view_projection, view;
+		view_projection.perspective(60.0f * DEG2RAD, 1.5f, 0.1f, 100.0f);
+		view.lookAt(vec3(0, 0, 0), vec3(0.3f, 0.1f, -1.0f), vec3(0, 1, 0));
+		view_projection = view_projection * view;
+
+		std::vector<vec3> points(n), half_widths(n);
+		std::vector<mat4> mats(n);
+		std::vector<int> indices(n);
+		std::vector<quat> quats_a(n), quats_b(n);
+		std::vector<float> t(n + vec3Array::LANES, 0.0f);
+		vec3Array points_soa, half_widths_soa;
+		quatArray quats_a_soa, quats_b_soa;
+		points_soa.resize(n); half_widths_soa.resize(n);
+		quats_a_soa.resize(n); quats_b_soa.resize(n);
+		for (int i = 0; i < n; i++) {
+			points[i] = vec3(60.0f * unit(rng), 60.0f * unit(rng), 60.0f * unit(rng));
+			half_widths[i] = vec3(3.0f + 2.5f * unit(rng), 3.0f + 2.5f * unit(rng), 3.0f + 2.5f * unit(rng));
+			mats[i].makeTransformMatrix(vec3(unit(rng), unit(rng), unit(rng)), quat(3.0f * unit(rng), vec3(unit(rng), 1.0f, unit(rng)).normalize()),
+				vec3(1.5f + unit(rng), 1.5f + unit(rng), 1.5f + unit(rng)));
+			indices[i] = (int)(rng() % n);
+			quats_a[i] = quat(3.0f * unit(rng), vec3(unit(rng), unit(rng), 1.0f).normalize());
+			quats_b[i] = quat(3.0f * unit(rng), vec3(1.0f, unit(rng), unit(rng)).normalize());
+			t[i] = 0.5f + 0.5f * unit(rng);
+			points_soa.set(i, points[i]);
+			half_widths_soa.set(i, half_widths[i]);
+			quats_a_soa.set(i, quats_a[i]);
+			quats_b_soa.set(i, quats_b[i]);
+		}
+
+		//transform points
+		std::vector<vec3> points_out(n);
+		vec3Array points_out_soa;
+		double scalar_ms = timeRuns(repeats, [&]() { for (int i = 0; i < n; i++) points_out[i] = m * points[i]; });
+		double batch_ms = timeRuns(repeats, [&]() { batch::transformPoints(m, points_soa, points_out_soa); });
+		float error = 0.0f;
+		for (int i = 0; i < n; i++) {
+			const vec3 p = points_out_soa.get(i);
+			error = std::max(error, std::max(relativeError(p.x, points_out[i].x), std::max(relativeError(p.y, points_out[i].y), relativeError(p.z, points_out[i].z))));
+		}
+		check.add("transformPoints", scalar_ms, batch_ms, error);
+
+		//multiply
+		std::vector<mat4> mats_out(n), mats_out_batch(n);
+		scalar_ms = timeRuns(repeats, [&]() { for (int i = 0; i < n; i++) mats_out[i] = mats[i] * mats[indices[i]]; });
+		std::vector<mat4> mats_b(n);
+		for (int i = 0; i < n; i++) mats_b[i] = mats[indices[i]];
+		batch_ms = timeRuns(repeats, [&]() { batch::multiply(mats.data(), mats_b.data(), mats_out_batch.data(), n); });
+		error = 0.0f;
+		for (int i = 0; i < n; i++)
+			for (int k = 0; k < 16; k++)
+				error = std::max(error, relativeError(mats_out_batch[i].m[k], mats_out[i].m[k]));
+		check.add("multiply", scalar_ms, batch_ms, error);
+
+		//transform boxes: the per value version transforms all eight corners
+		std::vector<vec3> box_min(n), box_max(n);
+		scalar_ms = timeRuns(repeats, [&]() {
+			for (int i = 0; i < n; i++) {
+				const mat4& box_matrix = mats[indices[i]];
+				vec3 lo(1e30f, 1e30f, 1e30f), hi(-1e30f, -1e30f, -1e30f);
+				for (int c = 0; c < 8; c++) {
+					const vec3 corner = box_matrix * vec3(points[i].x + (c & 1 ? half_widths[i].x : -half_widths[i].x),
+						points[i].y + (c & 2 ? half_widths[i].y : -half_widths[i].y),
+						points[i].z + (c & 4 ? half_widths[i].z : -half_widths[i].z));
+					lo = vec3(std::min(lo.x, corner.x), std::min(lo.y, corner.y), std::min(lo.z, corner.z));
+					hi = vec3(std::max(hi.x, corner.x), std::max(hi.y, corner.y), std::max(hi.z, corner.z));
+				}
+				box_min[i] = lo; box_max[i] = hi;
+			}
+		});
+		vec3Array box_centers, box_half_widths;
+		batch_ms = timeRuns(repeats, [&]() {
+			batch::transformAABBs(mats.data(), indices.data(), points_soa, half_widths_soa, box_centers, box_half_widths);
+		});
+		error = 0.0f;
+		for (int i = 0; i < n; i++) {
+			const vec3 c = box_centers.get(i), h = box_half_widths.get(i);
+			error = std::max(error, std::max(relativeError(c.x - h.x, box_min[i].x), relativeError(c.x + h.x, box_max[i].x)));
+			error = std::max(error, std::max(relativeError(c.y - h.y, box_min[i].y), relativeError(c.y + h.y, box_max[i].y)));
+			error = std::max(error, std::max(relativeError(c.z - h.z, box_min[i].z), relativeError(c.z + h.z, box_max[i].z)));
+		}
+		check.add("transformAABBs", scalar_ms, batch_ms, error);
+
+		//cull boxes: the per value version tests the corners in clip space. The
+		//error is the fraction of boxes on which the two disagree
+		std::vector<uint8_t> visible(n), visible_batch(n);
+		scalar_ms = timeRuns(repeats, [&]() {
+			for (int i = 0; i < n; i++) {
+				int outside[6] = { 0, 0, 0, 0, 0, 0 };
+				for (int c = 0; c < 8; c++) {
+					const vec4 clip = view_projection * vec4(points[i].x + (c & 1 ? half_widths[i].x : -half_widths[i].x),
+						points[i].y + (c & 2 ? half_widths[i].y : -half_widths[i].y),
+						points[i].z + (c & 4 ? half_widths[i].z : -half_widths[i].z), 1.0f);
+					outside[0] += clip.x < -clip.w; outside[1] += clip.x > clip.w;
+					outside[2] += clip.y < -clip.w; outside[3] += clip.y > clip.w;
+					outside[4] += clip.z < -clip.w; outside[5] += clip.z > clip.w;
+				}
+				visible[i] = 1;
+				for (int p = 0; p < 6; p++)
+					if (outside[p] == 8) visible[i] = 0;
+			}
+		});
+		batch_ms = timeRuns(repeats, [&]() { batch::cullAABBs(view_projection, points_soa, half_widths_soa, visible_batch.data()); });
+		int mismatches = 0;
+		for (int i = 0; i < n; i++)
+			mismatches += visible[i] != visible_batch[i];
+		check.add("cullAABBs", scalar_ms, batch_ms, (float)mismatches / n);
+
+		//slerp
+		std::vector<quat> quats_out(n);
+		quatArray quats_out_soa;
+		scalar_ms = timeRuns(repeats, [&]() { for (int i = 0; i < n; i++) quats_out[i] = quats_a[i].slerp(quats_b[i], t[i]); });
+		batch_ms = timeRuns(repeats, [&]() { batch::slerp(quats_a_soa, quats_b_soa, t.data(), quats_out_soa); });
+		error = 0.0f;
+		for (int i = 0; i < n; i++) {
+			quat q = quats_out_soa.get(i);
+			//q and -q are the same rotation
+			const float dot = q.w * quats_out[i].w + q.x * quats_out[i].x + q.y * quats_out[i].y + q.z * quats_out[i].z;
+			if (dot < 0.0f) q *= -1.0f;
+			for (int k = 0; k < 4; k++)
+				error = std::max(error, relativeError(q.value_[k], quats_out[i].value_[k]));
+		}
+		check.add("slerp", scalar_ms, batch_ms, error);
+
+		check.print("batch check");
+		return check;
+	}
+}
@@ -0,0 +1,106 @@
+//
+//  linmath_batch.h
+//
+//  Math kernels over whole arrays, for loops which apply one operation to many
+//  values (culling, animation sampling). Values are stored as structure of
+//  arrays (all x, then all y...), so with AVX2 eight of them fill a register
+//  and each instruction works on eight values. Arrays are padded to a multiple
+//  of 8 with zeros; kernels compute the padding too and it is ignored.
+//  Without AVX2 the kernels are plain loops over the arrays, which compilers
+//  vectorize with SSE.
+//  Usage:
+//      lm::vec3Array points, out;
+//      points.resize(n);
+//      for (size_t i = 0; i < n; i++) points.set(i, p[i]);
+//      lm::batch::transformPoints(model, points, out);
+//
+#pragma once
+#include "linmath.h"
+#include <vector>
+#include <cstddef>
+#include <cstdint>
+
+namespace lm {
+
+	//vec3s as three float arrays
+	class vec3Array {
+	public:
+		static const size_t LANES = 8;
+
+		size_t size() const { return size_; }
+		//size rounded up to a multiple of LANES
+		size_t paddedSize() const { return x_.size(); }
+		void resize(size_t n);
+
+		vec3 get(size_t i) const { return vec3(x_[i], y_[i], z_[i]); }
+		void set(size_t i, const vec3& v) { x_[i] = v.x; y_[i] = v.y; z_[i] = v.z; }
+
+		float* x() { return x_.data(); }
+		float* y() { return y_.data(); }
+		float* z() { return z_.data(); }
+		const float* x() const { return x_.data(); }
+		const float* y() const { return y_.data(); }
+		const float* z() const { return z_.data(); }
+
+	private:
+		std::vector<float> x_, y_, z_;
+		size_t size_ = 0;
+	};
+
+	//quats as four float arrays
+	class quatArray {
+	public:
+		static const size_t LANES = 8;
+
+		size_t size() const { return size_; }
+		size_t paddedSize() const { return w_.size(); }
+		void resize(size_t n);
+
+		quat get(size_t i) const { return quat(w_[i], x_[i], y_[i], z_[i]); }
+		void set(size_t i, const quat& q) { w_[i] = q.w; x_[i] = q.x; y_[i] = q.y; z_[i] = q.z; }
+
+		float* w() { return w_.data(); }
+		float* x() { return x_.data(); }
+		float* y() { return y_.data(); }
+		float* z() { return z_.data(); }
+		const float* w() const { return w_.data(); }
+		const float* x() const { return x_.data(); }
+		const float* y() const { return y_.data(); }
+		const float* z() const { return z_.data(); }
+
+	private:
+		std::vector<float> w_, x_, y_, z_;
+		size_t size_ = 0;
+	};
+
+	namespace batch {
+		//out[i] = m * points[i], points with w = 1. Same sums as mat4 * vec3
+		void transformPoints(const mat4& m, const vec3Array& points, vec3Array& out);
+
+		//out[i] = a[i] * b[i]. Matrices stay one after another, as the engine
+		//stores them, and each product uses the SIMD mat4 multiply
+		void multiply(const mat4* a, const mat4* b, mat4* out, size_t n);
+
+		//axis aligned box around box i (center, half width) once transformed by
+		//matrices[indices[i]], or matrices[i] if indices is null. With AVX2 the
+		//matrix elements of eight boxes are gathered into registers
+		void transformAABBs(const mat4* matrices, const int* indices,
+			const vec3Array& centers, const vec3Array& half_widths,
+			vec3Array& out_centers, vec3Array& out_half_widths);
+
+		//visible[i] = 1 if box i is at least partly inside the frustum of
+		//view_projection, else 0. visible must hold centers.size() values
+		void cullAABBs(const mat4& view_projection, const vec3Array& centers,
+			const vec3Array& half_widths, uint8_t* visible);
+
+		//out[i] = a[i] towards b[i] by t[i] along the shorter arc. Replaces the
+		//trigonometry of quat::slerp with a fitted correction of a normalized
+		//lerp (Kapoulkine, "Approximating slerp"), which keeps the angle within
+		//about 1e-3 of exact. t must hold a.paddedSize() values
+		void slerp(const quatArray& a, const quatArray& b, const float* t, quatArray& out);
+	}
+
+	//times each kernel against a loop of the single value lm functions on the
+	//same num_inputs random values, and checks they agree (see SimdCheck)
+	SimdCheck checkBatch(int num_inputs, int repeats = 10);
+}
@@ -0,0 +1,214 @@
+//
+//  linmath_simd.h
+//
+//  SSE/AVX2 versions of the lm functions which have a SIMD path, shared by
+//  linmath.cpp and linmath_batch.cpp. Other code includes linmath.h, whose
+//  functions pick these or the scalar ones at compile time.
+//  A mat4 column (or vec4, or quat) is one __m128. mat4 (and so Transform) is
+//  not 16 byte aligned, so everything is loaded and stored unaligned
+//
+#pragma once
+#include "linmath.h"
+#include <cmath>
+#include <limits>
+#if LM_SSE
+#include <emmintrin.h>
+#endif
+#if LM_AVX2
+#include <immintrin.h>
+#endif
+
+#if LM_SSE
+namespace lm {
+
+	namespace simd {
+
+	inline __m128 splat(__m128 v, int i) {
+		switch (i) {
+		case 0: return _mm_shuffle_ps(v, v, _MM_SHUFFLE(0, 0, 0, 0));
+		case 1: return _mm_shuffle_ps(v, v, _MM_SHUFFLE(1, 1, 1, 1));
+		case 2: return _mm_shuffle_ps(v, v, _MM_SHUFFLE(2, 2, 2, 2));
+		default: return _mm_shuffle_ps(v, v, _MM_SHUFFLE(3, 3, 3, 3));
+		}
+	}
+
+	// lanes yzx of a 3 component vector (w stays in lane 3)
+	inline __m128 yzx(__m128 v) { return _mm_shuffle_ps(v, v, _MM_SHUFFLE(3, 0, 2, 1)); }
+
+	inline __m128 cross(__m128 a, __m128 b) {
+		return yzx(_mm_sub_ps(_mm_mul_ps(a, yzx(b)), _mm_mul_ps(yzx(a), b)));
+	}
+
+	// columns of a times b, summed in the same order as the scalar code
+	inline __m128 combine(__m128 a0, __m128 a1, __m128 a2, __m128 a3, __m128 b) {
+		__m128 r = _mm_mul_ps(splat(b, 0), a0);
+		r = _mm_add_ps(r, _mm_mul_ps(splat(b, 1), a1));
+		r = _mm_add_ps(r, _mm_mul_ps(splat(b, 2), a2));
+		return _mm_add_ps(r, _mm_mul_ps(splat(b, 3), a3));
+	}
+
+	// column i of result is the columns of a weighted by column i of b
+	inline mat4 multiply(const mat4& a, const mat4& b)
+	{
+		mat4 result;
+#if LM_AVX2
+		// two result columns per 256 bit register, a column of a in both halves
+		const __m128 a0 = _mm_loadu_ps(a.m), a1 = _mm_loadu_ps(a.m + 4);
+		const __m128 a2 = _mm_loadu_ps(a.m + 8), a3 = _mm_loadu_ps(a.m + 12);
+		const __m256 aa0 = _mm256_insertf128_ps(_mm256_castps128_ps256(a0), a0, 1);
+		const __m256 aa1 = _mm256_insertf128_ps(_mm256_castps128_ps256(a1), a1, 1);
+		const __m256 aa2 = _mm256_insertf128_ps(_mm256_castps128_ps256(a2), a2, 1);
+		const __m256 aa3 = _mm256_insertf128_ps(_mm256_castps128_ps256(a3), a3, 1);
+		for (int i = 0; i < 4; i += 2) {
+			const __m256 bb = _mm256_loadu_ps(b.m + 4 * i);
+			__m256 r = _mm256_mul_ps(_mm256_permute_ps(bb, _MM_SHUFFLE(0, 0, 0, 0)), aa0);
+			r = _mm256_add_ps(r, _mm256_mul_ps(_mm256_permute_ps(bb, _MM_SHUFFLE(1, 1, 1, 1)), aa1));
+			r = _mm256_add_ps(r, _mm256_mul_ps(_mm256_permute_ps(bb, _MM_SHUFFLE(2, 2, 2, 2)), aa2));
+			r = _mm256_add_ps(r, _mm256_mul_ps(_mm256_permute_ps(bb, _MM_SHUFFLE(3, 3, 3, 3)), aa3));
+			_mm256_storeu_ps(result.m + 4 * i, r);
+		}
+#else
+		const __m128 a0 = _mm_loadu_ps(a.m), a1 = _mm_loadu_ps(a.m + 4);
+		const __m128 a2 = _mm_loadu_ps(a.m + 8), a3 = _mm_loadu_ps(a.m + 12);
+		for (int i = 0; i < 4; i++)
+			_mm_storeu_ps(result.m + 4 * i, combine(a0, a1, a2, a3, _mm_loadu_ps(b.m + 4 * i)));
+#endif
+		return result;
+	}
+
+	inline vec4 multiply(const mat4& a, const vec4& v)
+	{
+		vec4 ret;
+		_mm_storeu_ps(ret.value_, combine(_mm_loadu_ps(a.m), _mm_loadu_ps(a.m + 4),
+			_mm_loadu_ps(a.m + 8), _mm_loadu_ps(a.m + 12), _mm_loadu_ps(v.value_)));
+		return ret;
+	}
+
+	// quat is stored w x y z. Each component of a scales a permutation of b,
+	// with signs flipped as in the scalar formula, so the sums are the same
+	inline quat multiply(const quat& a, const quat& b)
+	{
+		const __m128 va = _mm_loadu_ps(a.value_), vb = _mm_loadu_ps(b.value_);
+		const __m128 sign_x = _mm_setr_ps(-0.0f, 0.0f, -0.0f, 0.0f);
+		const __m128 sign_y = _mm_setr_ps(-0.0f, 0.0f, 0.0f, -0.0f);
+		const __m128 sign_z = _mm_setr_ps(-0.0f, -0.0f, 0.0f, 0.0f);
+		__m128 r = _mm_mul_ps(splat(va, 0), vb);
+		r = _mm_add_ps(r, _mm_mul_ps(splat(va, 1), _mm_xor_ps(_mm_shuffle_ps(vb, vb, _MM_SHUFFLE(2, 3, 0, 1)), sign_x)));
+		r = _mm_add_ps(r, _mm_mul_ps(splat(va, 2), _mm_xor_ps(_mm_shuffle_ps(vb, vb, _MM_SHUFFLE(1, 0, 3, 2)), sign_y)));
+		r = _mm_add_ps(r, _mm_mul_ps(splat(va, 3), _mm_xor_ps(_mm_shuffle_ps(vb, vb, _MM_SHUFFLE(0, 1, 2, 3)), sign_z)));
+		quat ret;
+		_mm_storeu_ps(ret.value_, r);
+		return ret;
+	}
+
+	inline void transpose(mat4& a)
+	{
+		__m128 c0 = _mm_loadu_ps(a.m), c1 = _mm_loadu_ps(a.m + 4);
+		__m128 c2 = _mm_loadu_ps(a.m + 8), c3 = _mm_loadu_ps(a.m + 12);
+		_MM_TRANSPOSE4_PS(c0, c1, c2, c3);
+		_mm_storeu_ps(a.m, c0); _mm_storeu_ps(a.m + 4, c1);
+		_mm_storeu_ps(a.m + 8, c2); _mm_storeu_ps(a.m + 12, c3);
+	}
+
+	// 2x2 matrices stored (m00 m01 m10 m11) in one register
+	// a * b
+	inline __m128 mat2Mul(__m128 a, __m128 b) {
+		return _mm_add_ps(_mm_mul_ps(a, _mm_shuffle_ps(b, b, _MM_SHUFFLE(3, 0, 3, 0))),
+			_mm_mul_ps(_mm_shuffle_ps(a, a, _MM_SHUFFLE(2, 3, 0, 1)), _mm_shuffle_ps(b, b, _MM_SHUFFLE(1, 2, 1, 2))));
+	}
+	// adjugate(a) * b
+	inline __m128 mat2AdjMul(__m128 a, __m128 b) {
+		return _mm_sub_ps(_mm_mul_ps(_mm_shuffle_ps(a, a, _MM_SHUFFLE(0, 0, 3, 3)), b),
+			_mm_mul_ps(_mm_shuffle_ps(a, a, _MM_SHUFFLE(2, 2, 1, 1)), _mm_shuffle_ps(b, b, _MM_SHUFFLE(1, 0, 3, 2))));
+	}
+	// a * adjugate(b)
+	inline __m128 mat2MulAdj(__m128 a, __m128 b) {
+		return _mm_sub_ps(_mm_mul_ps(a, _mm_shuffle_ps(b, b, _MM_SHUFFLE(0, 3, 0, 3))),
+			_mm_mul_ps(_mm_shuffle_ps(a, a, _MM_SHUFFLE(2, 3, 0, 1)), _mm_shuffle_ps(b, b, _MM_SHUFFLE(1, 2, 1, 2))));
+	}
+
+	// blockwise inverse: the matrix is split into 2x2 blocks A B / C D, and
+	// the inverse built from their adjugates and determinants (no pivoting).
+	// Works on the columns as if they were rows, which gives the columns of the
+	// inverse, as inverting and transposing commute
+	inline bool inverse(mat4& a)
+	{
+		const __m128 r0 = _mm_loadu_ps(a.m), r1 = _mm_loadu_ps(a.m + 4);
+		const __m128 r2 = _mm_loadu_ps(a.m + 8), r3 = _mm_loadu_ps(a.m + 12);
+
+		const __m128 A = _mm_movelh_ps(r0, r1);
+		const __m128 B = _mm_movehl_ps(r1, r0);
+		const __m128 C = _mm_movelh_ps(r2, r3);
+		const __m128 D = _mm_movehl_ps(r3, r2);
+
+		// determinants of A B C D
+		const __m128 det_sub = _mm_sub_ps(
+			_mm_mul_ps(_mm_shuffle_ps(r0, r2, _MM_SHUFFLE(2, 0, 2, 0)), _mm_shuffle_ps(r1, r3, _MM_SHUFFLE(3, 1, 3, 1))),
+			_mm_mul_ps(_mm_shuffle_ps(r0, r2, _MM_SHUFFLE(3, 1, 3, 1)), _mm_shuffle_ps(r1, r3, _MM_SHUFFLE(2, 0, 2, 0))));
+		const __m128 det_a = splat(det_sub, 0), det_b = splat(det_sub, 1);
+		const __m128 det_c = splat(det_sub, 2), det_d = splat(det_sub, 3);
+
+		const __m128 d_c = mat2AdjMul(D, C);
+		const __m128 a_b = mat2AdjMul(A, B);
+		__m128 x = _mm_sub_ps(_mm_mul_ps(det_d, A), mat2Mul(B, d_c));
+		__m128 w = _mm_sub_ps(_mm_mul_ps(det_a, D), mat2Mul(C, a_b));
+		__m128 y = _mm_sub_ps(_mm_mul_ps(det_b, C), mat2MulAdj(D, a_b));
+		__m128 z = _mm_sub_ps(_mm_mul_ps(det_c, B), mat2MulAdj(A, d_c));
+
+		// |M| = |A||D| + |B||C| - trace((A#B)(D#C))
+		__m128 tr = _mm_mul_ps(a_b, _mm_shuffle_ps(d_c, d_c, _MM_SHUFFLE(3, 1, 2, 0)));
+		tr = _mm_add_ps(tr, _mm_movehl_ps(tr, tr));
+		tr = _mm_add_ss(tr, _mm_shuffle_ps(tr, tr, _MM_SHUFFLE(1, 1, 1, 1)));
+		const __m128 det = _mm_sub_ss(_mm_add_ss(_mm_mul_ss(det_a, det_d), _mm_mul_ss(det_b, det_c)), tr);
+		if (fabsf(_mm_cvtss_f32(det)) < std::numeric_limits<float>::min())
+			return false;
+
+		const __m128 inv_det = _mm_div_ps(_mm_setr_ps(1.0f, -1.0f, -1.0f, 1.0f), splat(det, 0));
+		x = _mm_mul_ps(x, inv_det);
+		y = _mm_mul_ps(y, inv_det);
+		z = _mm_mul_ps(z, inv_det);
+		w = _mm_mul_ps(w, inv_det);
+
+		// adjugate shuffle and store in one
+		_mm_storeu_ps(a.m, _mm_shuffle_ps(x, y, _MM_SHUFFLE(1, 3, 1, 3)));
+		_mm_storeu_ps(a.m + 4, _mm_shuffle_ps(x, y, _MM_SHUFFLE(0, 2, 0, 2)));
+		_mm_storeu_ps(a.m + 8, _mm_shuffle_ps(z, w, _MM_SHUFFLE(1, 3, 1, 3)));
+		_mm_storeu_ps(a.m + 12, _mm_shuffle_ps(z, w, _MM_SHUFFLE(0, 2, 0, 2)));
+		return true;
+	}
+
+	// same method as scalar::inverseAffine. Bottom row is 0 0 0 1, so lane 3
+	// of the first three columns is 0 and stays 0 through the cross products
+	inline bool inverseAffine(mat4& a)
+	{
+		const __m128 c0 = _mm_loadu_ps(a.m), c1 = _mm_loadu_ps(a.m + 4);
+		const __m128 c2 = _mm_loadu_ps(a.m + 8), t = _mm_loadu_ps(a.m + 12);
+
+		__m128 r0 = cross(c1, c2), r1 = cross(c2, c0), r2 = cross(c0, c1);
+		__m128 det = _mm_mul_ps(c0, r0);
+		det = _mm_add_ss(_mm_add_ss(det, _mm_shuffle_ps(det, det, _MM_SHUFFLE(1, 1, 1, 1))),
+			_mm_movehl_ps(det, det));
+		if (fabsf(_mm_cvtss_f32(det)) < std::numeric_limits<float>::min())
+			return false;
+		const __m128 inv_det = _mm_div_ps(_mm_set1_ps(1.0f), splat(det, 0));
+		r0 = _mm_mul_ps(r0, inv_det);
+		r1 = _mm_mul_ps(r1, inv_det);
+		r2 = _mm_mul_ps(r2, inv_det);
+
+		// r0 r1 r2 are the rows of the inverse, transpose them into columns
+		__m128 r3 = _mm_setzero_ps();
+		_MM_TRANSPOSE4_PS(r0, r1, r2, r3);
+		__m128 pos = _mm_mul_ps(r0, splat(t, 0));
+		pos = _mm_add_ps(pos, _mm_mul_ps(r1, splat(t, 1)));
+		pos = _mm_add_ps(pos, _mm_mul_ps(r2, splat(t, 2)));
+		pos = _mm_sub_ps(_mm_setr_ps(0.0f, 0.0f, 0.0f, 1.0f), pos);
+
+		_mm_storeu_ps(a.m, r0); _mm_storeu_ps(a.m + 4, r1);
+		_mm_storeu_ps(a.m + 8, r2); _mm_storeu_ps(a.m + 12, pos);
+		return true;
+	}
+
+	}
+
+}
+#endif
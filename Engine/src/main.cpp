@@ -155,7 +155,8 @@ int main(void)
         glfwGetCursorPos(window, &mouse_x, &mouse_y);
 		GAME->updateMousePosition((int)mouse_x, (int)mouse_y);
 
-		//update game
+		//update game: simulation in fixed steps, then one interpolated render.
+		//Swap interval is 0, so frames are not capped to the refresh rate
 		GAME->update(dt);
 		glfwSwapBuffers(window);
 